@@ -46,6 +46,9 @@
 	/*! @defgroup irq Interrupts
 		@brief Interrupt handling
 	*/
+	/*! @defgroup irqlatency Interrupt latency
+		@brief Interrupt latency measurement
+	*/
 	/*! @defgroup thread Threads
 		@brief Thread management
 	*/
@@ -55,6 +58,15 @@
 	/*! @defgroup tick Tick
 		@brief Timed event scheduling
 	*/
+	/*! @defgroup dpc Deferred work
+		@brief Running interrupt bottom halves outside of interrupt context
+	*/
+	/*! @defgroup coro Coroutines
+		@brief Stackless cooperative tasks for protocol state machines
+	*/
+	/*! @defgroup trace Trace
+		@brief Scheduler and interrupt event tracing
+	*/
 
 //! @}
 
@@ -154,3 +166,9 @@
 		@brief DS ROM filesystem access
 	*/
 #endif
+
+#ifdef __CALICO_HOST__
+	/*! @defgroup hostsim Host simulation
+		@brief Simulation of calico's threading system on a PC
+	*/
+#endif
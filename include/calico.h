@@ -42,12 +42,21 @@
 #endif
 
 #include "calico/system/irq.h"
+#include "calico/system/irqlatency.h"
 #include "calico/system/tick.h"
 #include "calico/system/thread.h"
 #include "calico/system/mutex.h"
 #include "calico/system/condvar.h"
 #include "calico/system/mailbox.h"
+#include "calico/system/rwlock.h"
+#include "calico/system/semaphore.h"
+#include "calico/system/spscring.h"
+#include "calico/system/eventgroup.h"
+#include "calico/system/waitany.h"
+#include "calico/system/dpc.h"
+#include "calico/system/coro.h"
 #include "calico/system/dietprint.h"
+#include "calico/system/trace.h"
 
 #include "calico/dev/fugu.h"
 
@@ -69,6 +78,7 @@
 #include "calico/nds/env.h"
 #include "calico/nds/tlnc.h"
 #include "calico/nds/pxi.h"
+#include "calico/nds/pxirpc.h"
 #include "calico/nds/smutex.h"
 #include "calico/nds/keypad.h"
 #include "calico/nds/touch.h"
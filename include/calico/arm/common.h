@@ -6,6 +6,9 @@
 #if __ARM_ARCH >= 5
 #include "cp15.h"
 #endif
+#if defined(__CALICO_HOST__)
+#include <ucontext.h>
+#endif
 
 /*! @addtogroup arm
 	@{
@@ -15,9 +18,16 @@ MK_EXTERN_C_START
 
 //! Arm CPU register context (GPRs and SPRs)
 typedef struct ArmContext {
+#if !defined(__CALICO_HOST__)
 	u32 r[16];      //!< General Purpose Registers (R0-R15)
 	u32 psr;        //!< Program Status Register (CPSR/SPSR)
 	u32 sp_svc;     //!< SVC-mode banked SP Register (used by BIOS)
+#else
+	uptr r[16];     //!< Initial entrypoint/argument/stack state (host simulation)
+	u32 psr;        //!< Program Status Register (CPSR/SPSR)
+	uptr sp_svc;    //!< Unused (host simulation)
+	void* host;     //!< @private
+#endif
 } ArmContext;
 
 //! Saved state of the CPSR IRQ/FIQ mask bits @see ARM_PSR_I, ARM_PSR_F
@@ -45,7 +55,7 @@ MK_INLINE void armSoftBreakpoint(void)
 	__asm__ __volatile__ ("mov r11, r11");
 }
 
-#if !__thumb__
+#if !__thumb__ && !defined(__CALICO_HOST__)
 
 //! @brief Retrieves the value of the Current Program Status Register
 MK_EXTINLINE u32 armGetCpsr(void)
@@ -175,9 +185,31 @@ MK_EXTERN32 void armCopyMem32(void* dst, const void* src, size_t size);
 //! @brief Optimized version of memset, requiring 32-bit aligned @p dst and @p size, and taking a 32-bit fill @p value.
 MK_EXTERN32 void armFillMem32(void* dst, u32 value, size_t size);
 
+#if !defined(__CALICO_HOST__)
+
 //! @private
 MK_EXTERN32 u32 armContextSave(ArmContext* ctx, ArmIrqState st, u32 ret);
 
+#else
+
+//! @private
+ucontext_t* _hostContextSave(ArmContext* ctx, ArmIrqState st);
+
+//! @private
+void _hostContextResume(void);
+
+// getcontext() must be called from the stack frame that is later resumed
+#define armContextSave(_ctx, _st, _ret) __extension__({ \
+	volatile u32 __ret = 0; \
+	getcontext(_hostContextSave((_ctx), (_st))); \
+	if (__ret) _hostContextResume(); \
+	u32 __prev = __ret; \
+	__ret = (_ret); \
+	__prev; \
+})
+
+#endif
+
 //! @private
 MK_EXTERN32 void armContextLoad(const ArmContext* ctx) MK_NORETURN;
 
@@ -107,6 +107,7 @@ int tmioThreadMain(TmioCtl* ctl);
 void tmioThreadCancel(TmioCtl* ctl);
 
 bool tmioTransact(TmioCtl* ctl, TmioTx* tx);
+bool tmioTransactAsync(TmioCtl* ctl, TmioTx* tx);
 
 void tmioXferRecvByCpu(TmioCtl* ctl, TmioTx* tx);
 void tmioXferSendByCpu(TmioCtl* ctl, TmioTx* tx);
@@ -14,7 +14,13 @@
 #define MM_IWRAM       0x3000000 // 32-bit bus
 #define MM_IWRAM_SZ       0x8000 // 32kb
 
+#if !defined(__CALICO_HOST__)
 #define MM_IO          0x4000000 // 32-bit bus
+#else
+// The host simulation backs the I/O registers with ordinary memory
+extern unsigned char __host_io[];
+#define MM_IO          ((__UINTPTR_TYPE__)__host_io)
+#endif
 #define MM_IO_SZ           0x400 // 1kb
 
 #define MM_PALRAM      0x5000000 // 16-bit bus
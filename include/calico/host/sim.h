@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#if !defined(__CALICO_HOST__)
+#error "This header file is only for the host simulation"
+#endif
+
+#include "../types.h"
+#include "../system/irq.h"
+
+/*! @addtogroup hostsim
+
+	The host simulation allows building calico's threading, synchronization and
+	tick subsystems for a regular PC operating system, so that they can be
+	exercised by ordinary programs (such as unit tests or benchmarks). It models
+	a single-core GBA-like machine: I/O registers (interrupt controller and
+	timers) are backed by ordinary memory, threads run on their own host stacks
+	using `ucontext`, and time only advances when requested through
+	@ref hostSimAdvance or when all threads are idle. As a result, simulations
+	are fully deterministic.
+
+	The threading system is automatically initialized before `main` is called,
+	which runs as calico's main thread.
+
+	@note calico stores the addresses of synchronization objects in 32-bit
+	fields, so they must be located in the lower 4 GiB of the address space.
+	Programs must be linked with `-no-pie` (done automatically when linking
+	against the CMake target). Synchronization objects may be placed in static
+	storage or on simulated thread stacks (which are allocated in low memory),
+	but not on the heap or on the stack of `main`. Using an object outside of
+	this range aborts the program with an error message.
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Size of the host stack allocated for each simulated thread
+#define HOST_SIM_STACK_SZ (256*1024)
+
+//! @brief Returns the number of simulated system clock cycles elapsed since startup
+u64 hostSimGetCycles(void);
+
+/*! @brief Advances the simulated clock by @p cycles system clock cycles
+	@note Timer interrupts that become due are delivered as soon as interrupts
+	are enabled, which may cause the current thread to be preempted. In that
+	case the remaining time continues to elapse once the thread resumes.
+*/
+void hostSimAdvance(u64 cycles);
+
+//! @brief Raises the interrupts specified by @p mask, as if triggered by a hardware device
+void hostSimRaiseIrq(IrqMask mask);
+
+/*! @brief Called when all threads are blocked and no timer events are pending
+	@note The default implementation prints a message and aborts the program.
+	This function may be overridden by the program.
+*/
+void hostSimDeadlock(void) MK_NORETURN;
+
+MK_EXTERN_C_END
+
+//! @}
@@ -41,9 +41,24 @@
 //! Maximum number of words queued in PXI FIFO
 #define PXI_FIFO_LEN_WORDS 16
 
+//! Number of words that can be held by each PXI software send queue (see @ref PxiPrio)
+#define PXI_SEND_QUEUE_WORDS 64
+
+//! Number of tags available for tagged PXI requests (see @ref pxiBeginTaggedReceive)
+#define PXI_NUM_TAGS 8
+
 //! Special value indicating abscence of a reply to a PXI message
 #define PXI_NO_REPLY UINT32_MAX
 
+//! Size in bytes of each slot of a PXI bulk transport ring (matches the ARM9 cache line size)
+#define PXI_BULK_SLOT_SZ 32
+
+//! Minimum number of slots in each ring of a PXI bulk transport (enough for one message of maximum size)
+#define PXI_BULK_MIN_SLOTS 8
+
+//! Calculates the size of the buffer needed by @ref pxiBulkAttach for rings of @p _num_slots slots (must be a power of two)
+#define PXI_BULK_MEM_SZ(_num_slots) (2*(2+(_num_slots))*PXI_BULK_SLOT_SZ)
+
 // Packet format:
 //  Bit    Description
 //   0-4    Channel
@@ -58,6 +73,10 @@
 //   11-15  Number of extra words minus 1
 //   16-31  Immediate (16-bit)
 
+// Tagged requests store the tag in the top 3 bits of the immediate (bits 23-25 for
+// simple packets, bits 13-15 for extended packets). Tagged replies are extended
+// response packets carrying the tag as immediate, and the reply as single data word.
+
 MK_EXTERN_C_START
 
 //! List of PXI channels
@@ -72,7 +91,7 @@ typedef enum PxiChannel {
 	PxiChannel_Sound    = 6,  //!< Reserved for sound hardware access
 	PxiChannel_Mic      = 7,  //!< Reserved for microphone access
 	PxiChannel_Camera   = 8,  //!< Reserved for DSi camera access
-	PxiChannel_Rsvd9    = 9,  //!< Reserved for future use
+	PxiChannel_Bulk     = 9,  //!< Reserved for shared memory bulk transport control (see @ref pxiBulkAttach)
 	PxiChannel_Rsvd10   = 10, //!< Reserved for future use
 	PxiChannel_Rsvd11   = 11, //!< Reserved for future use
 	PxiChannel_Reset    = 12, //!< Special channel used for ret2hbmenu
@@ -101,6 +120,64 @@ typedef enum PxiChannel {
 	PxiChannel_Count = PxiChannel_Extended,
 } PxiChannel;
 
+/*! @brief PXI send priority classes @see pxiSetChannelPrio
+
+	Outgoing messages are not written directly into the hardware FIFO. Instead,
+	they are copied into a software send queue (one per priority class), which
+	is drained by the PXI send interrupt whenever the FIFO has room. Messages
+	from higher priority classes are always sent first, although a message that
+	has already started being transmitted is always completed first. Messages
+	sent over the same channel are delivered in order, since each channel
+	belongs to a single priority class.
+*/
+typedef enum PxiPrio {
+	PxiPrio_High   = 0, //!< Latency sensitive channels (by default: Sound, Mic, Reset)
+	PxiPrio_Normal = 1, //!< Default priority class
+	PxiPrio_Low    = 2, //!< Bulk data transfer channels (by default: BlkDev, NetBuf)
+
+	PxiPrio_Count,
+} PxiPrio;
+
+//! PXI send queue statistics @see pxiGetSendQueueStats
+typedef struct PxiSendQueueStats {
+	u16 depth[PxiPrio_Count];     //!< Number of words currently held by each send queue
+	u16 max_depth[PxiPrio_Count]; //!< Largest number of words ever held by each send queue
+	u32 fifo_stalls;              //!< Number of times the hardware FIFO filled up while messages were waiting to be sent
+	u32 queue_stalls;             //!< Number of times a sending thread had to wait for room in a send queue
+} PxiSendQueueStats;
+
+//! Number of buckets in the PXI round trip latency histograms
+#define PXI_STATS_NUM_BUCKETS 16
+
+/*! @brief PXI statistics of a single channel @see PxiStats
+	@note Messages delivered through a bulk transport (see @ref pxiBulkAttach) are counted
+	as if they had been sent through the FIFO, while their doorbells are counted in
+	@ref PxiChannel_Bulk.
+*/
+typedef struct PxiChannelStats {
+	u32 tx_packets;  //!< Number of messages sent
+	u32 tx_words;    //!< Number of words sent (including message headers)
+	u32 rx_packets;  //!< Number of messages received
+	u32 rx_words;    //!< Number of words received (including message headers)
+	u32 fifo_stalls; //!< Number of times a message of this channel was kept waiting by a full FIFO
+
+	u32 num_round_trips; //!< Number of replies received to requests sent by this CPU
+	u32 max_round_trip;  //!< Longest request/reply round trip
+
+	//! Round trip histogram: bucket 0 counts round trips shorter than 64 ticks, and bucket N counts round trips in the range [2^(N+5), 2^(N+6)) (the last bucket also includes longer ones)
+	u32 rtt_hist[PXI_STATS_NUM_BUCKETS];
+} PxiChannelStats;
+
+/*! @brief PXI statistics @see pxiGetStats
+	@note All times are expressed in ticks of the high resolution clock (see @ref tickHiresGetCount).
+*/
+typedef struct PxiStats {
+	u32 recv_irqs;          //!< Number of times the PXI receive interrupt handler ran
+	u32 recv_max_ticks;     //!< Longest execution time of the PXI receive interrupt handler
+	u64 recv_total_ticks;   //!< Total execution time of the PXI receive interrupt handler (including channel handlers)
+	PxiChannelStats channels[PxiChannel_Count]; //!< Per-channel statistics
+} PxiStats;
+
 //! @private
 MK_CONSTEXPR u32 pxiMakePacket(PxiChannel ch, bool dir, u32 imm)
 {
@@ -183,6 +260,49 @@ void pxiSetMailbox(PxiChannel ch, struct Mailbox* mb);
 //! Waits for the other CPU to set a handler callback or mailbox on PXI channel @p ch
 void pxiWaitRemote(PxiChannel ch);
 
+/*! @brief Assigns PXI channel @p ch to the send priority class @p prio
+	@note This should be done before sending any messages over the channel,
+	otherwise messages already waiting to be sent could be overtaken.
+*/
+void pxiSetChannelPrio(PxiChannel ch, PxiPrio prio);
+
+//! Retrieves the statistics of the PXI send queues of this CPU into @p out
+void pxiGetSendQueueStats(PxiSendQueueStats* out);
+
+/*! @brief Retrieves the PXI traffic and latency statistics of this CPU into @p out
+	@returns true on success, false if statistics are not available.
+	@note Statistics are only collected if calico was built with the `CALICO_PXI_STATS`
+	option enabled. Round trip times are only accurate if the high resolution clock
+	was started (see @ref tickHiresStart).
+*/
+bool pxiGetStats(PxiStats* out);
+
+//! @brief Clears all collected PXI traffic and latency statistics
+void pxiResetStats(void);
+
+#if defined(ARM9)
+
+/*! @brief Attaches a shared memory bulk transport to PXI channel @p ch
+	@param[in] mem Buffer in main RAM, aligned to @ref PXI_BULK_SLOT_SZ bytes
+	@param[in] size Size of the buffer in bytes, at least `PXI_BULK_MEM_SZ(PXI_BULK_MIN_SLOTS)`
+	(see @ref PXI_BULK_MEM_SZ)
+	@return true on success, false on failure (invalid arguments, or the channel already has a transport)
+
+	The buffer is split into two rings, one per direction. Afterwards, extended
+	messages sent over the channel by either CPU (see @ref pxiSendWithData) are
+	copied into the ring instead of being written into the hardware FIFO word by
+	word. The FIFO only carries a single doorbell word per message. Messages are
+	delivered to the handler of the channel in the exact same way and order as if
+	they had been sent through the FIFO. If a ring runs out of space, messages
+	temporarily fall back to the FIFO.
+
+	@note The buffer must remain valid (and must not be accessed) forever, since
+	bulk transports cannot be detached.
+*/
+bool pxiBulkAttach(PxiChannel ch, void* mem, size_t size);
+
+#endif
+
 //! @private
 void pxiSendPacket(u32 packet);
 
@@ -195,6 +315,30 @@ void pxiBeginReceive(PxiChannel ch);
 //! @private
 u32 pxiEndReceive(PxiChannel ch);
 
+/*! @brief Allocates a tag for a tagged request, waiting for one to become available if needed
+	@return Tag to embed in the request (see @ref pxiSendTagged and @ref pxiSendWithDataTagged)
+
+	Unlike the regular request/reply mechanism (see @ref pxiSendAndReceive), which only
+	allows for one outstanding request per channel, tagged requests can be pipelined:
+	any number of threads (up to @ref PXI_NUM_TAGS) can be waiting for their replies at
+	the same time, and the other CPU can reply in any order using @ref pxiReplyTagged.
+	Whether requests are actually serviced concurrently depends on the other CPU:
+	the built-in services (block devices and power management) handle them one
+	at a time in arrival order on a single thread, so for them tagged requests
+	only remove the serialization on the requesting side.
+	Example usage:
+	@code
+	unsigned tag = pxiBeginTaggedReceive();
+	pxiSendTagged(PxiChannel_User0, tag, 1234);
+	u32 reply = pxiEndTaggedReceive(tag);
+	@endcode
+	@note A given channel should use either tagged or regular requests, but not both.
+*/
+unsigned pxiBeginTaggedReceive(void);
+
+//! Waits for the reply to the tagged request identified by @p tag, and frees the tag
+u32 pxiEndTaggedReceive(unsigned tag);
+
 //! Sends a simple 26-bit value @p imm over PXI channel @p ch
 MK_INLINE void pxiSend(PxiChannel ch, u32 imm)
 {
@@ -217,6 +361,30 @@ MK_INLINE void pxiReply(PxiChannel ch, u32 imm)
 	pxiSendPacket(pxiMakePacket(ch, true, imm));
 }
 
+//! Returns the tag of a tagged request @p msg, as received by the handler or mailbox of the channel
+MK_CONSTEXPR unsigned pxiMsgGetTag(u32 msg)
+{
+	return (msg >> 26) ? ((msg >> 13) & 7) : ((msg >> 23) & 7);
+}
+
+//! Sends a tagged message with 23-bit value @p imm over PXI channel @p ch @see pxiBeginTaggedReceive
+MK_INLINE void pxiSendTagged(PxiChannel ch, unsigned tag, u32 imm)
+{
+	pxiSend(ch, (imm & 0x7fffff) | (tag << 23));
+}
+
+//! Sends a tagged extended message with 13-bit value @p imm over PXI channel @p ch @see pxiBeginTaggedReceive
+MK_INLINE void pxiSendWithDataTagged(PxiChannel ch, unsigned tag, u16 imm, const u32* data, u32 num_words)
+{
+	pxiSendWithData(ch, (imm & 0x1fff) | (tag << 13), data, num_words);
+}
+
+//! Replies to a tagged message on PXI channel @p ch using 32-bit value @p value
+MK_INLINE void pxiReplyTagged(PxiChannel ch, unsigned tag, u32 value)
+{
+	pxiSendExtPacket(pxiMakeExtPacket(ch, true, 1, tag), &value);
+}
+
 /*! @brief Sends a message over PXI channel @p ch, and receives its corresponding reply
 	@param[in] imm 26-bit value to send
 	@return Message reply, sent by the other CPU using @ref pxiReply
@@ -241,6 +409,30 @@ MK_INLINE u32 pxiSendWithDataAndReceive(PxiChannel ch, u32 imm, const u32* data,
 	return pxiEndReceive(ch);
 }
 
+/*! @brief Sends a tagged message over PXI channel @p ch, and receives its corresponding reply
+	@param[in] imm 23-bit value to send
+	@return Message reply, sent by the other CPU using @ref pxiReplyTagged
+*/
+MK_INLINE u32 pxiSendTaggedAndReceive(PxiChannel ch, u32 imm)
+{
+	unsigned tag = pxiBeginTaggedReceive();
+	pxiSendTagged(ch, tag, imm);
+	return pxiEndTaggedReceive(tag);
+}
+
+/*! @brief Sends a tagged extended message over PXI channel @p ch, and receives its corresponding reply
+	@param[in] imm 13-bit immediate value to send
+	@param[in] data Data buffer to send
+	@param[in] num_words Size of the data buffer in words
+	@return Message reply, sent by the other CPU using @ref pxiReplyTagged
+*/
+MK_INLINE u32 pxiSendWithDataTaggedAndReceive(PxiChannel ch, u32 imm, const u32* data, u32 num_words)
+{
+	unsigned tag = pxiBeginTaggedReceive();
+	pxiSendWithDataTagged(ch, tag, imm, data, num_words);
+	return pxiEndTaggedReceive(tag);
+}
+
 MK_EXTERN_C_END
 
 //! @}
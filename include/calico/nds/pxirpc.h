@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#if !defined(__NDS__)
+#error "This header file is only for NDS"
+#endif
+
+#include "../types.h"
+#if defined(ARM9)
+#include "../arm/cache.h"
+#endif
+#include "../system/mailbox.h"
+#include "pxi.h"
+
+/*! @addtogroup pxi
+	@{
+*/
+
+/*! @name PXI remote procedure calls
+
+	Remote services can be declared with a list of functions in X-macro form,
+	from which both the client stubs (calling CPU) and the dispatch table
+	(serving CPU) are generated. The list macro receives the name of the entry
+	macro and an opaque context argument, which must be passed as the first
+	argument of each entry. Each entry then contains the name of the function,
+	its return value (@ref PXI_RPC_RET or @ref PXI_RPC_VOID), and up to
+	@ref PXI_RPC_MAX_ARGS parameters of 32 bits or less:
+	- @ref PXI_RPC_VAL: passed by value
+	- @ref PXI_RPC_IN: buffer read by the serving CPU
+	- @ref PXI_RPC_OUT: buffer written by the serving CPU
+
+	Buffers are never copied, only their address is passed. Instead, the ARM9
+	client stubs perform the required cache maintenance: input buffers are
+	flushed, while output buffers are invalidated if they are aligned to cache
+	line boundaries (otherwise they are flushed, which means the cache lines
+	they share with neighbouring data must not be accessed during the call).
+	Calls are sent as tagged requests (see @ref pxiBeginTaggedReceive), so
+	multiple threads can have calls in flight at the same time.
+
+	Example usage:
+	@code
+	#define MY_SERVICE(_, _x) \
+		_(_x, myAdd,  PXI_RPC_RET(u32), PXI_RPC_VAL(u32, a), PXI_RPC_VAL(u32, b)) \
+		_(_x, myFill, PXI_RPC_VOID,     PXI_RPC_OUT(void*, buf, len), PXI_RPC_VAL(u32, len))
+
+	// ARM9: defines u32 rpc_myAdd(u32 a, u32 b) and void rpc_myFill(void* buf, u32 len)
+	PXI_RPC_DEFINE_CLIENT(rpc_, PxiChannel_User0, MY_SERVICE)
+
+	// ARM7: calls myAdd and myFill, which must be declared beforehand
+	PXI_RPC_DEFINE_SERVER(s_myService, MY_SERVICE);
+
+	Mailbox mb;
+	u32 mb_slots[PXI_RPC_MAILBOX_SLOTS];
+	mailboxPrepare(&mb, mb_slots, sizeof(mb_slots)/sizeof(u32));
+	pxiSetMailbox(PxiChannel_User0, &mb);
+	for (;;) {
+		pxiRpcDispatch(PxiChannel_User0, &s_myService, &mb, mailboxRecv(&mb));
+	}
+	@endcode
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Maximum number of parameters of a remote procedure
+#define PXI_RPC_MAX_ARGS 6
+
+/*! @brief Number of mailbox slots needed by a server to hold the calls of all possible outstanding tags
+	@note Each call takes up one word for the header and one for each parameter.
+	Words that do not fit in the mailbox are dropped by the PXI receive handler.
+*/
+#define PXI_RPC_MAILBOX_SLOTS ((1+PXI_RPC_MAX_ARGS)*PXI_NUM_TAGS)
+
+//! Declares a remote procedure parameter @p _name of type @p _type passed by value
+#define PXI_RPC_VAL(_type, _name)        (VAL, _type, _name, 0)
+
+//! Declares a remote procedure parameter @p _name pointing to a buffer of @p _size bytes read by the serving CPU
+#define PXI_RPC_IN(_type, _name, _size)  (IN,  _type, _name, _size)
+
+//! Declares a remote procedure parameter @p _name pointing to a buffer of @p _size bytes written by the serving CPU
+#define PXI_RPC_OUT(_type, _name, _size) (OUT, _type, _name, _size)
+
+//! Declares a remote procedure returning a value of type @p _type
+#define PXI_RPC_RET(_type)               (1, _type)
+
+//! Declares a remote procedure not returning any value
+#define PXI_RPC_VOID                     (0, void)
+
+//! Remote procedure wrapper, receiving the parameters as an array of words
+typedef u32 (* PxiRpcFn)(const u32* args);
+
+//! Table of remote procedures, as generated by @ref PXI_RPC_DEFINE_SERVER
+typedef struct PxiRpcTable {
+	unsigned num_fns;    //!< Number of remote procedures
+	const PxiRpcFn* fns; //!< Remote procedure wrappers, indexed by procedure ID
+} PxiRpcTable;
+
+/*! @brief Serves a remote procedure call received through mailbox @p mb
+	@param[in] ch PXI channel the call was received on
+	@param[in] table Table of remote procedures
+	@param[in] mb Mailbox associated to @p ch
+	@param[in] msg First word of the call (as returned by @ref mailboxRecv)
+
+	The parameters of the call are read from the mailbox, and the procedure is
+	called from the current thread. The return value is sent to the calling CPU.
+*/
+void pxiRpcDispatch(PxiChannel ch, const PxiRpcTable* table, Mailbox* mb, u32 msg);
+
+//! @private
+MK_INLINE void _pxiRpcPrepareIn(const void* buf, size_t size)
+{
+#if defined(ARM9)
+	armDCacheFlush(buf, size);
+#endif
+}
+
+//! @private
+MK_INLINE void _pxiRpcPrepareOut(const void* buf, size_t size)
+{
+#if defined(ARM9)
+	if (!(((uptr)buf | size) & (ARM_CACHE_LINE_SZ-1))) {
+		armDCacheInvalidate(buf, size);
+	} else {
+		armDCacheFlush(buf, size);
+	}
+#endif
+}
+
+// Preprocessor machinery
+#define _PXI_RPC_CAT(_a, _b)  _PXI_RPC_CAT_(_a, _b)
+#define _PXI_RPC_CAT_(_a, _b) _a##_b
+#define _PXI_RPC_FIRST(_a, _b)  _a
+#define _PXI_RPC_SECOND(_a, _b) _b
+#define _PXI_RPC_TAIL(...)    _PXI_RPC_TAIL_(__VA_ARGS__)
+#define _PXI_RPC_TAIL_(_x, ...) __VA_ARGS__
+#define _PXI_RPC_NARGS(...)   _PXI_RPC_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _PXI_RPC_NARGS_(_z, _1, _2, _3, _4, _5, _6, _7, _8, _n, ...) _n
+#define _PXI_RPC_HASARGS(...) _PXI_RPC_CAT(_PXI_RPC_HASARGS_, _PXI_RPC_NARGS(__VA_ARGS__))
+#define _PXI_RPC_HASARGS_0 0
+#define _PXI_RPC_HASARGS_1 1
+#define _PXI_RPC_HASARGS_2 1
+#define _PXI_RPC_HASARGS_3 1
+#define _PXI_RPC_HASARGS_4 1
+#define _PXI_RPC_HASARGS_5 1
+#define _PXI_RPC_HASARGS_6 1
+#define _PXI_RPC_HASARGS_7 1
+#define _PXI_RPC_HASARGS_8 1
+
+#if defined(__cplusplus)
+#define _PXI_RPC_STATIC_ASSERT static_assert
+#else
+#define _PXI_RPC_STATIC_ASSERT _Static_assert
+#endif
+
+// Calls with more parameters would not fit in PXI_RPC_MAILBOX_SLOTS
+#define _PXI_RPC_CHECK(_name, ...) \
+	_PXI_RPC_STATIC_ASSERT(_PXI_RPC_NARGS(__VA_ARGS__) <= PXI_RPC_MAX_ARGS, \
+		"remote procedure " #_name " has more than PXI_RPC_MAX_ARGS parameters");
+
+#define _PXI_RPC_MAP(_m, ...) _PXI_RPC_CAT(_PXI_RPC_MAP_, _PXI_RPC_NARGS(__VA_ARGS__))(_m, 0, ##__VA_ARGS__)
+#define _PXI_RPC_MAP_0(_m, _i)
+#define _PXI_RPC_MAP_1(_m, _i, _x)      _m(_i, _x)
+#define _PXI_RPC_MAP_2(_m, _i, _x, ...) _m(_i, _x) _PXI_RPC_MAP_1(_m, _i+1, __VA_ARGS__)
+#define _PXI_RPC_MAP_3(_m, _i, _x, ...) _m(_i, _x) _PXI_RPC_MAP_2(_m, _i+1, __VA_ARGS__)
+#define _PXI_RPC_MAP_4(_m, _i, _x, ...) _m(_i, _x) _PXI_RPC_MAP_3(_m, _i+1, __VA_ARGS__)
+#define _PXI_RPC_MAP_5(_m, _i, _x, ...) _m(_i, _x) _PXI_RPC_MAP_4(_m, _i+1, __VA_ARGS__)
+#define _PXI_RPC_MAP_6(_m, _i, _x, ...) _m(_i, _x) _PXI_RPC_MAP_5(_m, _i+1, __VA_ARGS__)
+
+// Parameter expansions
+#define _PXI_RPC_PARAM(_i, _p)  _PXI_RPC_PARAM_ _p
+#define _PXI_RPC_PARAM_(_kind, _type, _name, _size) , _type _name
+#define _PXI_RPC_PACK(_i, _p)   _PXI_RPC_PACK_ _p
+#define _PXI_RPC_PACK_(_kind, _type, _name, _size) (u32)(uptr)(_name),
+#define _PXI_RPC_PREP(_i, _p)   _PXI_RPC_PREP_ _p
+#define _PXI_RPC_PREP_(_kind, _type, _name, _size) _PXI_RPC_PREP_##_kind(_name, _size)
+#define _PXI_RPC_PREP_VAL(_name, _size)
+#define _PXI_RPC_PREP_IN(_name, _size)  _pxiRpcPrepareIn((_name), (_size));
+#define _PXI_RPC_PREP_OUT(_name, _size) _pxiRpcPrepareOut((_name), (_size));
+#define _PXI_RPC_UNPACK(_i, _p) _PXI_RPC_UNPACK_(_i, _PXI_RPC_TYPEOF _p)
+#define _PXI_RPC_UNPACK_(_i, _type) , (_type)(uptr)args[_i]
+#define _PXI_RPC_TYPEOF(_kind, _type, _name, _size) _type
+
+#define _PXI_RPC_PARAMS(...) _PXI_RPC_CAT(_PXI_RPC_PARAMS_, _PXI_RPC_HASARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _PXI_RPC_PARAMS_0(...) void
+#define _PXI_RPC_PARAMS_1(...) _PXI_RPC_TAIL(_PXI_RPC_MAP(_PXI_RPC_PARAM, __VA_ARGS__))
+#define _PXI_RPC_ARGS(...) _PXI_RPC_CAT(_PXI_RPC_ARGS_, _PXI_RPC_HASARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _PXI_RPC_ARGS_0(...)
+#define _PXI_RPC_ARGS_1(...) _PXI_RPC_TAIL(_PXI_RPC_MAP(_PXI_RPC_UNPACK, __VA_ARGS__))
+
+// Return value expansions
+#define _PXI_RPC_RETTYPE(_r)   _PXI_RPC_SECOND _r
+#define _PXI_RPC_RETURN(_r, _e) _PXI_RPC_RETURN_ _r (_e)
+#define _PXI_RPC_RETURN_(_has, _type) _PXI_RPC_CAT(_PXI_RPC_RETURN_, _has)(_type)
+#define _PXI_RPC_RETURN_0(_type) (void)
+#define _PXI_RPC_RETURN_1(_type) return (_type)
+#define _PXI_RPC_SERVE(_r, _e) _PXI_RPC_SERVE_ _r (_e)
+#define _PXI_RPC_SERVE_(_has, _type) _PXI_RPC_CAT(_PXI_RPC_SERVE_, _has)
+#define _PXI_RPC_SERVE_0(_e) _e; return 0
+#define _PXI_RPC_SERVE_1(_e) return (u32)(_e)
+
+// Client side (context: prefix and channel)
+#define _PXI_RPC_ID(_x, _name, _ret, ...) _PxiRpcId_##_name,
+#define _PXI_RPC_SEND(_ch, _name, ...) _PXI_RPC_CAT(_PXI_RPC_SEND_, _PXI_RPC_HASARGS(__VA_ARGS__))(_ch, _name, ##__VA_ARGS__)
+#define _PXI_RPC_SEND_0(_ch, _name, ...) \
+	pxiSendTaggedAndReceive((_ch), _PxiRpcId_##_name)
+#define _PXI_RPC_SEND_1(_ch, _name, ...) ({ \
+	const u32 _args[] = { _PXI_RPC_MAP(_PXI_RPC_PACK, __VA_ARGS__) }; \
+	pxiSendWithDataTaggedAndReceive((_ch), _PxiRpcId_##_name, _args, sizeof(_args)/sizeof(u32)); \
+})
+#define _PXI_RPC_CLIENT_FN(_x, _name, _ret, ...) \
+	_PXI_RPC_CHECK(_name, ##__VA_ARGS__) \
+	_PXI_RPC_RETTYPE(_ret) _PXI_RPC_CAT(_PXI_RPC_FIRST _x, _name)(_PXI_RPC_PARAMS(__VA_ARGS__)) \
+	{ \
+		_PXI_RPC_MAP(_PXI_RPC_PREP, ##__VA_ARGS__) \
+		_PXI_RPC_RETURN(_ret, _PXI_RPC_SEND(_PXI_RPC_SECOND _x, _name, ##__VA_ARGS__)); \
+	}
+
+// Server side
+#define _PXI_RPC_SERVER_FN(_x, _name, _ret, ...) \
+	_PXI_RPC_CHECK(_name, ##__VA_ARGS__) \
+	static u32 _pxiRpcServe_##_name(const u32* args) \
+	{ \
+		MK_DUMMY(args); \
+		_PXI_RPC_SERVE(_ret, _name(_PXI_RPC_ARGS(__VA_ARGS__))); \
+	}
+#define _PXI_RPC_SERVER_ENTRY(_x, _name, _ret, ...) _pxiRpcServe_##_name,
+
+/*! @brief Defines the client stubs of the remote procedures in @p _list
+	@param[in] _prefix Prefix prepended to the name of each stub
+	@param[in] _ch PXI channel used to send calls
+	@param[in] _list X-macro list of remote procedures
+*/
+#define PXI_RPC_DEFINE_CLIENT(_prefix, _ch, _list) \
+	enum { _list(_PXI_RPC_ID, ) }; \
+	_list(_PXI_RPC_CLIENT_FN, (_prefix, _ch))
+
+/*! @brief Defines a table of remote procedures (see @ref PxiRpcTable) for the functions in @p _list
+	@param[in] _table Name of the table
+	@param[in] _list X-macro list of remote procedures
+*/
+#define PXI_RPC_DEFINE_SERVER(_table, _list) \
+	_list(_PXI_RPC_SERVER_FN, ) \
+	static const PxiRpcFn _table##_fns[] = { _list(_PXI_RPC_SERVER_ENTRY, ) }; \
+	static const PxiRpcTable _table = { sizeof(_table##_fns)/sizeof(PxiRpcFn), _table##_fns }
+
+//! @}
+
+MK_EXTERN_C_END
+
+//! @}
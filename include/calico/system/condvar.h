@@ -17,9 +17,12 @@
 
 MK_EXTERN_C_START
 
-//! Condition variable object
+/*! @brief Condition variable object
+	@note The layout of this object changed in calico 0.1.0 (it used to be a
+	single byte); code built against older headers must be rebuilt.
+*/
 typedef struct CondVar {
-	u8 dummy; //!< @private
+	ThrListNode waiters; //!< @private
 } CondVar;
 
 //! Wakes up at most one thread waiting on condition variable @p cv.
@@ -32,6 +35,13 @@ void condvarBroadcast(CondVar* cv);
 //! The Mutex @p m is atomically unlocked/locked during the wait.
 void condvarWait(CondVar* cv, Mutex* m);
 
+/*! @brief Like @ref condvarWait, but giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if the condition variable was awakened, false if the wait timed out.
+	The Mutex @p m is reacquired in both cases.
+*/
+bool condvarWaitTimeout(CondVar* cv, Mutex* m, u32 timeout_ticks);
+
 MK_EXTERN_C_END
 
 //! @}
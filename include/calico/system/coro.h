@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "tick.h"
+#include "mailbox.h"
+
+/*! @addtogroup coro
+
+	Coroutines are lightweight cooperative tasks that do not own a stack. They
+	are intended for long-running protocol state machines (such as device
+	initialization sequences or network handshakes), which would otherwise each
+	need a dedicated thread. Any number of coroutines can be run by a single
+	thread through a @ref CoroLoop, which sleeps while all of its coroutines
+	are waiting.
+
+	Coroutines are written in the style of protothreads: the coroutine function
+	is reentered from the start every time it is resumed, and the CORO_\* macros
+	jump back to the point where it last suspended. As a consequence, local
+	variables do **not** retain their values across suspension points, and
+	should be stored alongside the @ref Coro object instead (e.g. by embedding
+	it in a larger structure). Suspension points cannot be used inside `switch`
+	statements.
+
+	Coroutines must not call blocking functions, since that would stall every
+	other coroutine on the same loop. Events coming from other subsystems are
+	instead awaited through a @ref Mailbox (for instance, PXI messages routed
+	to one with @ref pxiSetMailbox) or by calling @ref coroWake from a
+	completion callback (for instance, that of @ref tmioTransactAsync). The
+	blocking PXI request/reply helpers (such as @ref pxiSendAndReceive) are
+	not usable from coroutines.
+
+	Example usage:
+	@code
+	typedef struct MyTask {
+		Coro co;
+		unsigned i;
+	} MyTask;
+
+	static int myTaskMain(Coro* co)
+	{
+		MyTask* t = (MyTask*)co;
+		CORO_BEGIN(co);
+
+		for (t->i = 0; t->i < 10; t->i ++) {
+			CORO_SLEEP_TICKS(co, ticksFromUsec(1000));
+		}
+
+		CORO_END(co);
+	}
+	@endcode
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+typedef struct Coro Coro;
+typedef struct CoroLoop CoroLoop;
+
+/*! @brief Maximum number of coroutines awaiting a mailbox that a @ref CoroLoop can sleep on
+	@note If more coroutines than this are suspended in @ref CORO_AWAIT_MAILBOX at
+	the same time, the loop polls the mailboxes every @ref CORO_POLL_TICKS instead
+	of sleeping until a message arrives, which delays the coroutines and wastes CPU time.
+*/
+#define CORO_MAX_MAILBOX_WAITS 31
+
+//! Polling interval in system ticks used when over @ref CORO_MAX_MAILBOX_WAITS mailboxes are awaited
+#define CORO_POLL_TICKS ticksFromUsec(1000)
+
+#define CORO_WAITING 0 //!< Coroutine function return value: the coroutine is suspended
+#define CORO_DONE    1 //!< Coroutine function return value: the coroutine has finished
+
+//! Coroutine function type, returning either @ref CORO_WAITING or @ref CORO_DONE
+typedef int (* CoroFn)(Coro* co);
+
+//! Coroutine object
+struct Coro {
+	TickTask timer;   //!< @private
+	Coro* next;       //!< @private
+	CoroLoop* loop;   //!< @private
+	CoroFn fn;        //!< @private
+	Mailbox* wait_mb; //!< @private
+	u16 line;         //!< @private
+	bool queued;      //!< @private
+	bool woken;       //!< @private
+	bool timer_fired; //!< @private
+	bool finished;    //!< @private
+};
+
+//! Coroutine event loop object
+struct CoroLoop {
+	Mailbox wake_mb;  //!< @private
+	Coro* list;       //!< @private
+};
+
+/*! @brief Prepares a CoroLoop object @p loop for use
+	@param[in] slots Storage space for pending wakeups
+	@param[in] num_slots Capacity of the storage space in words, which must be
+	at least the maximum number of coroutines that will run on the loop
+*/
+MK_INLINE void coroLoopPrepare(CoroLoop* loop, u32* slots, unsigned num_slots)
+{
+	mailboxPrepare(&loop->wake_mb, slots, num_slots);
+	loop->list = NULL;
+}
+
+/*! @brief Runs the coroutines of @p loop on the current thread
+	@note Returns once all coroutines have finished.
+*/
+void coroLoopRun(CoroLoop* loop);
+
+//! @brief Adds coroutine @p co running function @p fn to @p loop
+void coroStart(CoroLoop* loop, Coro* co, CoroFn fn);
+
+/*! @brief Wakes up coroutine @p co, so that it is resumed by its loop
+	@note This function can be called from interrupt handlers and callbacks
+	(such as PXI handlers or TMIO transaction callbacks). Use it along with
+	@ref CORO_AWAIT_WAKE or @ref CORO_AWAIT_UNTIL.
+*/
+void coroWake(Coro* co);
+
+//! @private
+void _coroArmTimer(Coro* co, u32 ticks);
+
+//! @brief Returns true if coroutine @p co has finished
+MK_INLINE bool coroIsFinished(Coro* co)
+{
+	return co->finished;
+}
+
+//! @brief Marks the start of the body of a coroutine function
+#define CORO_BEGIN(co) switch ((co)->line) { case 0:
+
+//! @brief Marks the end of the body of a coroutine function, finishing the coroutine
+#define CORO_END(co) } (co)->line = 0; return CORO_DONE
+
+//! @brief Finishes the coroutine early
+#define CORO_EXIT(co) do { (co)->line = 0; return CORO_DONE; } while (0)
+
+//! @brief Suspends the coroutine until @p cond is true, reevaluating it every time the coroutine is resumed
+#define CORO_AWAIT_UNTIL(co, cond) do { \
+	(co)->line = __LINE__; case __LINE__: \
+	if (!(cond)) return CORO_WAITING; \
+} while (0)
+
+//! @brief Suspends the coroutine until @ref coroWake is called on it
+#define CORO_AWAIT_WAKE(co) do { \
+	(co)->woken = false; \
+	CORO_AWAIT_UNTIL(co, (co)->woken); \
+} while (0)
+
+//! @brief Gives other coroutines a chance to run
+#define CORO_YIELD(co) do { \
+	coroWake(co); \
+	(co)->line = __LINE__; return CORO_WAITING; case __LINE__:; \
+} while (0)
+
+//! @brief Suspends the coroutine for the specified number of @p ticks @see ticksFromUsec
+#define CORO_SLEEP_TICKS(co, ticks) do { \
+	_coroArmTimer((co), (ticks)); \
+	CORO_AWAIT_UNTIL(co, (co)->timer_fired); \
+} while (0)
+
+/*! @brief Suspends the coroutine until a message is received from Mailbox @p mb into @p out
+	@note See @ref CORO_MAX_MAILBOX_WAITS.
+*/
+#define CORO_AWAIT_MAILBOX(co, mb, out) do { \
+	(co)->wait_mb = (mb); \
+	CORO_AWAIT_UNTIL(co, mailboxTryRecv((co)->wait_mb, (out))); \
+	(co)->wait_mb = NULL; \
+} while (0)
+
+MK_EXTERN_C_END
+
+//! @}
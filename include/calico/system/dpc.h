@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+
+/*! @addtogroup dpc
+
+	Deferred procedure calls (DPCs) allow interrupt handlers to hand off work
+	that is too long to run with interrupts disabled, without needing a
+	dedicated thread (and stack) for each driver. Interrupt handlers queue a
+	preallocated @ref DpcItem, and a single high priority worker thread runs
+	queued items in priority order (and FIFO order within the same priority)
+	as soon as the interrupt handler returns, before other threads resume.
+
+	DPCs never run in interrupt context: the interrupt exit path merely
+	switches to the worker thread, exactly like it does for any other thread
+	woken up by an interrupt handler. As a result, the latency of a DPC is the
+	same as that of a dedicated driver thread of the same priority, while
+	only requiring a single stack for all drivers.
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+#define DPC_NUM_PRIOS 8 //!< Number of DPC priority levels (0 is the highest)
+
+typedef struct DpcItem DpcItem;
+
+//! DPC function type
+typedef void (* DpcFn)(DpcItem* item);
+
+//! Deferred procedure call work item
+struct DpcItem {
+	DpcItem* next; //!< @private
+	DpcFn fn;      //!< @private
+	void* user;    //!< User data for the DPC function
+	u8 prio;       //!< @private
+	bool pending;  //!< @private
+};
+
+/*! @brief Prepares a DPC @p item for use
+	@param[in] fn Function to call when the item runs
+	@param[in] user User data for @p fn
+	@param[in] prio Priority level of the item (0 to @ref DPC_NUM_PRIOS-1, lower values run first)
+*/
+MK_INLINE void dpcItemPrepare(DpcItem* item, DpcFn fn, void* user, unsigned prio)
+{
+	item->next = NULL;
+	item->fn = fn;
+	item->user = user;
+	item->prio = prio < DPC_NUM_PRIOS ? prio : DPC_NUM_PRIOS-1;
+	item->pending = false;
+}
+
+/*! @brief Queues a DPC @p item to be run by the worker thread
+	@returns true if the item was queued, false if it was already pending
+	(in which case it only runs once).
+	@note This function can be called from interrupt handlers.
+*/
+bool dpcQueue(DpcItem* item);
+
+/*! @brief Removes a pending DPC @p item from the queue
+	@returns true if the item was removed, false if it was not pending.
+*/
+bool dpcCancel(DpcItem* item);
+
+/*! @brief Starts the DPC worker thread with the specified @p thread_prio
+	@note For DPCs to run before ordinary threads resume, @p thread_prio should
+	be higher than that of any thread that does not need to preempt DPCs
+	(e.g. @ref THREAD_MAX_PRIO).
+	@note Calling this function again once the server is started does nothing
+	(in particular, the priority of the worker thread is not changed).
+*/
+void dpcStartServer(u8 thread_prio);
+
+MK_EXTERN_C_END
+
+//! @}
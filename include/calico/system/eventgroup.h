@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "thread.h"
+
+/*! @addtogroup sync
+	@{
+*/
+/*! @name Event group
+	Synchronization primitive consisting of 32 independent event flags. Threads
+	can wait for any or all of a given set of flags to become set, optionally
+	clearing them upon wakeup. Event flags can be set from interrupt handlers.
+	@{
+*/
+
+MK_EXTERN_C_START
+
+#define EVENT_WAIT_ANY   0         //!< Wait for any of the specified flags to be set
+#define EVENT_WAIT_ALL   (1U << 0) //!< Wait for all of the specified flags to be set
+#define EVENT_WAIT_CLEAR (1U << 1) //!< Clear the flags that satisfied the wait
+
+//! Event group object
+typedef struct EventGroup {
+	ThrListNode waiters; //!< @private
+	u32 flags;           //!< @private
+} EventGroup;
+
+//! @brief Prepares an EventGroup object @p e for use, with the specified @p initial_flags
+MK_INLINE void eventGroupPrepare(EventGroup* e, u32 initial_flags)
+{
+	e->waiters.next = NULL;
+	e->waiters.prev = NULL;
+	e->flags = initial_flags;
+}
+
+//! @brief Returns the flags currently set in EventGroup @p e
+MK_INLINE u32 eventGroupGet(EventGroup* e)
+{
+	return e->flags;
+}
+
+//! @brief Sets the flags in @p mask of EventGroup @p e, waking up any threads whose wait is satisfied
+void eventGroupSet(EventGroup* e, u32 mask);
+
+//! @brief Clears the flags in @p mask of EventGroup @p e
+void eventGroupClear(EventGroup* e, u32 mask);
+
+/*! @brief Waits for the flags in @p mask of EventGroup @p e to be set
+	@param[in] mode Combination of EVENT_WAIT_\* flags
+	@returns The flags in @p mask that were set when the wait was satisfied.
+*/
+u32 eventGroupWait(EventGroup* e, u32 mask, unsigned mode);
+
+/*! @brief Like @ref eventGroupWait, but giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns The flags in @p mask that were set when the wait was satisfied, or 0 if the wait timed out.
+*/
+u32 eventGroupWaitTimeout(EventGroup* e, u32 mask, unsigned mode, u32 timeout_ticks);
+
+MK_EXTERN_C_END
+
+//! @}
+
+//! @}
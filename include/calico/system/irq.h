@@ -21,7 +21,8 @@ MK_EXTERN_C_START
 	@note ISRs execute in a special mode of the ARM CPU called <em>interrupt mode</em>,
 	or IRQ mode for short. This mode has its own dedicated stack independent of any
 	currently running thread. Interrupts are disabled while executing ISRs, meaning
-	they are unable to nest. Please exercise caution when writing an interrupt handler.
+	they are unable to nest (unless nested interrupt dispatch is enabled, see
+	@ref irqEnableNesting). Please exercise caution when writing an interrupt handler.
 	Do **not** call threading functions, C standard library functions, or access thread
 	local variables from within ISR mode. As an exception, it is possible to call
 	threadUnblock\* functions or @ref mailboxTrySend in order to wake up threads in
@@ -33,6 +34,15 @@ typedef void (*IrqHandler)(void);
 //! @private
 extern volatile IrqMask __irq_flags;
 
+//! @private
+extern u32 __irq_nest_depth;
+
+//! @private
+MK_EXTERN32 void _irqNestModifyIe(IrqMask set, IrqMask clear);
+
+//! @private
+MK_EXTERN32 void _irqNestPin(IrqMask mask);
+
 /*! @brief Assigns an interrupt service routine (ISR) to one or more interrupts
 	@param[in] mask Bitmask of interrupts to which assign the ISR
 	@param[in] handler Pointer to ISR (see @ref IrqHandler)
@@ -51,7 +61,11 @@ MK_INLINE void irqClear(IrqMask mask)
 MK_INLINE void irqEnable(IrqMask mask)
 {
 	IrqState st = irqLock();
-	REG_IE |= mask;
+	if_likely (!__irq_nest_depth) {
+		REG_IE |= mask;
+	} else {
+		_irqNestModifyIe(mask, 0);
+	}
 	irqUnlock(st);
 }
 
@@ -59,15 +73,71 @@ MK_INLINE void irqEnable(IrqMask mask)
 MK_INLINE void irqDisable(IrqMask mask)
 {
 	IrqState st = irqLock();
-	REG_IE &= ~mask;
+	if_likely (!__irq_nest_depth) {
+		REG_IE &= ~mask;
+	} else {
+		_irqNestModifyIe(0, mask);
+	}
 	irqUnlock(st);
 }
 
+/*! @name Nested interrupt dispatch
+
+	By default, ISRs run with interrupts disabled, so a long ISR delays the
+	handling of every other interrupt. Nested interrupt dispatch is an opt-in
+	mode in which each interrupt source is assigned a priority level, and the
+	ISRs of lower priority sources run with interrupts enabled so that higher
+	priority sources can preempt them. ISRs of sources that cannot be preempted
+	by any other source (including all sources while every source has the same
+	priority, which is the default) keep running with interrupts disabled.
+	Sources of the extended DSi ARM7 interrupt controller cannot be assigned a
+	priority: their ISRs are never preemptible, and the sources are masked while
+	any preemptible ISR runs.
+
+	While a preemptible ISR runs, sources of equal or lower priority are masked
+	in `REG_IE`. Such ISRs must use @ref irqEnable and @ref irqDisable instead of
+	modifying `REG_IE` directly, as direct changes are lost once the ISR returns.
+	Context switches requested by ISRs are deferred until all nested ISRs return.
+
+	The sources used by the tick subsystem (@ref tickInit and @ref tickHiresStart)
+	always take the highest priority level in use, regardless of @ref irqSetPrio,
+	and their ISRs are never preemptible.
+
+	Preemptible ISRs run on a separate stack provided by the application. Each
+	level of nesting also consumes 32 bytes of IRQ stack, which is very small on
+	the ARM7; keep the number of distinct priority levels in use low.
+	@{
+*/
+
+#define IRQ_NUM_PRIOS    4                 //!< Number of interrupt priority levels
+#define IRQ_PRIO_HIGHEST 0                 //!< Highest interrupt priority level
+#define IRQ_PRIO_DEFAULT (IRQ_NUM_PRIOS-1) //!< Default (and lowest) interrupt priority level
+
+/*! @brief Enables nested interrupt dispatch
+	@param[in] stack_top Top of the stack used by preemptible ISRs (must be 8-byte aligned),
+	or NULL to disable nested interrupt dispatch
+	@note The stack must be large enough to hold the simultaneous stack usage of
+	all preemptible ISRs, one per priority level.
+*/
+void irqEnableNesting(void* stack_top);
+
+/*! @brief Sets the priority level of one or more interrupt sources
+	@param[in] mask Bitmask of interrupts whose priority is to be set
+	@param[in] prio Priority level, from @ref IRQ_PRIO_HIGHEST to @ref IRQ_PRIO_DEFAULT
+	@note Priorities only take effect while nested interrupt dispatch is enabled.
+*/
+void irqSetPrio(IrqMask mask, unsigned prio);
+
+//! @}
+
 #if MK_IRQ_NUM_HANDLERS > 32
 
 //! @private
 extern volatile IrqMask __irq_flags2;
 
+//! @private
+MK_EXTERN32 void _irqNestModifyIe2(IrqMask set, IrqMask clear);
+
 //! Like @ref irqSet, but for the extended DSi ARM7 interrupt controller
 void irqSet2(IrqMask mask, IrqHandler handler);
 
@@ -81,7 +151,11 @@ MK_INLINE void irqClear2(IrqMask mask)
 MK_INLINE void irqEnable2(IrqMask mask)
 {
 	IrqState st = irqLock();
-	REG_IE2 |= mask;
+	if_likely (!__irq_nest_depth) {
+		REG_IE2 |= mask;
+	} else {
+		_irqNestModifyIe2(mask, 0);
+	}
 	irqUnlock(st);
 }
 
@@ -89,7 +163,11 @@ MK_INLINE void irqEnable2(IrqMask mask)
 MK_INLINE void irqDisable2(IrqMask mask)
 {
 	IrqState st = irqLock();
-	REG_IE2 &= ~mask;
+	if_likely (!__irq_nest_depth) {
+		REG_IE2 &= ~mask;
+	} else {
+		_irqNestModifyIe2(0, mask);
+	}
 	irqUnlock(st);
 }
 
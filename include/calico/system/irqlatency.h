@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+
+/*! @addtogroup irqlatency
+
+	Calico can optionally measure interrupt entry latency, that is, the time
+	elapsed between an interrupt being asserted and its handler being dispatched.
+	Measurements are only performed if calico was built with the
+	`CALICO_IRQ_LATENCY` option enabled; otherwise the functions in this module
+	do nothing.
+
+	Latency is sampled using a probe: a free-running hardware timer that raises
+	an interrupt at a fixed rate. Since the timer keeps counting after asserting
+	its interrupt, the value of its counter upon entering the dispatcher is the
+	number of cycles the interrupt was kept waiting for. Long waits are usually
+	caused by code running with interrupts disabled (such as sections protected
+	by @ref armIrqLockByPsr or @ref irqLock), or by other interrupt handlers.
+	For the longest waits, the address of the instruction that was interrupted
+	by the probe is recorded as well: it normally points right after the end of
+	the offending critical section.
+
+	Example usage:
+	@code
+	irqLatencyStart(1, 1000); // use hardware timer 1, sampling 1000 times per second
+
+	//...
+
+	IrqLatencyStats stats;
+	if (irqLatencyGetStats(&stats)) {
+		for (unsigned i = 0; i < IRQ_LATENCY_NUM_SITES && stats.sites[i].cycles; i ++) {
+			dietPrint("%08lx: %lu cycles\n", stats.sites[i].pc, stats.sites[i].cycles);
+		}
+	}
+	@endcode
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Number of buckets in the latency histogram
+#define IRQ_LATENCY_NUM_BUCKETS 17
+
+//! Number of code addresses tracked for the longest latencies
+#define IRQ_LATENCY_NUM_SITES 8
+
+//! Code address at which a delayed probe interrupt was taken
+typedef struct IrqLatencySite {
+	u32 pc;     //!< Address of the instruction interrupted by the probe
+	u32 cycles; //!< Longest latency observed at this address
+} IrqLatencySite;
+
+/*! @brief Interrupt latency statistics @see irqLatencyGetStats
+	@note All latencies are expressed in cycles of @ref TIMER_BASE_FREQ.
+*/
+typedef struct IrqLatencyStats {
+	u32 num_samples;  //!< Number of probe interrupts measured
+	u32 min_cycles;   //!< Shortest latency (only valid if num_samples is nonzero)
+	u32 max_cycles;   //!< Longest latency
+	u64 total_cycles; //!< Sum of all latencies, which can be used to obtain the average
+
+	//! Latency histogram: bucket 0 counts zero-cycle samples, and bucket N counts samples in the range [2^(N-1), 2^N)
+	u32 hist[IRQ_LATENCY_NUM_BUCKETS];
+
+	//! Addresses with the longest latencies, sorted from longest to shortest (unused entries are zero)
+	IrqLatencySite sites[IRQ_LATENCY_NUM_SITES];
+} IrqLatencyStats;
+
+/*! @brief Starts measuring interrupt latency, and clears previously collected statistics
+	@param[in] timer_id Hardware timer to use as the probe (0 or 1, see @ref timer)
+	@param[in] freq Sampling frequency in Hz
+	@returns true on success, false if latency measurement is not available.
+	@note Latencies longer than the probe period cannot be told apart from
+	shorter ones, so @p freq should be kept low enough (e.g. 1000 Hz).
+	@note The interrupt handler of the probe timer is taken over by this module.
+*/
+bool irqLatencyStart(unsigned timer_id, unsigned freq);
+
+//! @brief Stops measuring interrupt latency (collected statistics are kept)
+void irqLatencyStop(void);
+
+//! @brief Clears all collected interrupt latency statistics
+void irqLatencyReset(void);
+
+/*! @brief Retrieves interrupt latency statistics into @p out
+	@returns true on success, false if latency measurement is not available.
+*/
+bool irqLatencyGetStats(IrqLatencyStats* out);
+
+MK_EXTERN_C_END
+
+//! @}
@@ -15,14 +15,17 @@
 
 MK_EXTERN_C_START
 
-//! Mailbox object
+/*! @brief Mailbox object
+	@note The layout of this object changed in calico 0.1.0 (the waiter
+	counters were replaced by a queue of receivers); code built against older
+	headers must be rebuilt.
+*/
 typedef struct Mailbox {
-	u32* slots;          //!< @private
-	u8 num_slots;        //!< @private
-	u8 cur_slot;         //!< @private
-	u8 pending_slots;    //!< @private
-	u8 send_waiters : 4; //!< @private
-	u8 recv_waiters : 4; //!< @private
+	u32* slots;             //!< @private
+	u8 num_slots;           //!< @private
+	u8 cur_slot;            //!< @private
+	u8 pending_slots;       //!< @private
+	ThrListNode recv_queue; //!< @private
 } Mailbox;
 
 /*! @brief Prepares a Mailbox object @p mb for use
@@ -36,8 +39,8 @@ MK_INLINE void mailboxPrepare(Mailbox* mb, u32* slots, unsigned num_slots)
 	mb->num_slots = num_slots;
 	mb->cur_slot = 0;
 	mb->pending_slots = 0;
-	mb->send_waiters = 0;
-	mb->recv_waiters = 0;
+	mb->recv_queue.next = NULL;
+	mb->recv_queue.prev = NULL;
 }
 
 //! @brief Asynchronously sends a @p message to Mailbox @p mb.
@@ -50,6 +53,12 @@ bool mailboxTryRecv(Mailbox* mb, u32* out);
 //! @brief Receives a message from Mailbox @p mb, blocking the current thread if empty.
 u32 mailboxRecv(Mailbox* mb);
 
+/*! @brief Receives a message from Mailbox @p mb, blocking the current thread for at most @p timeout_ticks if empty.
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if a message was received into @p out, false if the wait timed out.
+*/
+bool mailboxRecvTimeout(Mailbox* mb, u32* out, u32 timeout_ticks);
+
 MK_EXTERN_C_END
 
 //! @}
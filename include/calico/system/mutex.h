@@ -14,6 +14,14 @@
 	thread is waiting on a mutex held by a lower priority thread; said lower
 	thread temporarily inherits the priority of the higher thread, so that the
 	lower thread gets a chance to run and does not result in priority inversion.
+
+	@note The C library's non-recursive locks (used by `pthread_mutex_t` and in
+	turn `std::mutex`, among others) are instead implemented as single word
+	locks built on @ref threadWaitOnAddress, which are cheaper but do **not**
+	implement priority inheritance. Recursive locks (such as
+	`std::recursive_mutex`) are backed by @ref RMutex and do. Code shared
+	between threads of different priorities that needs priority inheritance
+	should use @ref Mutex directly.
 	@{
 */
 
@@ -47,6 +55,12 @@ bool mutexTryLock(Mutex* m);
 //! @brief Locks the Mutex @p m
 void mutexLock(Mutex* m);
 
+/*! @brief Locks the Mutex @p m, giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if the mutex was locked, false if the wait timed out.
+*/
+bool mutexLockTimeout(Mutex* m, u32 timeout_ticks);
+
 /*! @brief Unlocks the Mutex @p m
 	@warning @p m **must** be held by the current thread
 */
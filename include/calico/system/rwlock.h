@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "thread.h"
+
+/*! @addtogroup sync
+	@{
+*/
+/*! @name Reader-writer lock
+	Synchronization primitive that allows multiple threads to read shared data
+	simultaneously, while giving exclusive access to threads that modify it.
+	Waiting writers take precedence over new readers, so that writers do not
+	starve. Like @ref Mutex, reader-writer locks implement priority inheritance:
+	threads waiting for the lock boost the priority of the writer that holds it,
+	or that of one of the readers holding it.
+	@note Priority inheritance is only applied to readers for the first
+	reader-writer lock they hold at a time. Additional read locks held
+	simultaneously by the same thread are accounted for anonymously.
+	@note `pthread_rwlock_t` (and in turn `std::shared_mutex`) is not backed by
+	this object: newlib builds it on top of its own lock and condition variable
+	hooks, and offers no hooks for reader-writer locks. As such, it does **not**
+	implement priority inheritance.
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! @brief Reader-writer lock object
+typedef struct RwLock {
+	Thread* owner;  //!< @private
+	Thread* rdlist; //!< @private
+	u16 readers;    //!< @private
+	u16 wwait;      //!< @private
+} RwLock;
+
+//! @brief Returns true if @p l is held for writing by the current thread
+MK_INLINE bool rwlockIsWriteLockedByCurrentThread(RwLock* l)
+{
+	return !l->readers && l->owner == threadGetSelf();
+}
+
+//! @brief Attempts to lock the RwLock @p l for reading
+bool rwlockTryReadLock(RwLock* l);
+
+//! @brief Locks the RwLock @p l for reading
+void rwlockReadLock(RwLock* l);
+
+/*! @brief Locks the RwLock @p l for reading, giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if the lock was acquired, false if the wait timed out.
+*/
+bool rwlockReadLockTimeout(RwLock* l, u32 timeout_ticks);
+
+/*! @brief Releases a read lock on the RwLock @p l
+	@warning @p l **must** be held for reading by the current thread
+*/
+void rwlockReadUnlock(RwLock* l);
+
+//! @brief Attempts to lock the RwLock @p l for writing
+bool rwlockTryWriteLock(RwLock* l);
+
+//! @brief Locks the RwLock @p l for writing
+void rwlockWriteLock(RwLock* l);
+
+/*! @brief Locks the RwLock @p l for writing, giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if the lock was acquired, false if the wait timed out.
+*/
+bool rwlockWriteLockTimeout(RwLock* l, u32 timeout_ticks);
+
+/*! @brief Releases the write lock on the RwLock @p l
+	@warning @p l **must** be held for writing by the current thread
+*/
+void rwlockWriteUnlock(RwLock* l);
+
+MK_EXTERN_C_END
+
+//! @}
+
+//! @}
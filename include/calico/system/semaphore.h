@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "thread.h"
+
+/*! @addtogroup sync
+	@{
+*/
+/*! @name Semaphore
+	Synchronization primitive that maintains a count of available resources.
+	Threads wait for the count to become nonzero and consume one unit, while
+	signalling the semaphore releases one unit. Waiting threads are woken up in
+	priority order, and units are handed directly to them. Semaphores can be
+	signalled from interrupt handlers.
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Semaphore object
+typedef struct Semaphore {
+	ThrListNode waiters; //!< @private
+	u32 count;           //!< @private
+} Semaphore;
+
+//! @brief Prepares a Semaphore object @p s for use, with the specified @p initial_count
+MK_INLINE void semaphorePrepare(Semaphore* s, u32 initial_count)
+{
+	s->waiters.next = NULL;
+	s->waiters.prev = NULL;
+	s->count = initial_count;
+}
+
+//! @brief Returns the number of units currently available in Semaphore @p s
+MK_INLINE u32 semaphoreGetCount(Semaphore* s)
+{
+	return s->count;
+}
+
+//! @brief Releases one unit to Semaphore @p s, waking up the highest priority waiting thread if any.
+void semaphoreSignal(Semaphore* s);
+
+//! @brief Consumes one unit from Semaphore @p s without blocking.
+//! Returns true on success, false if no units were available.
+bool semaphoreTryWait(Semaphore* s);
+
+//! @brief Consumes one unit from Semaphore @p s, blocking the current thread if none are available.
+void semaphoreWait(Semaphore* s);
+
+/*! @brief Like @ref semaphoreWait, but giving up after @p timeout_ticks
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if a unit was consumed, false if the wait timed out.
+*/
+bool semaphoreWaitTimeout(Semaphore* s, u32 timeout_ticks);
+
+MK_EXTERN_C_END
+
+//! @}
+
+//! @}
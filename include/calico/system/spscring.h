@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "thread.h"
+
+/*! @addtogroup sync
+	@{
+*/
+/*! @name Single-producer/single-consumer ring
+	Circular buffer used to stream data from one producer to one consumer, such
+	as from an interrupt handler to a thread. Unlike @ref Mailbox, transfers are
+	not limited to single words, and neither side disables interrupts unless the
+	consumer needs to block. The ring can be used either as a byte stream or as
+	a queue of fixed-size records, which are always transferred as a whole.
+
+	At most one context may produce and at most one context may consume at any
+	given time. Interrupt handlers count as a single context as long as they do
+	not preempt each other: when nested interrupt dispatch is enabled (see
+	@ref irqEnableNesting), handlers sharing a side of the ring must access it
+	with interrupts disabled (e.g. with @ref armIrqLockByPsr). Both sides must
+	run on the same CPU.
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Single-producer/single-consumer ring object
+typedef struct SpscRing {
+	u8* buf;      //!< @private
+	u32 size;     //!< @private
+	vu32 head;    //!< @private
+	vu32 tail;    //!< @private
+	vu32 waiting; //!< @private
+} SpscRing;
+
+/*! @brief Prepares a SpscRing object @p r for use
+	@param[in] buf Storage space for the ring
+	@param[in] size Capacity of the storage space in bytes (must be a power of two)
+	@note The storage space must remain valid throughout the lifetime of the SpscRing object.
+*/
+MK_INLINE void spscRingPrepare(SpscRing* r, void* buf, size_t size)
+{
+	r->buf = (u8*)buf;
+	r->size = size;
+	r->head = 0;
+	r->tail = 0;
+	r->waiting = 0;
+}
+
+//! @brief Returns the number of bytes currently held by SpscRing @p r
+MK_INLINE size_t spscRingGetUsed(SpscRing* r)
+{
+	return r->head - r->tail;
+}
+
+//! @brief Returns the number of bytes that can currently be written to SpscRing @p r
+MK_INLINE size_t spscRingGetFree(SpscRing* r)
+{
+	return r->size - (r->head - r->tail);
+}
+
+/*! @brief Writes up to @p size bytes from @p data into SpscRing @p r (producer side)
+	@returns Number of bytes actually written, which is less than @p size if the ring fills up.
+*/
+size_t spscRingWrite(SpscRing* r, const void* data, size_t size);
+
+/*! @brief Reads up to @p size bytes from SpscRing @p r into @p out (consumer side)
+	@returns Number of bytes actually read, which is less than @p size if the ring empties.
+*/
+size_t spscRingRead(SpscRing* r, void* out, size_t size);
+
+/*! @brief Reads between 1 and @p size bytes from SpscRing @p r into @p out,
+	blocking the current thread while the ring is empty (consumer side)
+	@returns Number of bytes actually read.
+*/
+size_t spscRingReadWait(SpscRing* r, void* out, size_t size);
+
+/*! @brief Writes the @p size byte record @p rec into SpscRing @p r (producer side)
+	@returns true on success, false (writing nothing) if there is not enough free space.
+*/
+bool spscRingPush(SpscRing* r, const void* rec, size_t size);
+
+/*! @brief Reads a @p size byte record from SpscRing @p r into @p rec (consumer side)
+	@returns true on success, false (reading nothing) if no complete record is available.
+*/
+bool spscRingPop(SpscRing* r, void* rec, size_t size);
+
+/*! @brief Reads a @p size byte record from SpscRing @p r into @p rec,
+	blocking the current thread until one is available (consumer side)
+	@note @p size must not exceed the capacity of the ring.
+*/
+void spscRingPopWait(SpscRing* r, void* rec, size_t size);
+
+MK_EXTERN_C_END
+
+//! @}
+
+//! @}
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: ZPL-2.1
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
 #pragma once
+#include <calico/config.h>
 #include "../types.h"
 #include "../arm/common.h"
 #include "irq.h"
@@ -15,9 +16,11 @@
 	times that the currently running thread is always the highest priority thread
 	that can run. If any event occurs that causes a higher priority thread to
 	become runnable, Calico will preempt the current thread. Unlike in common PC
-	operating systems, Calico presently does not implement timeslicing to share
-	the CPU between threads of the same priority; meaning it is necessary to
-	explicitly yield control of the CPU if any such threads exist.
+	operating systems, Calico does not timeslice between threads of the same
+	priority by default; meaning it is necessary to explicitly yield control of
+	the CPU if any such threads exist. Round-robin timeslicing can optionally be
+	enabled per priority level or per thread (see @ref threadSetPrioQuantum and
+	@ref threadSetQuantum).
 
 	While Calico provides its own threading API, it is also possible to use standard
 	threading APIs such as POSIX threads or C++ threads. These APIs are in fact
@@ -43,6 +46,7 @@ typedef enum ThrStatus {
 	ThrStatus_Running,
 	ThrStatus_Waiting,
 	ThrStatus_WaitingOnMutex,
+	ThrStatus_WaitingOnRwLock,
 } ThrStatus;
 
 #define THREAD_MAX_PRIO 0x00 //!< Maximum priority value of a thread
@@ -50,6 +54,29 @@ typedef enum ThrStatus {
 
 #define MAIN_THREAD_PRIO 0x1c //!< Default priority value of the main thread
 
+//! Per-thread CPU usage statistics @see threadGetStats
+typedef struct ThrStats {
+	u64 run_ticks;   //!< Time spent running (excluding interrupt handlers), in system ticks
+	u32 switches;    //!< Number of times the thread was switched in
+	u32 voluntary;   //!< Number of times the thread gave up the CPU (blocking, pausing, yielding or exiting)
+	u32 involuntary; //!< Number of times the thread was preempted
+} ThrStats;
+
+//! Scheduler-wide CPU usage statistics @see schedGetStats
+typedef struct SchedStats {
+	u64 uptime_ticks; //!< Time elapsed since the tick counter was started
+	u64 idle_ticks;   //!< Time spent in the idle thread (excluding interrupt handlers)
+	u64 irq_ticks;    //!< Time spent in interrupt handlers
+	u32 irq_count;    //!< Number of interrupt handlers dispatched
+	u32 switches;     //!< Number of context switches
+} SchedStats;
+
+//! Thread stack usage information @see threadGetStackUsage
+typedef struct ThrStackUsage {
+	u32 size; //!< Usable size of the stack, in bytes
+	u32 peak; //!< Maximum amount of stack space used so far, in bytes
+} ThrStackUsage;
+
 //! Thread entrypoint type
 typedef int (* ThreadFunc)(void* arg);
 
@@ -60,11 +87,20 @@ struct Thread {
 	void* tp;            //!< Virtual thread-local segment register
 	void* impure;        //!< Pointer to per-thread C standard library state
 
-	Thread* next;        //!< @private
+	ThrListNode sched;   //!< @private
 	ThrStatus status;    //!< @private
 	u8 prio;             //!< Current thread priority (including inheritance)
 	u8 baseprio;         //!< Nominal thread priority (not including inheritance)
 	u8 pause;            //!< @private
+	u32 quantum;         //!< @private
+#if defined(CALICO_STACK_CHECK)
+	void* stack;         //!< @private
+	u32 stack_size;      //!< @private
+#endif
+
+	struct RwLock* rwlock; //!< @private
+	Thread* rwnext;      //!< @private
+	u32 rwcount;         //!< @private
 
 	ThrListNode waiters; //!< @private
 
@@ -80,19 +116,24 @@ struct Thread {
 			int rc;
 		};
 	}; //!< @private
+
+#if defined(CALICO_THREAD_STATS)
+	ThrStats stats;      //!< @private
+#endif
 };
 
 //! @private
 typedef struct ThrSchedState {
 	Thread *cur;
 	Thread *deferred;
-	Thread *first;
 	IrqMask irqWaitMask;
 	ThrListNode irqWaitList;
 #if MK_IRQ_NUM_HANDLERS > 32
 	IrqMask irqWaitMask2;
 	ThrListNode irqWaitList2;
 #endif
+	u32 readyMask[2];
+	ThrListNode readyQueue[THREAD_MIN_PRIO+2];
 } ThrSchedState;
 
 /*! @name Thread initialization and synchronization
@@ -126,6 +167,15 @@ typedef struct ThrSchedState {
 */
 void threadPrepare(Thread* t, ThreadFunc entrypoint, void* arg, void* stack_top, u8 prio);
 
+/*! @brief Like @ref threadPrepare, but taking the bounds of the stack instead of its top
+	@param[in] stack Lowest address of the stack buffer (must be 8-byte aligned)
+	@param[in] stack_size Size of the stack buffer in bytes (must be a multiple of 8)
+
+	Knowing the whole stack allows calico to check it for overflows and measure
+	its usage (see @ref threadGetStackUsage).
+*/
+void threadPrepareWithStack(Thread* t, ThreadFunc entrypoint, void* arg, void* stack, size_t stack_size, u8 prio);
+
 //! @brief Returns the required size for thread-local storage (8-byte aligned) @see threadAttachLocalStorage
 size_t threadGetLocalStorageSize(void);
 
@@ -155,6 +205,13 @@ void threadSetPrio(Thread* t, u8 prio);
 */
 int threadJoin(Thread* t);
 
+/*! @brief Waits for the @ref Thread @p t to finish executing, giving up after @p timeout_ticks
+	@param[out] out_rc Optional output for the result code of the thread
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@returns true if the thread finished, false if the wait timed out.
+*/
+bool threadJoinTimeout(Thread* t, int* out_rc, u32 timeout_ticks);
+
 //! @}
 
 /*! @name Basic thread operations
@@ -243,6 +300,32 @@ MK_EXTERN32 void threadUnblockAllByMask(ThrListNode* queue, u32 ref);
 //! @brief Removes thread @p t from the specified @p queue
 MK_EXTERN32 void threadBlockCancel(ThrListNode* queue, Thread* t);
 
+/*! @brief Like @ref threadBlock, but automatically cancelling the wait after @p timeout_ticks elapse.
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY) @see ticksFromUsec
+	@return 0 if the wait timed out (or threadBlockCancel was called), otherwise same as @ref threadBlock.
+*/
+u32 threadBlockTimeout(ThrListNode* queue, u32 token, u32 timeout_ticks);
+
+/*! @brief Blocks the current thread if the word at @p addr contains the @p expected value
+
+	This is a building block for lock-free data structures, which can use it to
+	sleep until another thread changes a word in memory. The comparison and the
+	blocking are performed atomically with respect to @ref threadWakeAddress, so
+	a wakeup issued after the word was modified is never missed. Waiters are kept
+	in a small table of wait queues hashed by address, so no storage is needed
+	besides the word itself.
+
+	@returns true if the thread blocked and was woken up, false if `*addr` did not
+	contain @p expected. Callers should recheck the word in either case.
+*/
+bool threadWaitOnAddress(volatile u32* addr, u32 expected);
+
+/*! @brief Wakes up at most @p count threads waiting on @p addr @see threadWaitOnAddress
+	@note Threads are woken up in priority order. Pass UINT32_MAX to wake up all of them.
+	This function can be called from interrupt handlers.
+*/
+void threadWakeAddress(volatile u32* addr, u32 count);
+
 //! @}
 
 /*! @name Thread sleeping
@@ -279,6 +362,112 @@ MK_INLINE void threadTimerStart(TickTask* task, u32 period_hz)
 
 //! @}
 
+/*! @name Thread timeslicing
+
+	By default, a running thread keeps the CPU until it blocks, yields or is
+	preempted by a higher priority thread. These functions enable round-robin
+	timeslicing, in which the current thread is moved to the back of its
+	priority level once its quantum expires, letting other runnable threads of
+	the same priority run. Timeslicing is driven by a @ref TickTask that only
+	runs while at least one quantum is configured.
+
+	@{
+*/
+
+/*! @brief Sets the timeslice quantum of all threads with priority @p prio
+	@param[in] quantum_ticks Quantum in system ticks, or 0 to disable timeslicing @see ticksFromUsec
+*/
+void threadSetPrioQuantum(u8 prio, u32 quantum_ticks);
+
+/*! @brief Sets the timeslice quantum of @ref Thread @p t
+	@param[in] quantum_ticks Quantum in system ticks, or 0 to use the setting of
+	the priority level of the thread @see threadSetPrioQuantum
+*/
+void threadSetQuantum(Thread* t, u32 quantum_ticks);
+
+//! @}
+
+/*! @name Thread statistics
+
+	CPU usage accounting is only performed if calico was built with the
+	`CALICO_THREAD_STATS` option enabled, which adds a small amount of overhead
+	to every context switch and interrupt. Otherwise, these functions return false.
+
+	@{
+*/
+
+/*! @brief Retrieves CPU usage statistics for @ref Thread @p t into @p out
+	@returns true on success, false if statistics are not available.
+*/
+bool threadGetStats(Thread* t, ThrStats* out);
+
+/*! @brief Retrieves scheduler-wide CPU usage statistics into @p out
+	@returns true on success, false if statistics are not available.
+*/
+bool schedGetStats(SchedStats* out);
+
+//! @}
+
+/*! @name Thread stack checking
+
+	Stack checking is only performed if calico was built with the `CALICO_STACK_CHECK`
+	option enabled, and only for threads prepared with @ref threadPrepareWithStack.
+	The stack is filled with a known pattern when the thread is prepared, which
+	allows measuring how much of it was used. In addition, the bottom of the stack
+	of the outgoing thread is verified on every context switch. If it was
+	overwritten, calico raises an Undefined Instruction exception (`udf #0x5354`)
+	with r0 pointing to the offending @ref Thread, which is reported by the
+	installed exception handler.
+
+	On the ARM9, stacks aligned to @ref THREAD_STACK_GUARD_SZ and at least twice
+	as large as it additionally have their lowest @ref THREAD_STACK_GUARD_SZ bytes
+	protected by the MPU while the thread is running, which causes overflows to
+	raise a data abort as soon as they happen. This memory is not usable as stack.
+	Stacks located in DTCM never receive a guard, since the DTCM region takes
+	precedence over it in the MPU.
+
+	@{
+*/
+
+#define THREAD_STACK_GUARD_SZ 0x1000 //!< Size of the ARM9 MPU stack guard region
+
+/*! @brief Retrieves stack usage information for @ref Thread @p t into @p out
+	@returns true on success, false if stack checking is not available for the thread.
+*/
+bool threadGetStackUsage(Thread* t, ThrStackUsage* out);
+
+//! @}
+
+/*! @name POSIX thread pool
+
+	Threads created through `pthread_create` (and in turn `std::thread`) normally
+	allocate their control block, thread-local storage and stack from the heap.
+	Applications that frequently create short-lived threads can instead set up
+	classes of preallocated slots, from which these threads are allocated in
+	constant time. Each class holds slots with a given stack size; threads are
+	allocated from the smallest class that fits the requested stack size, and
+	fall back to the heap when no suitable slot is available.
+
+	@{
+*/
+
+#define PTHREAD_POOL_MAX_CLASSES 4 //!< Maximum number of slot classes
+
+//! @brief Returns the size of a single slot for threads with the specified @p stack_size
+size_t pthreadPoolGetSlotSize(size_t stack_size);
+
+/*! @brief Adds a class of preallocated thread slots
+	@param[in] mem 8-byte aligned storage for the slots, of at least
+	`num_slots * pthreadPoolGetSlotSize(stack_size)` bytes
+	@param[in] num_slots Number of slots
+	@param[in] stack_size Stack size of the threads allocated from this class (must be a multiple of 8)
+	@returns true on success, false if the maximum number of classes was exceeded.
+	@note The storage must remain valid for the lifetime of the program.
+*/
+bool pthreadPoolAddClass(void* mem, size_t num_slots, size_t stack_size);
+
+//! @}
+
 //! @brief Returns true if thread @p t is valid
 MK_CONSTEXPR bool threadIsValid(Thread* t)
 {
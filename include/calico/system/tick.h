@@ -11,6 +11,12 @@
 //! Frequency in Hz of the system timer used for counting ticks
 #define TICK_FREQ (SYSTEM_CLOCK/64)
 
+//! Frequency in Hz of the high resolution clock @see tickHiresGetCount
+#define TICK_HIRES_FREQ SYSTEM_CLOCK
+
+//! Maximum delay in ticks that can be passed to @ref tickTaskStart (and functions with timeouts)
+#define TICK_MAX_DELAY 0x7fffffffU
+
 MK_EXTERN_C_START
 
 // Forward declaration
@@ -25,10 +31,11 @@ typedef void (* TickTaskFn)(TickTask* t);
 
 //! Tick task object, representing a scheduled timed event
 struct TickTask {
-	TickTask* next; //!< @private
-	u32 target;     //!< @private
-	u32 period;     //!< @private
-	TickTaskFn fn;  //!< @private
+	TickTask* next;   //!< @private
+	TickTask** pprev; //!< @private
+	u32 target;       //!< @private
+	u32 period;       //!< @private
+	TickTaskFn fn;    //!< @private
 };
 
 //! Converts microseconds (@p us) to system ticks
@@ -46,9 +53,27 @@ MK_CONSTEXPR u32 ticksFromHz(u32 hz)
 //! @private
 void tickInit(void);
 
-//! Returns the current value of the system tick counter
+/*! @brief Returns the current value of the system tick counter
+	@note This function does not disable interrupts, and can be called from any context.
+*/
 u64 tickGetCount(void);
 
+/*! @brief Starts the high resolution clock @see tickHiresGetCount
+	@note The high resolution clock is built from hardware timers 0 and 1 chained
+	together, which are reserved from then on. It must not be used together with
+	other users of these timers, such as the CPU timer mode of the ARM7 microphone
+	driver or @ref irqLatencyStart.
+*/
+void tickHiresStart(void);
+
+/*! @brief Returns the current value of the high resolution clock, in units of @ref TICK_HIRES_FREQ
+	@note The high resolution clock shares the time base of the system tick counter,
+	that is, its value is always close to @ref tickGetCount multiplied by
+	`TICK_HIRES_FREQ/TICK_FREQ`. If @ref tickHiresStart was not called, the value
+	is derived from the system tick counter instead (with its lower resolution).
+*/
+u64 tickHiresGetCount(void);
+
 /*! @brief Configures and starts a tick task @p t
 	@param[in] fn Event callback to invoke when the tick task needs to run.
 	@param[in] delay_ticks Time to wait (in system ticks) for the first invocation of the task.
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+
+/*! @addtogroup trace
+
+	Calico can optionally record scheduler, interrupt and PXI events into a ring
+	buffer in RAM, with very little impact on timing. Recording is only performed
+	if calico was built with the `CALICO_TRACE` option enabled; otherwise the
+	functions in this module do nothing. The ring can be copied out at any time
+	into a dump, which can be written to storage and converted on a PC into the
+	Chrome trace event format using the `calico-trace` tool found in the tools
+	directory of the source tree.
+
+	Example usage:
+	@code
+	alignas(32) static u8 s_traceDump[TRACE_DUMP_MAX_SZ];
+
+	//...
+
+	size_t size = traceSnapshot(s_traceDump, sizeof(s_traceDump));
+	blkDevWriteSectors(BlkDevice_TwlSdCard, s_traceDump, first_sector, (size + BLK_SECTOR_SZ - 1) / BLK_SECTOR_SZ);
+	@endcode
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Number of entries in the trace ring (must be a power of two)
+#define TRACE_NUM_ENTRIES 256
+
+//! Magic value identifying a trace dump ("CTRC")
+#define TRACE_MAGIC 0x43525443
+
+//! Version of the trace dump format
+#define TRACE_VERSION 1
+
+//! Maximum size of a trace dump in bytes
+#define TRACE_DUMP_MAX_SZ (sizeof(TraceHeader) + TRACE_NUM_ENTRIES*sizeof(TraceEntry))
+
+//! Trace event types
+typedef enum TraceEvent {
+	TraceEvent_Switch    = 0, //!< Context switch (arg0 = previous thread, arg1 = next thread)
+	TraceEvent_Block     = 1, //!< Current thread blocked (arg0 = queue, arg1 = token)
+	TraceEvent_Unblock   = 2, //!< Thread unblocked (arg0 = thread, arg1 = resulting token)
+	TraceEvent_IrqEnter  = 3, //!< Interrupt handler entered (aux = interrupt ID)
+	TraceEvent_IrqExit   = 4, //!< Interrupt handler exited
+	TraceEvent_TickTask  = 5, //!< TickTask callback invoked (arg0 = task, arg1 = callback)
+	TraceEvent_PxiSend   = 6, //!< PXI word sent (aux = channel, arg0 = word)
+	TraceEvent_PxiRecv   = 7, //!< PXI word received (aux = channel, arg0 = word)
+} TraceEvent;
+
+//! Header of a trace dump
+typedef struct TraceHeader {
+	u32 magic;       //!< Must be @ref TRACE_MAGIC
+	u16 version;     //!< Must be @ref TRACE_VERSION
+	u16 entry_sz;    //!< Size of each entry in bytes
+	u32 num_entries; //!< Number of entries following the header
+	u32 tick_freq;   //!< Frequency of the timestamps in Hz
+} TraceHeader;
+
+/*! @brief Trace dump entry
+	@note Entries are stored in the order they were recorded. The timestamp is
+	read before an entry is recorded, so an event whose recording was preempted
+	by an interrupt handler can carry an earlier timestamp than the events
+	recorded by the handler, which precede it in the dump.
+*/
+typedef struct TraceEntry {
+	u32 timestamp;   //!< Low 32 bits of the tick counter
+	u16 type;        //!< Event type (see @ref TraceEvent)
+	u16 aux;         //!< Event specific data
+	u32 arg0;        //!< Event specific data
+	u32 arg1;        //!< Event specific data
+} TraceEntry;
+
+/*! @brief Copies the contents of the trace ring into @p buf, oldest event first
+	@param[out] buf Output buffer (must be 32-bit aligned)
+	@param[in] size Size of the output buffer (@ref TRACE_DUMP_MAX_SZ bytes is always enough)
+	@returns Size of the dump in bytes, or 0 if tracing is not available.
+	@note Events that do not fit in the output buffer are discarded, starting from the oldest.
+*/
+size_t traceSnapshot(void* buf, size_t size);
+
+//! @brief Discards all events currently stored in the trace ring
+void traceClear(void);
+
+MK_EXTERN_C_END
+
+//! @}
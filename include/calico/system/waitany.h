@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include "../types.h"
+#include "irq.h"
+#include "tick.h"
+#include "thread.h"
+#include "mailbox.h"
+
+/*! @addtogroup thread
+	@{
+*/
+/*! @name Waiting on multiple objects
+
+	These functions allow a single thread to wait on several event sources at
+	once, such as mailboxes, interrupts and timers. This makes it possible for
+	a single service thread to handle multiple low-rate event sources, instead
+	of dedicating a thread (and its stack) to each of them.
+
+	@{
+*/
+
+MK_EXTERN_C_START
+
+//! Types of objects that can be waited on by @ref threadWaitAny
+typedef enum ThrWaitType {
+	ThrWaitType_Mailbox, //!< Ready when the mailbox contains messages (which are not received)
+	ThrWaitType_Irq,     //!< Ready when any of the interrupts fire (same semantics as @ref threadIrqWait with next_irq=false)
+	ThrWaitType_Timer,   //!< Ready when the timer (started with @ref threadTimerStartTicks) fires
+} ThrWaitType;
+
+//! Object to wait on with @ref threadWaitAny
+typedef struct ThrWaitObj {
+	ThrWaitType type;      //!< Type of the object
+	union {
+		Mailbox* mailbox;  //!< Mailbox to wait on
+		IrqMask irq_mask;  //!< Interrupts to wait on
+		TickTask* timer;   //!< Timer to wait on
+	};
+	u32 result;            //!< Filled in when the object becomes ready: number of pending messages, mask of fired interrupts, or 1 for timers
+} ThrWaitObj;
+
+//! Special timeout value that makes @ref threadWaitAny wait indefinitely
+#define THREAD_WAIT_INFINITE UINT32_MAX
+
+/*! @brief Waits for any of the specified objects to become ready
+	@param[inout] objs Array of objects to wait on
+	@param[in] num_objs Number of objects in the array (at most 32)
+	@param[in] timeout_ticks Maximum time to wait in system ticks (must not exceed @ref TICK_MAX_DELAY),
+	or @ref THREAD_WAIT_INFINITE @see ticksFromUsec
+	@return Bitmask of the objects that became ready (bit N corresponds to objs[N]), or 0 if the wait timed out.
+	@note Timer expirations are only recorded while the thread is waiting (like @ref threadTimerWait),
+	whereas interrupt flags and mailbox messages are kept until consumed.
+*/
+u32 threadWaitAny(ThrWaitObj* objs, unsigned num_objs, u32 timeout_ticks);
+
+MK_EXTERN_C_END
+
+//! @}
+
+//! @}
@@ -61,7 +61,7 @@ void mwlDevStart(void)
 
 	// Start task handler thread
 	s_mwlState.task_mask = 0;
-	threadPrepare(&s_mwlThread, _mwlTaskHandler, NULL, &s_mwlThreadStack[sizeof(s_mwlThreadStack)], 0x11);
+	threadPrepareWithStack(&s_mwlThread, _mwlTaskHandler, NULL, s_mwlThreadStack, sizeof(s_mwlThreadStack), 0x11);
 	threadStart(&s_mwlThread);
 
 	// Set mode, disable powersave
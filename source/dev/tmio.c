@@ -470,13 +470,25 @@ int tmioThreadMain(TmioCtl* ctl)
 	return 0;
 }
 
-bool tmioTransact(TmioCtl* ctl, TmioTx* tx)
+bool tmioTransactAsync(TmioCtl* ctl, TmioTx* tx)
 {
 	ArmIrqState st = armIrqLockByPsr();
 
 	tx->status = TMIO_STAT_CMD_BUSY;
-	if_unlikely (!mailboxTrySend(&ctl->mbox, (u32)tx)) {
+	bool rc = mailboxTrySend(&ctl->mbox, (u32)tx);
+	if_unlikely (!rc) {
 		tx->status = TMIO_STAT_RX_OVERFLOW;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+bool tmioTransact(TmioCtl* ctl, TmioTx* tx)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (!tmioTransactAsync(ctl, tx)) {
 		armIrqUnlockByPsr(st);
 		return false;
 	}
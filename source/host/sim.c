@@ -0,0 +1,497 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/irq.h>
+#include <calico/system/tick.h>
+#include <calico/gba/timer.h>
+#include <calico/host/sim.h>
+#include "../system/thread-priv.h"
+
+typedef struct HostFiber {
+	ucontext_t uc;
+	void* stack;
+	ArmContext* ctx;
+	bool suspended;
+} HostFiber;
+
+typedef struct HostTimer {
+	bool running;
+	u16 ctl;
+	u16 reload;
+	u16 written;
+	u32 base_count;
+	u64 base_cycle;
+} HostTimer;
+
+alignas(8) unsigned char __host_io[MM_IO_SZ];
+volatile IrqMask __irq_flags;
+
+static u32 s_hostCpsr = ARM_PSR_MODE_SYS;
+static u64 s_hostCycles;
+static HostTimer s_hostTimers[4];
+static HostFiber* s_hostCurFiber;
+static HostFiber* s_hostZombie;
+#if defined(CALICO_IRQ_LATENCY)
+static u32 s_hostIrqPc; // stand-in for the interrupted PC: last caller to unmask interrupts
+#endif
+
+extern IrqHandler __irq_table[MK_IRQ_NUM_HANDLERS];
+extern u32 __irq_nest_allow[MK_IRQ_NUM_HANDLERS];
+
+void* _irqNestEnter(unsigned id);
+void _irqNestExit(void);
+#if defined(CALICO_IRQ_LATENCY)
+void _irqLatencyEnter(unsigned irq_id, u32 pc);
+#endif
+
+void _threadInit(void);
+
+void _hostSimBadAddress(const volatile void* p)
+{
+	fprintf(stderr, "calico: object at %p is outside the low 4 GiB of the address space\n", (const void*)p);
+	abort();
+}
+
+static void __attribute__((constructor)) _hostSimInit(void)
+{
+	// Static objects are only addressable through 32-bit tokens in non-PIE executables
+	threadPtrToToken(&__sched_state);
+
+	REG_IME = 1;
+	_threadInit();
+}
+
+//-----------------------------------------------------------------------------
+// CPU intrinsics
+//-----------------------------------------------------------------------------
+
+static void _hostIrqCheck(void);
+
+u32 armGetCpsr(void)
+{
+	return s_hostCpsr;
+}
+
+void armSetCpsrC(u32 value)
+{
+	s_hostCpsr = (s_hostCpsr &~ 0xff) | (value & 0xff);
+#if defined(CALICO_IRQ_LATENCY)
+	s_hostIrqPc = (uptr)__builtin_return_address(0);
+#endif
+	_hostIrqCheck();
+}
+
+ArmIrqState armIrqLockByPsr(void)
+{
+	u32 psr = s_hostCpsr;
+	s_hostCpsr = psr | ARM_PSR_I | ARM_PSR_F;
+	return psr & (ARM_PSR_I | ARM_PSR_F);
+}
+
+void armIrqUnlockByPsr(ArmIrqState st)
+{
+	s_hostCpsr = (s_hostCpsr &~ (ARM_PSR_I | ARM_PSR_F)) | st;
+#if defined(CALICO_IRQ_LATENCY)
+	s_hostIrqPc = (uptr)__builtin_return_address(0);
+#endif
+	_hostIrqCheck();
+}
+
+u32 armSwapWord(u32 value, u32* addr)
+{
+	// Simulated interrupts cannot occur in the middle of this function
+	u32 ret = *addr;
+	*addr = value;
+	return ret;
+}
+
+u8 armSwapByte(u8 value, u8* addr)
+{
+	u8 ret = *addr;
+	*addr = value;
+	return ret;
+}
+
+void armCopyMem32(void* dst, const void* src, size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+void armFillMem32(void* dst, u32 value, size_t size)
+{
+	u32* p = (u32*)dst;
+	for (size_t i = 0; i < size/4; i ++) {
+		p[i] = value;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Context switching
+//-----------------------------------------------------------------------------
+
+// Thread stacks are placed in the low 4 GiB so that objects living on them can be waited on
+static void* _hostStackAlloc(void)
+{
+#if defined(MAP_32BIT)
+	void* stack = mmap(NULL, HOST_SIM_STACK_SZ, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_32BIT, -1, 0);
+	return stack != MAP_FAILED ? stack : NULL;
+#else
+	return malloc(HOST_SIM_STACK_SZ);
+#endif
+}
+
+static void _hostStackFree(void* stack)
+{
+#if defined(MAP_32BIT)
+	munmap(stack, HOST_SIM_STACK_SZ);
+#else
+	free(stack);
+#endif
+}
+
+static void _hostFreeZombie(void)
+{
+	HostFiber* f = s_hostZombie;
+	if (f) {
+		s_hostZombie = NULL;
+		_hostStackFree(f->stack);
+		free(f);
+	}
+}
+
+ucontext_t* _hostContextSave(ArmContext* ctx, ArmIrqState st)
+{
+	// A context without a fiber can only be the one that was running at startup
+	HostFiber* f = (HostFiber*)ctx->host;
+	if (!f) {
+		f = (HostFiber*)calloc(1, sizeof(HostFiber));
+		f->ctx = ctx;
+		ctx->host = f;
+		s_hostCurFiber = f;
+	}
+
+	ctx->psr = (s_hostCpsr &~ (ARM_PSR_I | ARM_PSR_F)) | st;
+	f->suspended = true;
+	return &f->uc;
+}
+
+void _hostContextResume(void)
+{
+	_hostFreeZombie();
+	_hostIrqCheck();
+}
+
+static void _hostFiberEntry(void)
+{
+	ArmContext* ctx = s_hostCurFiber->ctx;
+	_hostContextResume();
+
+	// Restore the THUMB bit stripped by threadPrepare
+	uptr entry = ctx->r[15] | ((ctx->psr & ARM_PSR_T) ? 1 : 0);
+	int rc = ((ThreadFunc)entry)((void*)ctx->r[0]);
+	((void (*)(int))ctx->r[14])(rc);
+
+	fprintf(stderr, "calico: simulated thread returned to host\n");
+	abort();
+}
+
+void armContextLoad(const ArmContext* ctx)
+{
+	// The running fiber is abandoned if it did not save its context (i.e. its thread exited)
+	HostFiber* cur = s_hostCurFiber;
+	if (cur && !cur->suspended && cur->stack) {
+		s_hostZombie = cur;
+	}
+
+	HostFiber* f = (HostFiber*)ctx->host;
+	if (!f) {
+		f = (HostFiber*)calloc(1, sizeof(HostFiber));
+		f->stack = _hostStackAlloc();
+		if (!f->stack) {
+			fprintf(stderr, "calico: unable to allocate simulated thread stack\n");
+			abort();
+		}
+		f->ctx = (ArmContext*)ctx;
+		getcontext(&f->uc);
+		f->uc.uc_stack.ss_sp = f->stack;
+		f->uc.uc_stack.ss_size = HOST_SIM_STACK_SZ;
+		f->uc.uc_link = NULL;
+		makecontext(&f->uc, _hostFiberEntry, 0);
+		((ArmContext*)ctx)->host = f;
+	}
+
+	s_hostCpsr = ctx->psr &~ ARM_PSR_T;
+	f->suspended = false;
+	s_hostCurFiber = f;
+	setcontext(&f->uc);
+	abort();
+}
+
+//-----------------------------------------------------------------------------
+// Interrupts
+//-----------------------------------------------------------------------------
+
+static void _hostIrqDispatch(void)
+{
+	u32 saved_psr = s_hostCpsr;
+	s_hostCpsr = (saved_psr &~ ARM_PSR_MODE_MASK) | ARM_PSR_MODE_IRQ | ARM_PSR_I | ARM_PSR_F;
+
+	// Select an interrupt (LSB has priority) and acknowledge it
+	IrqMask pending = REG_IE & REG_IF;
+	unsigned id = __builtin_ctz(pending);
+	IrqMask mask = 1U << id;
+	REG_IF &= ~mask;
+	__irq_flags |= mask;
+#if defined(CALICO_IRQ_LATENCY)
+	_irqLatencyEnter(id, s_hostIrqPc);
+#endif
+
+	// Call the handler (simulated time does not advance while it runs)
+#if defined(CALICO_THREAD_STATS)
+	__sched_stats.irq_count ++;
+	if (!__irq_nest_depth) {
+		__sched_stats.irq_start = (u16)tickGetCount();
+	}
+#endif
+#if defined(CALICO_TRACE)
+	_traceIrqEnter(id);
+#endif
+	IrqHandler handler = __irq_table[id];
+	if (__irq_nest_allow[id]) {
+		// Preemptible handlers run in system mode with interrupts enabled
+		// (on the host stack, so the stack returned by _irqNestEnter is unused)
+		_irqNestEnter(id);
+		s_hostCpsr = (saved_psr &~ ARM_PSR_MODE_MASK) | ARM_PSR_MODE_SYS;
+		_hostIrqCheck();
+		if (handler) {
+			handler();
+		}
+		s_hostCpsr = (saved_psr &~ ARM_PSR_MODE_MASK) | ARM_PSR_MODE_IRQ | ARM_PSR_I | ARM_PSR_F;
+		_irqNestExit();
+	} else if (handler) {
+		handler();
+	}
+#if defined(CALICO_THREAD_STATS)
+	// Time spent in nested handlers is accounted to the outermost one
+	if (!__irq_nest_depth) {
+		__sched_stats.irq_ticks += (u16)(tickGetCount() - __sched_stats.irq_start);
+	}
+#endif
+#if defined(CALICO_TRACE)
+	_traceIrqExit();
+#endif
+
+	// Wake up threads waiting on this interrupt
+	mask &= s_irqWaitMask;
+	if (mask) {
+		s_irqWaitMask &= ~mask;
+		__irq_flags &= ~mask;
+		threadUnblockAllByMask(&s_irqWaitList, mask);
+	}
+
+	s_hostCpsr = saved_psr;
+
+	// Perform a deferred context switch if needed (only when returning to a thread)
+	Thread* next = s_deferredThread;
+	if (next && !__irq_nest_depth) {
+		Thread* prev = s_curThread;
+		s_deferredThread = NULL;
+		s_curThread = next;
+#if defined(CALICO_THREAD_STATS) || defined(CALICO_TRACE) || defined(CALICO_STACK_CHECK)
+		_threadIrqSwitchHook(prev, next);
+#endif
+		if (!armContextSave(&prev->ctx, saved_psr & (ARM_PSR_I | ARM_PSR_F), 1)) {
+			armContextLoad(&next->ctx);
+		}
+	}
+}
+
+static void _hostIrqCheck(void)
+{
+	while (!(s_hostCpsr & ARM_PSR_I) && REG_IME && (REG_IE & REG_IF)) {
+		_hostIrqDispatch();
+	}
+}
+
+void hostSimRaiseIrq(IrqMask mask)
+{
+	REG_IF |= mask;
+	_hostIrqCheck();
+}
+
+//-----------------------------------------------------------------------------
+// Timers
+//-----------------------------------------------------------------------------
+
+MK_INLINE unsigned _hostTimerGetShift(u16 ctl)
+{
+	static const u8 shifts[] = { 0, 6, 8, 10 };
+	return shifts[ctl & 3];
+}
+
+// Picks up changes made by software to the timer registers
+static void _hostTimerSync(unsigned id)
+{
+	HostTimer* t = &s_hostTimers[id];
+	u16 ctl = REG_TMxCNT_H(id);
+	u16 cnt = REG_TMxCNT_L(id);
+
+	if (!(ctl & TIMER_ENABLE)) {
+		t->running = false;
+	} else if (!t->running || ctl != t->ctl || cnt != t->written) {
+		// Software wrote the reload value and (re)started the timer
+		t->running = true;
+		t->ctl = ctl;
+		t->reload = cnt;
+		t->written = cnt;
+		t->base_count = cnt;
+		t->base_cycle = s_hostCycles;
+	}
+}
+
+MK_INLINE u64 _hostTimerCyclesToOverflow(HostTimer* t)
+{
+	unsigned shift = _hostTimerGetShift(t->ctl);
+	u64 elapsed = s_hostCycles - t->base_cycle;
+	u64 remaining = 0x10000 - t->base_count - (elapsed >> shift);
+	return (remaining << shift) - (elapsed & ((1U << shift) - 1));
+}
+
+MK_INLINE bool _hostTimerIsCascade(HostTimer* t)
+{
+	return t->running && (t->ctl & TIMER_CASCADE);
+}
+
+static void _hostTimerOverflow(unsigned id);
+
+static void _hostTimerSetCount(unsigned id, u32 count)
+{
+	HostTimer* t = &s_hostTimers[id];
+	if (count >= 0x10000) {
+		t->base_count = t->reload;
+		t->base_cycle = s_hostCycles;
+		count = t->reload;
+		_hostTimerOverflow(id);
+	}
+
+	t->written = count;
+	REG_TMxCNT_L(id) = count;
+}
+
+static void _hostTimerOverflow(unsigned id)
+{
+	if (s_hostTimers[id].ctl & TIMER_ENABLE_IRQ) {
+		REG_IF |= IRQ_TIMER(id);
+	}
+
+	// Cascaded timers count overflows of the previous timer
+	if (id < 3 && _hostTimerIsCascade(&s_hostTimers[id+1])) {
+		HostTimer* t = &s_hostTimers[id+1];
+		t->base_count ++;
+		_hostTimerSetCount(id+1, t->base_count);
+	}
+}
+
+static void _hostTimerUpdate(unsigned id)
+{
+	HostTimer* t = &s_hostTimers[id];
+	if (!t->running || _hostTimerIsCascade(t)) {
+		return;
+	}
+
+	unsigned shift = _hostTimerGetShift(t->ctl);
+	_hostTimerSetCount(id, t->base_count + ((s_hostCycles - t->base_cycle) >> shift));
+}
+
+static u64 _hostNextTimerEvent(bool irq_only)
+{
+	u64 next = UINT64_MAX;
+	for (unsigned i = 0; i < 4; i ++) {
+		_hostTimerSync(i);
+	}
+
+	for (unsigned i = 0; i < 4; i ++) {
+		HostTimer* t = &s_hostTimers[i];
+		if (!t->running || _hostTimerIsCascade(t)) {
+			continue;
+		}
+
+		// When looking for interrupts, also consider timers driving a cascaded timer that raises them
+		if (irq_only) {
+			bool irq = false;
+			for (unsigned j = i; j < 4 && (j == i || _hostTimerIsCascade(&s_hostTimers[j])); j ++) {
+				irq = irq || ((s_hostTimers[j].ctl & TIMER_ENABLE_IRQ) && (REG_IE & IRQ_TIMER(j)));
+			}
+			if (!irq) {
+				continue;
+			}
+		}
+
+		u64 cycles = _hostTimerCyclesToOverflow(t);
+		if (cycles < next) {
+			next = cycles;
+		}
+	}
+
+	return next;
+}
+
+u64 hostSimGetCycles(void)
+{
+	return s_hostCycles;
+}
+
+void hostSimAdvance(u64 cycles)
+{
+	// Deliver interrupts left pending by code that ran with REG_IME cleared
+	_hostIrqCheck();
+
+	do {
+		u64 step = _hostNextTimerEvent(false);
+		if (step > cycles) {
+			step = cycles;
+		}
+
+		s_hostCycles += step;
+		cycles -= step;
+
+		for (unsigned i = 0; i < 4; i ++) {
+			_hostTimerUpdate(i);
+		}
+
+		_hostIrqCheck();
+	} while (cycles);
+}
+
+//-----------------------------------------------------------------------------
+// Idle thread
+//-----------------------------------------------------------------------------
+
+MK_WEAK void hostSimDeadlock(void)
+{
+	fprintf(stderr, "calico: all simulated threads are blocked forever\n");
+	abort();
+}
+
+int _hostIdleThread(void* arg)
+{
+	for (;;) {
+		ArmIrqState st = armIrqLockByPsr();
+		u64 cycles = _hostNextTimerEvent(true);
+		bool pending = REG_IME && (REG_IE & REG_IF);
+		armIrqUnlockByPsr(st);
+
+		if (cycles == UINT64_MAX && !pending) {
+			hostSimDeadlock();
+		}
+
+		hostSimAdvance(pending ? 0 : cycles);
+	}
+
+	return 0;
+}
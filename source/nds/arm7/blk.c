@@ -19,55 +19,28 @@ static DISC_INTERFACE* s_dldiDiscIface;
 static bool s_blkHasTwl;
 
 static Mailbox s_blkPxiMailbox;
-static u32 s_blkPxiMailboxData[8];
+static u32 s_blkPxiMailboxData[PXI_RPC_MAILBOX_SLOTS];
 static Thread s_blkPxiThread;
 alignas(8) static u8 s_blkPxiThreadStack[1024];
 
-static int _blkPxiThread(void* unused)
+static bool _blkDumpDldi(void* buffer)
 {
-	for (;;) {
-		u32 msg = mailboxRecv(&s_blkPxiMailbox);
-
-		PxiBlkDevMsgType type = pxiBlkDevMsgGetType(msg);
-		u32 imm = pxiBlkDevMsgGetImmediate(msg);
-		u32 reply = 0;
-
-		switch (type) {
-			default: break;
-
-			case PxiBlkDevMsg_IsPresent:
-				reply = blkDevIsPresent((BlkDevice)imm);
-				break;
-
-			case PxiBlkDevMsg_Init:
-				reply = blkDevInit((BlkDevice)imm);
-				break;
-
-			case PxiBlkDevMsg_ReadSectors:
-			case PxiBlkDevMsg_WriteSectors: {
-				void* buffer = (void*)mailboxRecv(&s_blkPxiMailbox);
-				u32 first_sector = mailboxRecv(&s_blkPxiMailbox);
-				u32 num_sectors = mailboxRecv(&s_blkPxiMailbox);
-
-				if (type == PxiBlkDevMsg_ReadSectors) {
-					reply = blkDevReadSectors((BlkDevice)imm, buffer, first_sector, num_sectors);
-				} else /* if (type == PxiBlkDevCmd_WriteSectors) */ {
-					reply = blkDevWriteSectors((BlkDevice)imm, buffer, first_sector, num_sectors);
-				}
-				break;
-			}
+	if (!s_dldiDiscIface) {
+		return false;
+	}
 
-			case PxiBlkDevMsg_DumpDldi: {
-				void* buffer = (void*)mailboxRecv(&s_blkPxiMailbox);
-				if (s_dldiDiscIface) {
-					DldiHeader* dldi = (DldiHeader*)((u8*)s_dldiDiscIface - offsetof(DldiHeader, disc));
-					armCopyMem32(buffer, dldi, 1U << dldi->driver_sz_log2);
-					reply = 1;
-				}
-			}
-		}
+	DldiHeader* dldi = (DldiHeader*)((u8*)s_dldiDiscIface - offsetof(DldiHeader, disc));
+	armCopyMem32(buffer, dldi, 1U << dldi->driver_sz_log2);
+	return true;
+}
+
+PXI_RPC_DEFINE_SERVER(s_blkRpcTable, PXI_BLKDEV_RPC);
 
-		pxiReply(PxiChannel_BlkDev, reply);
+static int _blkPxiThread(void* unused)
+{
+	// Calls from multiple ARM9 threads are queued in the mailbox, and served one at a time
+	for (;;) {
+		pxiRpcDispatch(PxiChannel_BlkDev, &s_blkRpcTable, &s_blkPxiMailbox, mailboxRecv(&s_blkPxiMailbox));
 	}
 
 	return 0;
@@ -81,7 +54,7 @@ void blkInit(void)
 
 	mailboxPrepare(&s_blkPxiMailbox, s_blkPxiMailboxData, sizeof(s_blkPxiMailboxData)/sizeof(u32));
 	pxiSetMailbox(PxiChannel_BlkDev, &s_blkPxiMailbox);
-	threadPrepare(&s_blkPxiThread, _blkPxiThread, NULL, &s_blkPxiThreadStack[sizeof(s_blkPxiThreadStack)], THREAD_MIN_PRIO-1);
+	threadPrepareWithStack(&s_blkPxiThread, _blkPxiThread, NULL, s_blkPxiThreadStack, sizeof(s_blkPxiThreadStack), THREAD_MIN_PRIO-1);
 	threadStart(&s_blkPxiThread);
 }
 
@@ -41,7 +41,7 @@ bool twlblkInit(void)
 		return false;
 	}
 
-	threadPrepare(&s_sdmcThread, (ThreadFunc)tmioThreadMain, &s_sdmcCtl, &s_sdmcThreadStack[sizeof(s_sdmcThreadStack)], 0x10);
+	threadPrepareWithStack(&s_sdmcThread, (ThreadFunc)tmioThreadMain, &s_sdmcCtl, s_sdmcThreadStack, sizeof(s_sdmcThreadStack), 0x10);
 	threadStart(&s_sdmcThread);
 
 	irqSet2(IRQ2_TMIO0, _sdmcIrqHandler);
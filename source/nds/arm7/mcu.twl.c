@@ -85,7 +85,7 @@ void mcuInit(void)
 void mcuStartThread(u8 thread_prio)
 {
 	// Set up MCU thread
-	threadPrepare(&s_mcuThread, _mcuThread, NULL, &s_mcuThreadStack[sizeof(s_mcuThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_mcuThread, _mcuThread, NULL, s_mcuThreadStack, sizeof(s_mcuThreadStack), thread_prio);
 	threadStart(&s_mcuThread);
 }
 
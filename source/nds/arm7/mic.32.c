@@ -2,7 +2,7 @@
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
 #include <calico/system/irq.h>
 #include <calico/system/thread.h>
-#include <calico/system/mailbox.h>
+#include <calico/system/spscring.h>
 #include <calico/nds/timer.h>
 #include <calico/nds/ndma.h>
 #include <calico/nds/pxi.h>
@@ -18,6 +18,13 @@ typedef union MicBuf {
 	void* ptr;
 } MicBuf;
 
+// Message delivered to the mic thread, either a PXI command (along with its
+// parameter words, right-aligned) or a filled buffer notification (bit 31 set)
+typedef struct MicMsg {
+	u32 msg;
+	u32 param[2];
+} MicMsg;
+
 static Thread s_micThread;
 static alignas(8) u8 s_micThreadStack[0x200];
 
@@ -39,8 +46,11 @@ static struct {
 	unsigned pos;
 	unsigned len;
 
-	Mailbox mbox;
-	u32 param[2];
+	// Both the sampling interrupt handlers and the PXI handler produce messages.
+	// With nested interrupt dispatch either of them may preempt the other, so
+	// all pushes are done with interrupts disabled (see _micPush) in order for
+	// them to act as a single producer.
+	SpscRing ring;
 } s_micState;
 
 static unsigned _micReadSampleNtr(void)
@@ -79,6 +89,13 @@ static unsigned _micReadSampleTwl(void)
 	return ret;
 }
 
+static void _micPush(const MicMsg* msg)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	spscRingPush(&s_micState.ring, msg, sizeof(*msg));
+	armIrqUnlockByPsr(st);
+}
+
 static void _micTimerIsr(void)
 {
 	unsigned sample = s_micState.sample_fn();
@@ -101,11 +118,12 @@ static void _micTimerIsr(void)
 	s_micState.back = tmp;
 
 	if (!s_micState.front.ptr) {
-		REG_IE &= ~IRQ_TIMER0;
+		irqDisable(IRQ_TIMER0);
 		REG_TMxCNT_H(0) = 0;
 	}
 
-	mailboxTrySend(&s_micState.mbox, (1U<<31) | (uptr)tmp.ptr);
+	MicMsg msg = { (1U<<31) | (uptr)tmp.ptr };
+	_micPush(&msg);
 }
 
 __attribute__((section(".twl._micDmaIsr")))
@@ -119,32 +137,34 @@ static void _micDmaIsr(void)
 		REG_NDMAxDAD(0) = (u32)s_micState.front.ptr;
 		REG_NDMAxCNT(0) |= NDMA_START;
 	} else {
-		REG_IE &= ~IRQ_NDMA0;
+		irqDisable(IRQ_NDMA0);
 		REG_MICEX_CNT = 0;
 	}
 
-	mailboxTrySend(&s_micState.mbox, (1U<<31) | (uptr)tmp.ptr);
+	MicMsg msg = { (1U<<31) | (uptr)tmp.ptr };
+	_micPush(&msg);
 }
 
 static void _micPxiHandler(void* user, u32 data)
 {
 	static unsigned data_words = 0;
-	static u32 header = 0;
+	static MicMsg msg;
 
 	if_likely (data_words == 0) {
 		data_words = data >> 26;
 		if_likely (data_words == 0) {
-			mailboxTrySend(&s_micState.mbox, data);
+			msg.msg = data;
+			_micPush(&msg);
 			return;
 		}
 
-		header = data & ((1U<<26)-1);
+		msg.msg = data & ((1U<<26)-1);
 		return;
 	}
 
-	s_micState.param[sizeof(s_micState.param)/4 - (data_words--)] = data;
+	msg.param[sizeof(msg.param)/4 - (data_words--)] = data;
 	if (data_words == 0) {
-		mailboxTrySend(&s_micState.mbox, header);
+		_micPush(&msg);
 	}
 }
 
@@ -171,13 +191,13 @@ static bool _micSetDmaRate(unsigned div)
 	return true;
 }
 
-static unsigned _micStart(bool is_16bit, MicMode mode)
+static unsigned _micStart(const MicMsg* m, bool is_16bit, MicMode mode)
 {
 	if (s_micState.active) {
 		return 0;
 	}
 
-	PxiMicArgStart* arg = (PxiMicArgStart*)&s_micState.param[(sizeof(s_micState.param)-sizeof(PxiMicArgStart))/sizeof(u32)];
+	const PxiMicArgStart* arg = (const PxiMicArgStart*)&m->param[(sizeof(m->param)-sizeof(PxiMicArgStart))/sizeof(u32)];
 	u32 buf_addr = arg->dest_addr;
 	u32 buf_sz = arg->dest_sz;
 
@@ -268,11 +288,11 @@ static void _micStop(void)
 	}
 
 	if (s_micState.is_dma) {
-		REG_IE &= ~IRQ_NDMA0;
+		irqDisable(IRQ_NDMA0);
 		REG_MICEX_CNT = 0;
 		REG_NDMAxCNT(0) = 0;
 	} else {
-		REG_IE &= ~IRQ_TIMER0;
+		irqDisable(IRQ_TIMER0);
 		REG_TMxCNT_H(0) = 0;
 	}
 
@@ -282,13 +302,16 @@ static void _micStop(void)
 
 static int _micThreadMain(void* unused)
 {
-	u32 slots[4];
-	mailboxPrepare(&s_micState.mbox, slots, sizeof(slots)/sizeof(slots[0]));
+	alignas(4) u8 ring_buf[64];
+	spscRingPrepare(&s_micState.ring, ring_buf, sizeof(ring_buf));
 
 	pxiSetHandler(PxiChannel_Mic, _micPxiHandler, NULL);
 
 	for (;;) {
-		u32 msg = mailboxRecv(&s_micState.mbox);
+		MicMsg m;
+		spscRingPopWait(&s_micState.ring, &m, sizeof(m));
+
+		u32 msg = m.msg;
 		if (msg & (1U<<31)) {
 			pxiSend(PxiChannel_Mic, msg);
 			continue;
@@ -318,7 +341,7 @@ static int _micThreadMain(void* unused)
 
 			case PxiMicCmd_Start: {
 				PxiMicImmStart u = { imm };
-				ret = _micStart(u.is_16bit, (MicMode)u.mode);
+				ret = _micStart(&m, u.is_16bit, (MicMode)u.mode);
 				break;
 			}
 
@@ -337,6 +360,6 @@ static int _micThreadMain(void* unused)
 __attribute__((target("thumb")))
 void micStartServer(u8 thread_prio)
 {
-	threadPrepare(&s_micThread, _micThreadMain, NULL, &s_micThreadStack[sizeof(s_micThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_micThread, _micThreadMain, NULL, s_micThreadStack, sizeof(s_micThreadStack), thread_prio);
 	threadStart(&s_micThread);
 }
@@ -119,7 +119,7 @@ static int _soundSrvThreadMain(void* arg)
 
 void soundStartServer(u8 thread_prio)
 {
-	threadPrepare(&s_soundSrvThread, _soundSrvThreadMain, NULL, &s_soundSrvThreadStack[sizeof(s_soundSrvThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_soundSrvThread, _soundSrvThreadMain, NULL, s_soundSrvThreadStack, sizeof(s_soundSrvThreadStack), thread_prio);
 	threadStart(&s_soundSrvThread);
 }
 
@@ -97,7 +97,7 @@ void touchInit(void)
 
 void touchStartServer(unsigned lyc, u8 thread_prio)
 {
-	threadPrepare(&s_touchSrvThread, _touchSrvThreadMain, (void*)lyc, &s_touchSrvThreadStack[sizeof(s_touchSrvThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_touchSrvThread, _touchSrvThreadMain, (void*)lyc, s_touchSrvThreadStack, sizeof(s_touchSrvThreadStack), thread_prio);
 	threadStart(&s_touchSrvThread);
 }
 
@@ -298,7 +298,7 @@ bool twlwifiInit(void)
 		return false;
 	}
 
-	threadPrepare(&s_sdioThread, (ThreadFunc)tmioThreadMain, &s_sdioCtl, &s_sdioThreadStack[sizeof(s_sdioThreadStack)], 0x10);
+	threadPrepareWithStack(&s_sdioThread, (ThreadFunc)tmioThreadMain, &s_sdioCtl, s_sdioThreadStack, sizeof(s_sdioThreadStack), 0x10);
 	threadStart(&s_sdioThread);
 
 	irqSet2(IRQ2_TMIO1, _sdioIrqHandler);
@@ -320,7 +320,7 @@ bool twlwifiInit(void)
 	}
 
 	// Start the Atheros interrupt thread
-	threadPrepare(&s_sdioIrqThread, (ThreadFunc)ar6kDevThreadMain, &s_ar6kDev, &s_sdioIrqThreadStack[sizeof(s_sdioIrqThreadStack)], 0x11);
+	threadPrepareWithStack(&s_sdioIrqThread, (ThreadFunc)ar6kDevThreadMain, &s_ar6kDev, s_sdioIrqThreadStack, sizeof(s_sdioIrqThreadStack), 0x11);
 	threadStart(&s_sdioIrqThread);
 
 	// Wait for WMI to be ready
@@ -331,8 +331,8 @@ bool twlwifiInit(void)
 
 	// Prepare and start the WPA supplicant thread
 	wpaPrepare(&s_wpaState);
-	threadPrepare(&s_wpaSupplicantThread, (ThreadFunc)wpaSupplicantThreadMain, &s_wpaState,
-		&s_wpaSupplicantThreadStack[sizeof(s_wpaSupplicantThreadStack)], MAIN_THREAD_PRIO+0x10);
+	threadPrepareWithStack(&s_wpaSupplicantThread, (ThreadFunc)wpaSupplicantThreadMain, &s_wpaState,
+		s_wpaSupplicantThreadStack, sizeof(s_wpaSupplicantThreadStack), MAIN_THREAD_PRIO+0x10);
 	threadStart(&s_wpaSupplicantThread);
 
 	dietPrint("[TWLWIFI] Init complete\n");
@@ -188,7 +188,7 @@ static int _wlmgrThreadMain(void* arg)
 
 void wlmgrStartServer(u8 thread_prio)
 {
-	threadPrepare(&s_wlmgrThread, _wlmgrThreadMain, NULL, &s_wlmgrThreadStack[sizeof(s_wlmgrThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_wlmgrThread, _wlmgrThreadMain, NULL, s_wlmgrThreadStack, sizeof(s_wlmgrThreadStack), thread_prio);
 	threadStart(&s_wlmgrThread);
 }
 
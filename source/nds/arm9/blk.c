@@ -23,6 +23,8 @@ static u32 s_blkPxiMailboxData[1];
 static Thread s_blkPxiThread;
 alignas(8) static u8 s_blkPxiThreadStack[2048];
 
+alignas(PXI_BULK_SLOT_SZ) static u8 s_blkPxiBulkMem[PXI_BULK_MEM_SZ(PXI_BULK_MIN_SLOTS)];
+
 MK_CONSTEXPR bool _blkIsValidAddr(const void* addr, u32 alignment)
 {
 	// Verify that:
@@ -36,6 +38,8 @@ MK_CONSTEXPR bool _blkIsValidAddr(const void* addr, u32 alignment)
 	return (p & (alignment-1)) == 0 && p >= MM_MAINRAM && p < MM_DTCM;
 }
 
+PXI_RPC_DEFINE_CLIENT(_blkRpc_, PxiChannel_BlkDev, PXI_BLKDEV_RPC)
+
 static int _blkPxiThread(void* unused)
 {
 	for (;;) {
@@ -62,6 +66,7 @@ static int _blkPxiThread(void* unused)
 void blkInit(void)
 {
 	pxiWaitRemote(PxiChannel_BlkDev);
+	pxiBulkAttach(PxiChannel_BlkDev, s_blkPxiBulkMem, sizeof(s_blkPxiBulkMem));
 }
 
 void blkSetDevCallback(BlkDevCallbackFn fn)
@@ -70,7 +75,7 @@ void blkSetDevCallback(BlkDevCallbackFn fn)
 	if (fn && !threadIsValid(&s_blkPxiThread)) {
 		mailboxPrepare(&s_blkPxiMailbox, s_blkPxiMailboxData, sizeof(s_blkPxiMailboxData)/sizeof(u32));
 		pxiSetMailbox(PxiChannel_BlkDev, &s_blkPxiMailbox);
-		threadPrepare(&s_blkPxiThread, _blkPxiThread, NULL, &s_blkPxiThreadStack[sizeof(s_blkPxiThreadStack)], 0x08);
+		threadPrepareWithStack(&s_blkPxiThread, _blkPxiThread, NULL, s_blkPxiThreadStack, sizeof(s_blkPxiThreadStack), 0x08);
 		threadAttachLocalStorage(&s_blkPxiThread, NULL);
 		threadStart(&s_blkPxiThread);
 	}
@@ -80,12 +85,12 @@ void blkSetDevCallback(BlkDevCallbackFn fn)
 
 bool blkDevIsPresent(BlkDevice dev)
 {
-	return pxiSendAndReceive(PxiChannel_BlkDev, pxiBlkDevMakeMsg(PxiBlkDevMsg_IsPresent, dev));
+	return _blkRpc_blkDevIsPresent(dev);
 }
 
 bool blkDevInit(BlkDevice dev)
 {
-	return pxiSendAndReceive(PxiChannel_BlkDev, pxiBlkDevMakeMsg(PxiBlkDevMsg_Init, dev));
+	return _blkRpc_blkDevInit(dev);
 }
 
 u32 blkDevGetSectorCount(BlkDevice dev)
@@ -101,27 +106,13 @@ u32 blkDevGetSectorCount(BlkDevice dev)
 	}
 }
 
-MK_NOINLINE static bool _blkDevReadWriteSectors(u32 msg, u32 buffer, u32 first_sector, u32 num_sectors)
-{
-	u32 params[3] = {
-		buffer,
-		first_sector,
-		num_sectors,
-	};
-
-	return pxiSendWithDataAndReceive(PxiChannel_BlkDev, msg, params, sizeof(params)/sizeof(u32));
-}
-
 bool blkDevReadSectors(BlkDevice dev, void* buffer, u32 first_sector, u32 num_sectors)
 {
 	if (!_blkIsValidAddr(buffer, ARM_CACHE_LINE_SZ)) {
 		return false;
 	}
 
-	armDCacheInvalidate(buffer, num_sectors*BLK_SECTOR_SZ);
-	return _blkDevReadWriteSectors(
-		pxiBlkDevMakeMsg(PxiBlkDevMsg_ReadSectors, dev),
-		(u32)buffer, first_sector, num_sectors);
+	return _blkRpc_blkDevReadSectors(dev, buffer, first_sector, num_sectors);
 }
 
 bool blkDevWriteSectors(BlkDevice dev, const void* buffer, u32 first_sector, u32 num_sectors)
@@ -130,10 +121,7 @@ bool blkDevWriteSectors(BlkDevice dev, const void* buffer, u32 first_sector, u32
 		return false;
 	}
 
-	armDCacheFlush((void*)buffer, num_sectors*BLK_SECTOR_SZ);
-	return _blkDevReadWriteSectors(
-		pxiBlkDevMakeMsg(PxiBlkDevMsg_WriteSectors, dev),
-		(u32)buffer, first_sector, num_sectors);
+	return _blkRpc_blkDevWriteSectors(dev, buffer, first_sector, num_sectors);
 }
 
 bool dldiDumpInternal(void* buffer)
@@ -142,11 +130,5 @@ bool dldiDumpInternal(void* buffer)
 		return false;
 	}
 
-	u32 params[1] = {
-		(u32)buffer,
-	};
-
-	armDCacheInvalidate(buffer, DLDI_MAX_ALLOC_SZ);
-	return pxiSendWithDataAndReceive(PxiChannel_BlkDev,
-		pxiBlkDevMakeMsg(PxiBlkDevMsg_DumpDldi, 0), params, sizeof(params)/sizeof(u32));
+	return _blkRpc__blkDumpDldi(buffer);
 }
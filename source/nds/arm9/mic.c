@@ -67,7 +67,7 @@ void micSetCallback(MicBufferFn fn, void* user)
 {
 	// Start mic thread if necessary
 	if_unlikely (fn && !threadIsValid(&s_micThread)) {
-		threadPrepare(&s_micThread, _micThreadMain, NULL, &s_micThreadStack[sizeof(s_micThreadStack)], 0x08);
+		threadPrepareWithStack(&s_micThread, _micThreadMain, NULL, s_micThreadStack, sizeof(s_micThreadStack), 0x08);
 		threadAttachLocalStorage(&s_micThread, NULL);
 		threadStart(&s_micThread);
 	}
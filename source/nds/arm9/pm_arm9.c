@@ -10,13 +10,13 @@
 unsigned pmGetBatteryState(void)
 {
 	u32 msg = pxiPmMakeMsg(PxiPmMsg_GetBatteryState, 0);
-	return pxiSendAndReceive(PxiChannel_Power, msg);
+	return pxiSendTaggedAndReceive(PxiChannel_Power, msg);
 }
 
 void pmSetPowerLed(PmLedMode mode)
 {
 	u32 msg = pxiPmMakeMsg(PxiPmMsg_SetPowerLed, mode);
-	pxiSendAndReceive(PxiChannel_Power, msg);
+	pxiSendTaggedAndReceive(PxiChannel_Power, msg);
 }
 
 bool pmReadNvram(void* data, u32 addr, u32 len)
@@ -29,7 +29,7 @@ bool pmReadNvram(void* data, u32 addr, u32 len)
 	};
 
 	armDCacheFlush(data, len);
-	return pxiSendWithDataAndReceive(PxiChannel_Power, msg, args, 3);
+	return pxiSendWithDataTaggedAndReceive(PxiChannel_Power, msg, args, 3);
 }
 
 void pmMicSetAmp(bool enable, unsigned gain)
@@ -39,11 +39,11 @@ void pmMicSetAmp(bool enable, unsigned gain)
 	}
 
 	u32 msg = pxiPmMakeMsg(PxiPmMsg_MicSetAmp, gain | (enable << 8));
-	pxiSendAndReceive(PxiChannel_Power, msg);
+	pxiSendTaggedAndReceive(PxiChannel_Power, msg);
 }
 
 bool scfgSetMcPower(bool on)
 {
 	u32 msg = pxiPmMakeMsg(PxiPmMsg_SetMcPower, on ? 1 : 0);
-	return pxiSendAndReceive(PxiChannel_Power, msg);
+	return pxiSendTaggedAndReceive(PxiChannel_Power, msg);
 }
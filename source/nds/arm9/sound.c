@@ -10,6 +10,8 @@ static bool s_soundInit, s_soundAutoUpdate;
 static ThrListNode s_soundPxiCreditWaitList;
 static u16 s_soundPxiCredits;
 
+alignas(PXI_BULK_SLOT_SZ) static u8 s_soundPxiBulkMem[PXI_BULK_MEM_SZ(16)];
+
 static void _soundPxiHandler(void* user, u32 data)
 {
 	PxiSoundEvent evt = pxiSoundEventGetType(data);
@@ -65,6 +67,7 @@ void soundInit(void)
 	s_soundPxiCredits = PXI_SOUND_NUM_CREDITS;
 	pxiSetHandler(PxiChannel_Sound, _soundPxiHandler, NULL);
 	pxiWaitRemote(PxiChannel_Sound);
+	pxiBulkAttach(PxiChannel_Sound, s_soundPxiBulkMem, sizeof(s_soundPxiBulkMem));
 	soundPowerOn();
 }
 
@@ -19,6 +19,8 @@ void _netbufPrvInitPools(void* start, const u16* tx_counts, const u16* rx_counts
 static Thread s_wlmgrThread;
 alignas(8) static u8 s_wlmgrThreadStack[2048];
 
+alignas(PXI_BULK_SLOT_SZ) static u8 s_wlmgrPxiBulkMem[PXI_BULK_MEM_SZ(PXI_BULK_MIN_SLOTS)];
+
 alignas(ARM_CACHE_LINE_SZ)
 static u8 s_wlmgrDefaultPacketHeap[WLMGR_MIN_PACKET_MEM_SZ + 7*(sizeof(NetBuf) + 2048)];
 
@@ -212,12 +214,13 @@ bool wlmgrInit(const WlMgrInitConfig* config, u8 thread_prio)
 	}
 
 	// Bring up event/rx thread
-	threadPrepare(&s_wlmgrThread, _wlmgrThreadMain, NULL, &s_wlmgrThreadStack[sizeof(s_wlmgrThreadStack)], thread_prio);
+	threadPrepareWithStack(&s_wlmgrThread, _wlmgrThreadMain, NULL, s_wlmgrThreadStack, sizeof(s_wlmgrThreadStack), thread_prio);
 	threadAttachLocalStorage(&s_wlmgrThread, NULL);
 	threadStart(&s_wlmgrThread);
 
 	// Wait for ARM7 to be available
 	pxiWaitRemote(PxiChannel_WlMgr);
+	pxiBulkAttach(PxiChannel_WlMgr, s_wlmgrPxiBulkMem, sizeof(s_wlmgrPxiBulkMem));
 
 	initted = true;
 	return true;
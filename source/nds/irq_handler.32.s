@@ -75,15 +75,90 @@ FUNC_START32 __irq_handler
 #elif defined(ARM9)
 	mcr   p15, 0, r2, c13, c0, 1 @ save irq_mask abusing CP15 "Trace Process ID" to shave off stack usage
 #endif
+#if defined(CALICO_IRQ_LATENCY)
+	@ _irqLatencyEnter(cur_irq_id, interrupted_pc)
+	push  {r1, r3}
+	mov   r0, r1
+#if defined(ARM9)
+	ldr   r1, [sp, #8+5*4]   @ LR saved on entry (already adjusted)
+#elif defined(ARM7)
+	ldr   r1, [sp, #16+5*4]  @ LR saved by the BIOS
+	sub   r1, r1, #4
+#endif
+	bl    _irqLatencyEnter
+	pop   {r1, r3}
+#endif
+#if defined(CALICO_THREAD_STATS)
+	@ __sched_stats.irq_start = low 16 bits of the tick counter, unless nested
+	@ (the time spent in nested handlers is accounted to the outermost one)
+	ldr   r12, =__irq_nest_depth
+	ldr   r0, [r12]
+	cmp   r0, #0
+	bne   2f
+	ldr   r12, =MM_IO + IO_TMxCNT(2)
+	ldrh  r0, [r12]
+	ldr   r12, =__sched_stats
+	str   r0, [r12, #0]
+2:
+#endif
+#if defined(CALICO_TRACE)
+	@ _traceIrqEnter(cur_irq_id)
+	push  {r1, r3}
+	mov   r0, r1
+	bl    _traceIrqEnter
+	pop   {r1, r3}
+#endif
+
+	@ Check whether the handler can be preempted by higher priority interrupts
+#if defined(ARM7)
+	cmp   r1, #32
+	bhs   1f                 @ extended interrupts are never preemptible
+#endif
+	ldr   r0, =__irq_nest_allow
+	ldr   r0, [r0, r1, lsl #2]
+	cmp   r0, #0
+	bne   .LnestedHandler
+1:
+
 	cmp   r3, #0
 #if defined(ARM7)
-	adr   lr, 1f
+	adr   lr, .LhandlerDone
 	moveq r3, lr @ avoid crashing if no handler is registered
 	bx    r3
-1:
 #elif defined(ARM9)
 	blxne r3
 #endif
+.LhandlerDone:
+
+#if defined(CALICO_THREAD_STATS)
+	@ __sched_stats.irq_count ++
+	ldr   r12, =__sched_stats
+	ldr   r2, [r12, #1*4]
+	add   r2, r2, #1
+	str   r2, [r12, #1*4]
+
+	@ Accumulate the time spent in the handler, unless nested (see above)
+	ldr   r0, =__irq_nest_depth
+	ldr   r0, [r0]
+	cmp   r0, #0
+	bne   2f
+	ldr   r1, =MM_IO + IO_TMxCNT(2)
+	ldrh  r0, [r1]
+	ldr   r1, [r12, #0*4]    @ r1 <- irq_start
+	ldr   r3, [r12, #2*4]    @ r3 <- irq_ticks (low)
+	sub   r0, r0, r1
+	mov   r0, r0, lsl #16    @ the counter is 16-bit, discard upper bits
+	adds  r3, r3, r0, lsr #16
+	str   r3, [r12, #2*4]
+	ldrcs r0, [r12, #3*4]    @ carry into irq_ticks (high)
+	addcs r0, r0, #1
+	strcs r0, [r12, #3*4]
+2:
+#endif
+
+#if defined(CALICO_TRACE)
+	bl    _traceIrqExit
+#endif
 
 	@ Check if thread rescheduling is needed
 #if defined(ARM7)
@@ -96,13 +171,13 @@ FUNC_START32 __irq_handler
 	mrc   p15, 0, r3, c13, c0, 1 @ r3 <- cur_irq_mask
 #endif
 	ldr   r2, =__sched_state
-	ldr   r1, [r2, #3*4]     @ r1 <- s_irqWaitMask
+	ldr   r1, [r2, #2*4]     @ r1 <- s_irqWaitMask
 	ands  r3, r3, r1         @ cur_irq_mask &= s_irqWaitMask
 	beq   .LcheckReschedule  @ if (!cur_irq_mask) -> skip this section
 
 	@ s_irqWaitMask &= ~cur_irq_mask
 	bic   r1, r1, r3
-	str   r1, [r2, #3*4]
+	str   r1, [r2, #2*4]
 
 	@ __irq_flags &= ~cur_irq_mask
 	ldr   r12, =__irq_flags
@@ -111,7 +186,7 @@ FUNC_START32 __irq_handler
 	str   r1, [r12]
 
 	@ threadUnblock(&irqWaitList, -1, ThrUnblockMode_ByMask, cur_irq_mask)
-	add   r0, r2, #4*4
+	add   r0, r2, #3*4
 .LcontUnblockIrqWaitThreads:
 	mov   r1, r3
 	bl    threadUnblockAllByMask
@@ -123,6 +198,10 @@ FUNC_START32 __irq_handler
 	add   sp, sp, #8
 #endif
 	ldr   r0, [r2, #4] @ r0 <- s_deferredThread
+	ldr   r1, =__irq_nest_depth
+	ldr   r1, [r1]
+	cmp   r1, #0       @ Context switches are only performed when returning to a thread
+	movne r0, #0
 	cmp   r0, #0
 #if defined(ARM7)
 	ldreq pc, [sp, #-4] @ Return to BIOS if not
@@ -135,6 +214,16 @@ FUNC_START32 __irq_handler
 	ldr   r1, [r2, #0]
 	stm   r2, {r0, r3}
 
+#if defined(CALICO_THREAD_STATS) || defined(CALICO_TRACE) || defined(CALICO_STACK_CHECK)
+	@ _threadIrqSwitchHook(old, new)
+	push  {r1, r2}
+	mov   r3, r0
+	mov   r0, r1
+	mov   r1, r3
+	bl    _threadIrqSwitchHook
+	pop   {r1, r2}
+#endif
+
 	@ Save old thread's context
 	mrs  r2, spsr
 	str  r2, [r1, #16*4]
@@ -152,18 +241,60 @@ FUNC_START32 __irq_handler
 	@ Load new thread's context
 	b    armContextLoadFromSvc
 
+.LnestedHandler:
+	@ Mask interrupts of equal or lower priority, and retrieve the stack for the handler
+	push  {r1, r3}
+	mov   r0, r1
+	bl    _irqNestEnter      @ r0 <- handler stack, or NULL if already on it
+	pop   {r1, r3}
+	mrs   r2, spsr
+
+	@ Switch to system mode, saving state clobbered by the handler or nested interrupts
+	msr   cpsr_c, #(ARM_PSR_I | ARM_PSR_F | ARM_PSR_MODE_SYS)
+	mov   r12, sp
+	cmp   r0, #0
+	movne sp, r0
+	push  {r1, r2, r12, lr}  @ cur_irq_id, SPSR, previous SP and LR
+
+	@ Call the handler with interrupts enabled
+	msr   cpsr_c, #ARM_PSR_MODE_SYS
+	cmp   r3, #0
+#if defined(ARM7)
+	adr   lr, 1f
+	bxne  r3
+1:
+#elif defined(ARM9)
+	blxne r3
+#endif
+
+	@ Restore state and go back to IRQ mode
+	msr   cpsr_c, #(ARM_PSR_I | ARM_PSR_F | ARM_PSR_MODE_SYS)
+	pop   {r1, r2, r12, lr}
+	mov   sp, r12
+	msr   cpsr_c, #(ARM_PSR_I | ARM_PSR_F | ARM_PSR_MODE_IRQ)
+	msr   spsr, r2
+#if defined(ARM9)
+	mov   r2, #1
+	mov   r2, r2, lsl r1
+	mcr   p15, 0, r2, c13, c0, 1 @ cur_irq_mask was clobbered by nested interrupts
+#endif
+
+	@ Unmask interrupts again
+	bl    _irqNestExit
+	b     .LhandlerDone
+
 #if defined(ARM7)
 .LcheckIrqWait2:
 	@ As above, but for the second IRQ controller
 	mov   r3, r1, lsl r2     @ r3 <- cur_irq_mask
 	ldr   r2, =__sched_state
-	ldr   r1, [r2, #6*4]     @ r1 <- s_irqWaitMask2
+	ldr   r1, [r2, #5*4]     @ r1 <- s_irqWaitMask2
 	ands  r3, r3, r1         @ cur_irq_mask &= s_irqWaitMask2
 	beq   .LcheckReschedule  @ if (!cur_irq_mask) -> skip this section
 
 	@ s_irqWaitMask2 &= ~cur_irq_mask
 	bic   r1, r1, r3
-	str   r1, [r2, #6*4]
+	str   r1, [r2, #5*4]
 
 	@ __irq_flags2 &= ~cur_irq_mask
 	ldr   r12, =__irq_flags2
@@ -172,7 +303,7 @@ FUNC_START32 __irq_handler
 	str   r1, [r12]
 
 	@ threadUnblock(&irqWaitList2, -1, ThrUnblockMode_ByMask, cur_irq_mask)
-	add   r0, r2, #7*4
+	add   r0, r2, #6*4
 	b     .LcontUnblockIrqWaitThreads
 #endif
 
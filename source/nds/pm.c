@@ -58,6 +58,12 @@ static PmState s_pmState;
 
 static Thread s_pmPxiThread;
 static alignas(8) u8 s_pmPxiThreadStack[0x200];
+#if defined(ARM7)
+// Enough room for the requests of all possible outstanding tags
+static u32 s_pmPxiMailboxData[4*PXI_NUM_TAGS];
+#else
+static u32 s_pmPxiMailboxData[4];
+#endif
 
 MK_NOINLINE static void _pmCallEventHandlers(PmEvent event)
 {
@@ -85,8 +91,7 @@ static int _pmPxiThreadMain(void* arg)
 {
 	// Set up PXI mailbox
 	Mailbox mb;
-	u32 mb_slots[4];
-	mailboxPrepare(&mb, mb_slots, sizeof(mb_slots)/sizeof(u32));
+	mailboxPrepare(&mb, s_pmPxiMailboxData, sizeof(s_pmPxiMailboxData)/sizeof(u32));
 
 	// Register PXI channels
 	pxiSetHandler(PxiChannel_Reset, _pmResetPxiHandler, NULL);
@@ -98,6 +103,9 @@ static int _pmPxiThreadMain(void* arg)
 		PxiPmMsgType type = pxiPmGetType(msg);
 		unsigned imm = pxiPmGetImmediate(msg);
 		MK_DUMMY(imm);
+#if defined(ARM7)
+		unsigned tag = pxiMsgGetTag(msg);
+#endif
 
 		switch (type) {
 			default: break;
@@ -121,31 +129,31 @@ static int _pmPxiThreadMain(void* arg)
 #elif defined(ARM7)
 
 			case PxiPmMsg_GetBatteryState:
-				pxiReply(PxiChannel_Power, pmGetBatteryState());
+				pxiReplyTagged(PxiChannel_Power, tag, pmGetBatteryState());
 				break;
 
 			case PxiPmMsg_ReadNvram: {
 				void* data = (void*)mailboxRecv(&mb);
 				u32 addr = mailboxRecv(&mb);
 				u32 len = mailboxRecv(&mb);
-				pxiReply(PxiChannel_Power, pmReadNvram(data, addr, len));
+				pxiReplyTagged(PxiChannel_Power, tag, pmReadNvram(data, addr, len));
 				break;
 			}
 
 			case PxiPmMsg_MicSetAmp: {
 				pmMicSetAmp((imm>>8)&1, imm&0xff);
-				pxiReply(PxiChannel_Power, 0);
+				pxiReplyTagged(PxiChannel_Power, tag, 0);
 				break;
 			}
 
 			case PxiPmMsg_SetPowerLed: {
 				pmSetPowerLed(imm&3);
-				pxiReply(PxiChannel_Power, 0);
+				pxiReplyTagged(PxiChannel_Power, tag, 0);
 				break;
 			}
 
 			case PxiPmMsg_SetMcPower: {
-				pxiReply(PxiChannel_Power, systemIsTwlMode() && scfgSetMcPower(imm&1));
+				pxiReplyTagged(PxiChannel_Power, tag, systemIsTwlMode() && scfgSetMcPower(imm&1));
 				break;
 			}
 
@@ -389,7 +397,7 @@ void pmInit(void)
 #endif
 
 	// Bring up PXI thread
-	threadPrepare(&s_pmPxiThread, _pmPxiThreadMain, NULL, &s_pmPxiThreadStack[sizeof(s_pmPxiThreadStack)], PM_THREAD_PRIO);
+	threadPrepareWithStack(&s_pmPxiThread, _pmPxiThreadMain, NULL, s_pmPxiThreadStack, sizeof(s_pmPxiThreadStack), PM_THREAD_PRIO);
 	threadStart(&s_pmPxiThread);
 
 	// Wait for the other CPU to bring up their PXI thread
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include <calico/types.h>
+#include <calico/nds/pxi.h>
+
+// Stores the reply to the tagged request identified by tag, waking up its waiter.
+// Called by the PXI receive interrupt handler.
+void _pxiTagComplete(unsigned tag, u32 data);
+
+#if defined(CALICO_PXI_STATS)
+
+// Records the time at which the tagged request identified by tag was issued
+void _pxiStatsTagRequest(unsigned tag);
+
+#else
+
+MK_INLINE void _pxiStatsTagRequest(unsigned tag)
+{
+}
+
+#endif
@@ -1,25 +1,149 @@
 // SPDX-License-Identifier: ZPL-2.1
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <string.h>
 #include <calico/types.h>
+#if defined(ARM9)
+#include <calico/arm/cache.h>
+#endif
 #include <calico/system/thread.h>
 #include <calico/system/mutex.h>
 #include <calico/system/mailbox.h>
+#include <calico/system/tick.h>
+#include <calico/nds/mm.h>
 #include <calico/nds/irq.h>
 #include <calico/nds/pxi.h>
 #include "transfer.h"
+#include "pxi-priv.h"
+#include "../system/trace-priv.h"
+
+#define PXI_BULK_SLOT_WORDS (PXI_BULK_SLOT_SZ/4)
+
+// Bulk transport ring, located in main RAM. Each control word lives in its own
+// cache line, which is only ever written by one of the CPUs. Positions are free
+// running slot counters. Messages are stored as an extended packet header followed
+// by its data words, and never straddle the end of the ring: a zero header means
+// that the rest of the ring is skipped.
+typedef struct PxiBulkRing {
+	vu32 head; // Written by the producer
+	u32 pad0[PXI_BULK_SLOT_WORDS-1];
+	vu32 tail; // Written by the consumer
+	u32 pad1[PXI_BULK_SLOT_WORDS-1];
+	u32 data[];
+} PxiBulkRing;
 
 typedef struct PxiChannelState {
 	void* user;
 	PxiHandlerFn fn;
 	u32 reply;
 	Mutex recv_mutex;
+	PxiBulkRing* bulk_tx;
+	PxiBulkRing* bulk_rx;
+	u32 bulk_slots;
+	u8 send_prio;
 } PxiChannelState;
 
-static Mutex s_pxiSendMutex;
+// Software send queue. Positions are free running word counters.
+typedef struct PxiSendQueue {
+	u32 head;
+	u32 tail;
+	u32 buf[PXI_SEND_QUEUE_WORDS];
+} PxiSendQueue;
+
+static PxiSendQueue s_pxiSendQueues[PxiPrio_Count];
+static ThrListNode s_pxiSendWaitQueue;
+static PxiSendQueueStats s_pxiSendStats;
+static u8 s_pxiSendCurPrio;
+static u8 s_pxiSendCurWords;
 static ThrListNode s_pxiRecvQueue;
 static u32 s_pxiRecvState;
+static u32 s_pxiRecvTag;
 static PxiChannelState s_pxiChannels[PxiChannel_Count];
 
+#if defined(CALICO_PXI_STATS)
+
+static PxiStats s_pxiStats;
+static u32 s_pxiStatsRttStart[PxiChannel_Count];
+static u32 s_pxiStatsTagStart[PXI_NUM_TAGS];
+static PxiChannel s_pxiStatsSendCh;
+
+MK_INLINE u32 _pxiStatsNow(void)
+{
+	return (u32)tickHiresGetCount();
+}
+
+MK_INLINE void _pxiStatsTx(PxiChannel ch, unsigned num_words)
+{
+	s_pxiStats.channels[ch].tx_packets ++;
+	s_pxiStats.channels[ch].tx_words += num_words;
+}
+
+MK_INLINE void _pxiStatsRx(PxiChannel ch, unsigned num_words)
+{
+	s_pxiStats.channels[ch].rx_packets ++;
+	s_pxiStats.channels[ch].rx_words += num_words;
+}
+
+MK_INLINE void _pxiStatsRequest(PxiChannel ch)
+{
+	s_pxiStatsRttStart[ch] = _pxiStatsNow();
+}
+
+void _pxiStatsTagRequest(unsigned tag)
+{
+	s_pxiStatsTagStart[tag] = _pxiStatsNow();
+}
+
+static void _pxiStatsRoundTrip(PxiChannel ch, u32 start)
+{
+	u32 ticks = _pxiStatsNow() - start;
+	PxiChannelStats* s = &s_pxiStats.channels[ch];
+
+	s->num_round_trips ++;
+	if (ticks > s->max_round_trip) {
+		s->max_round_trip = ticks;
+	}
+
+	unsigned bucket = (ticks >> 6) ? (32 - __builtin_clz(ticks >> 6)) : 0;
+	if (bucket >= PXI_STATS_NUM_BUCKETS) {
+		bucket = PXI_STATS_NUM_BUCKETS-1;
+	}
+	s->rtt_hist[bucket] ++;
+}
+
+MK_INLINE void _pxiStatsReply(PxiChannel ch)
+{
+	_pxiStatsRoundTrip(ch, s_pxiStatsRttStart[ch]);
+}
+
+MK_INLINE void _pxiStatsTagReply(PxiChannel ch, unsigned tag)
+{
+	if_likely (tag < PXI_NUM_TAGS) {
+		_pxiStatsRoundTrip(ch, s_pxiStatsTagStart[tag]);
+	}
+}
+
+MK_INLINE void _pxiStatsRecvIrq(u32 start)
+{
+	u32 ticks = _pxiStatsNow() - start;
+	s_pxiStats.recv_irqs ++;
+	s_pxiStats.recv_total_ticks += ticks;
+	if (ticks > s_pxiStats.recv_max_ticks) {
+		s_pxiStats.recv_max_ticks = ticks;
+	}
+}
+
+#else
+
+MK_INLINE u32 _pxiStatsNow(void) { return 0; }
+MK_INLINE void _pxiStatsTx(PxiChannel ch, unsigned num_words) { }
+MK_INLINE void _pxiStatsRx(PxiChannel ch, unsigned num_words) { }
+MK_INLINE void _pxiStatsRequest(PxiChannel ch) { }
+MK_INLINE void _pxiStatsReply(PxiChannel ch) { }
+MK_INLINE void _pxiStatsTagReply(PxiChannel ch, unsigned tag) { }
+MK_INLINE void _pxiStatsRecvIrq(u32 start) { }
+
+#endif
+
 MK_WEAK void _pxiRecvUnhandled(PxiChannel ch, u32 data)
 {
 }
@@ -38,6 +162,9 @@ MK_INLINE u32 _pxiProcessPacket(u32 packet)
 		imm |= num_words << 26;
 	}
 
+	_traceRecord(TraceEvent_PxiRecv, ch, packet, num_words);
+	_pxiStatsRx(ch, 1 + num_words);
+
 	PxiChannelState* state = &s_pxiChannels[ch];
 
 	if_likely (pxiPacketIsRequest(packet)) {
@@ -49,8 +176,14 @@ MK_INLINE u32 _pxiProcessPacket(u32 packet)
 		} else {
 			_pxiRecvUnhandled(ch, imm);
 		}
+	} else if_unlikely (num_words) {
+		// Tagged reply: the data word is routed to the reply table
+		s_pxiRecvTag = pxiExtPacketGetImmediate(packet);
+		num_words |= PxiChannel_Extended << 27;
+		_pxiStatsTagReply(ch, s_pxiRecvTag);
 	} else if_likely (state->recv_mutex.owner) {
 		state->reply = imm;
+		_pxiStatsReply(ch);
 		threadUnblockOneByValue(&s_pxiRecvQueue, ch);
 	}
 
@@ -63,6 +196,12 @@ MK_INLINE u32 _pxiProcessData(u32 state, u32 data)
 
 	state --;
 	if_unlikely (!(state & (1U << 26))) {
+		if (ch == PxiChannel_Extended) {
+			// Tagged replies only ever carry a single data word
+			_pxiTagComplete(s_pxiRecvTag, data);
+			return 0;
+		}
+
 		_pxiRecvUnhandled(ch, data);
 		return state;
 	}
@@ -77,8 +216,263 @@ MK_INLINE u32 _pxiProcessData(u32 state, u32 data)
 	return state;
 }
 
+MK_INLINE void _pxiBulkFlush(const volatile void* addr, size_t size)
+{
+#if defined(ARM9)
+	armDCacheFlush(addr, size);
+#endif
+}
+
+MK_INLINE void _pxiBulkInvalidate(const volatile void* addr, size_t size)
+{
+#if defined(ARM9)
+	armDCacheInvalidate(addr, size);
+#endif
+}
+
+MK_CONSTEXPR u32 _pxiBulkMsgSlots(unsigned num_words)
+{
+	return (4*(1+num_words) + PXI_BULK_SLOT_SZ-1) / PXI_BULK_SLOT_SZ;
+}
+
+static void _pxiBulkSetup(PxiChannelState* state, void* mem, size_t size)
+{
+	size_t ring_sz = size/2;
+	u32 num_slots = (ring_sz - sizeof(PxiBulkRing)) / PXI_BULK_SLOT_SZ;
+	state->bulk_slots = 1U << (31 - __builtin_clz(num_slots));
+
+	// The first ring carries messages from the ARM9 to the ARM7, and the second one the other way around
+	PxiBulkRing* rings[2] = { (PxiBulkRing*)mem, (PxiBulkRing*)((u8*)mem + ring_sz) };
+#if defined(ARM9)
+	state->bulk_rx = rings[1];
+#elif defined(ARM7)
+	state->bulk_rx = rings[0];
+	state->bulk_tx = rings[1];
+#endif
+}
+
+// Copies a message into the transmit ring. Returns false if it does not fit.
+static bool _pxiBulkSend(PxiChannelState* state, u32 packet, const u32* data)
+{
+	PxiBulkRing* ring = state->bulk_tx;
+	u32 num_slots = state->bulk_slots;
+	unsigned num_words = pxiExtPacketGetNumWords(packet);
+	u32 need = _pxiBulkMsgSlots(num_words);
+
+	_pxiBulkInvalidate(&ring->tail, PXI_BULK_SLOT_SZ);
+	u32 head = ring->head;
+	u32 pos = head & (num_slots-1);
+	u32 pad = pos + need > num_slots ? num_slots - pos : 0;
+	if (num_slots - (head - ring->tail) < pad + need) {
+		return false;
+	}
+
+	if (pad) {
+		ring->data[pos*PXI_BULK_SLOT_WORDS] = 0;
+		_pxiBulkFlush(&ring->data[pos*PXI_BULK_SLOT_WORDS], PXI_BULK_SLOT_SZ);
+		head += pad;
+		pos = 0;
+	}
+
+	u32* msg = &ring->data[pos*PXI_BULK_SLOT_WORDS];
+	msg[0] = packet;
+	memcpy(&msg[1], data, num_words*4);
+	_pxiBulkFlush(msg, need*PXI_BULK_SLOT_SZ);
+
+	ring->head = head + need;
+	_pxiBulkFlush(&ring->head, PXI_BULK_SLOT_SZ);
+	return true;
+}
+
+// Receives the next message from the receive ring. Each message is announced by its own
+// doorbell, so that it is delivered in the same order relative to messages sent through
+// the FIFO (including plain packets on the same channel).
+static void _pxiBulkRecv(PxiChannelState* state)
+{
+	PxiBulkRing* ring = state->bulk_rx;
+	if_unlikely (!ring) {
+		return;
+	}
+
+	u32 mask = state->bulk_slots - 1;
+	u32 tail = ring->tail;
+	u32* msg = &ring->data[(tail & mask)*PXI_BULK_SLOT_WORDS];
+	_pxiBulkInvalidate(msg, PXI_BULK_SLOT_SZ);
+
+	u32 packet = msg[0];
+	if_unlikely (!packet) {
+		// Skip to the start of the ring
+		tail = (tail | mask) + 1;
+		msg = &ring->data[0];
+		_pxiBulkInvalidate(msg, PXI_BULK_SLOT_SZ);
+		packet = msg[0];
+	}
+
+	unsigned num_words = pxiExtPacketGetNumWords(packet);
+	u32 need = _pxiBulkMsgSlots(num_words);
+	if (need > 1) {
+		_pxiBulkInvalidate(msg + PXI_BULK_SLOT_WORDS, (need-1)*PXI_BULK_SLOT_SZ);
+	}
+
+	// Deliver the message as if it had been received through the FIFO
+	u32 recv_state = _pxiProcessPacket(packet);
+	for (unsigned i = 0; i < num_words; i ++) {
+		recv_state = _pxiProcessData(recv_state, msg[1+i]);
+	}
+
+	ring->tail = tail + need;
+	_pxiBulkFlush(&ring->tail, PXI_BULK_SLOT_SZ);
+}
+
+static void _pxiBulkHandler(void* user, u32 data)
+{
+	static unsigned attach_words = 0;
+	static PxiChannel attach_ch;
+	static u32 attach_args[2];
+
+	if_unlikely (attach_words) {
+		attach_args[sizeof(attach_args)/4 - (attach_words--)] = data;
+		if (!attach_words) {
+			_pxiBulkSetup(&s_pxiChannels[attach_ch], (void*)attach_args[0], attach_args[1]);
+		}
+		return;
+	}
+
+	// Doorbells are plain messages carrying the channel number, while the
+	// ARM9 announces new transports with an extended message
+	PxiChannel ch = (PxiChannel)(data & 0x1f);
+	unsigned num_words = data >> 26;
+	if_likely (!num_words) {
+		_pxiBulkRecv(&s_pxiChannels[ch]);
+	} else if (num_words == sizeof(attach_args)/4) {
+		attach_ch = ch;
+		attach_words = num_words;
+	}
+}
+
+MK_INLINE unsigned _pxiPacketGetNumWords(u32 packet)
+{
+	if_likely (pxiPacketGetChannel(packet) != PxiChannel_Extended) {
+		return 1;
+	} else {
+		return 1 + pxiExtPacketGetNumWords(packet);
+	}
+}
+
+MK_INLINE unsigned _pxiSendFindQueue(void)
+{
+	unsigned prio;
+	for (prio = 0; prio < PxiPrio_Count && s_pxiSendQueues[prio].head == s_pxiSendQueues[prio].tail; prio ++);
+	return prio;
+}
+
+MK_INLINE PxiChannel _pxiPacketGetAnyChannel(u32 packet)
+{
+	PxiChannel ch = pxiPacketGetChannel(packet);
+	return ch != PxiChannel_Extended ? ch : pxiExtPacketGetChannel(packet);
+}
+
+#if defined(CALICO_PXI_STATS)
+
+MK_INLINE void _pxiStatsSendBegin(u32 packet)
+{
+	s_pxiStatsSendCh = _pxiPacketGetAnyChannel(packet);
+}
+
+static void _pxiStatsFifoStall(unsigned words)
+{
+	// Blame the message being transmitted, or otherwise the next one in line
+	PxiChannel ch = s_pxiStatsSendCh;
+	if (!words) {
+		PxiSendQueue* q = &s_pxiSendQueues[_pxiSendFindQueue()];
+		ch = _pxiPacketGetAnyChannel(q->buf[q->tail & (PXI_SEND_QUEUE_WORDS-1)]);
+	}
+
+	s_pxiStats.channels[ch].fifo_stalls ++;
+}
+
+#else
+
+MK_INLINE void _pxiStatsSendBegin(u32 packet) { }
+MK_INLINE void _pxiStatsFifoStall(unsigned words) { }
+
+#endif
+
+// Moves as many queued words as possible into the hardware FIFO. Must be called with IRQs disabled.
+static void _pxiSendDrain(void)
+{
+	unsigned prio = s_pxiSendCurPrio;
+	unsigned words = s_pxiSendCurWords;
+	u32 freed = 0;
+
+	while (!(REG_PXI_CNT & PXI_CNT_SEND_FULL)) {
+		// Select the highest priority queue with pending messages, unless we are in the middle of one
+		if_likely (!words) {
+			prio = _pxiSendFindQueue();
+			if (prio == PxiPrio_Count) {
+				break;
+			}
+
+			PxiSendQueue* q = &s_pxiSendQueues[prio];
+			u32 packet = q->buf[q->tail & (PXI_SEND_QUEUE_WORDS-1)];
+			words = _pxiPacketGetNumWords(packet);
+			_pxiStatsSendBegin(packet);
+		}
+
+		PxiSendQueue* q = &s_pxiSendQueues[prio];
+		REG_PXI_SEND = q->buf[(q->tail++) & (PXI_SEND_QUEUE_WORDS-1)];
+		freed |= 1U << prio;
+		words --;
+	}
+
+	if_unlikely (words || _pxiSendFindQueue() != PxiPrio_Count) {
+		s_pxiSendStats.fifo_stalls ++;
+		_pxiStatsFifoStall(words);
+	}
+
+	s_pxiSendCurPrio = prio;
+	s_pxiSendCurWords = words;
+
+	if (freed) {
+		threadUnblockAllByMask(&s_pxiSendWaitQueue, freed);
+	}
+}
+
+static void _pxiSendIrqHandler(void)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	_pxiSendDrain();
+	armIrqUnlockByPsr(st);
+}
+
+// Copies a message into a send queue, waiting for room if needed. Must be called with IRQs disabled.
+static void _pxiSendEnqueue(PxiPrio prio, u32 packet, const u32* data, unsigned num_words)
+{
+	PxiSendQueue* q = &s_pxiSendQueues[prio];
+
+	while (PXI_SEND_QUEUE_WORDS - (q->head - q->tail) < 1 + num_words) {
+		s_pxiSendStats.queue_stalls ++;
+		threadBlock(&s_pxiSendWaitQueue, 1U << prio);
+	}
+
+	u32 head = q->head;
+	q->buf[(head++) & (PXI_SEND_QUEUE_WORDS-1)] = packet;
+	while (num_words--) {
+		q->buf[(head++) & (PXI_SEND_QUEUE_WORDS-1)] = *data++;
+	}
+	q->head = head;
+
+	u32 depth = head - q->tail;
+	if (depth > s_pxiSendStats.max_depth[prio]) {
+		s_pxiSendStats.max_depth[prio] = depth;
+	}
+
+	_pxiSendDrain();
+}
+
 static void _pxiRecvIrqHandler(void)
 {
+	u32 start = _pxiStatsNow();
 	u32 state = s_pxiRecvState;
 
 	while (!(REG_PXI_CNT & PXI_CNT_RECV_EMPTY)) {
@@ -91,6 +485,7 @@ static void _pxiRecvIrqHandler(void)
 	}
 
 	s_pxiRecvState = state;
+	_pxiStatsRecvIrq(start);
 }
 
 static void _pxiMailboxHandler(void* user, u32 data)
@@ -103,8 +498,20 @@ void _pxiInit(void)
 {
 	REG_PXI_CNT |= PXI_CNT_SEND_IRQ | PXI_CNT_RECV_IRQ;
 	REG_PXI_SYNC = PXI_SYNC_IRQ_ENABLE;
+
+	for (unsigned i = 0; i < PxiChannel_Count; i ++) {
+		s_pxiChannels[i].send_prio = PxiPrio_Normal;
+	}
+	s_pxiChannels[PxiChannel_Sound].send_prio  = PxiPrio_High;
+	s_pxiChannels[PxiChannel_Mic].send_prio    = PxiPrio_High;
+	s_pxiChannels[PxiChannel_Reset].send_prio  = PxiPrio_High;
+	s_pxiChannels[PxiChannel_BlkDev].send_prio = PxiPrio_Low;
+	s_pxiChannels[PxiChannel_NetBuf].send_prio = PxiPrio_Low;
+
+	irqSet(IRQ_PXI_SEND, _pxiSendIrqHandler);
 	irqSet(IRQ_PXI_RECV, _pxiRecvIrqHandler);
 	irqEnable(IRQ_PXI_SEND | IRQ_PXI_RECV | IRQ_PXI_SYNC);
+	pxiSetHandler(PxiChannel_Bulk, _pxiBulkHandler, NULL);
 }
 
 void pxiWaitForPing(void)
@@ -148,39 +555,134 @@ void pxiWaitRemote(PxiChannel ch)
 	}
 }
 
-MK_INLINE void _pxiSendWord(u32 word)
+void pxiSetChannelPrio(PxiChannel ch, PxiPrio prio)
+{
+	if (ch < PxiChannel_Count && prio < PxiPrio_Count) {
+		s_pxiChannels[ch].send_prio = prio;
+	}
+}
+
+void pxiGetSendQueueStats(PxiSendQueueStats* out)
 {
-	while (REG_PXI_CNT & PXI_CNT_SEND_FULL)
-		threadIrqWait(false, IRQ_PXI_SEND);
+	ArmIrqState st = armIrqLockByPsr();
+
+	*out = s_pxiSendStats;
+	for (unsigned i = 0; i < PxiPrio_Count; i ++) {
+		out->depth[i] = s_pxiSendQueues[i].head - s_pxiSendQueues[i].tail;
+	}
+
+	armIrqUnlockByPsr(st);
+}
 
-	REG_PXI_SEND = word;
+#if defined(CALICO_PXI_STATS)
+
+bool pxiGetStats(PxiStats* out)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	*out = s_pxiStats;
+	armIrqUnlockByPsr(st);
+	return true;
 }
 
+void pxiResetStats(void)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	memset(&s_pxiStats, 0, sizeof(s_pxiStats));
+	armIrqUnlockByPsr(st);
+}
+
+#else
+
+bool pxiGetStats(PxiStats* out)
+{
+	return false;
+}
+
+void pxiResetStats(void)
+{
+}
+
+#endif
+
 void pxiSendPacket(u32 packet)
 {
-	mutexLock(&s_pxiSendMutex);
-	_pxiSendWord(packet);
-	mutexUnlock(&s_pxiSendMutex);
+	PxiChannel ch = pxiPacketGetChannel(packet);
+	_traceRecord(TraceEvent_PxiSend, ch, packet, 0);
+
+	ArmIrqState st = armIrqLockByPsr();
+	_pxiStatsTx(ch, 1);
+	_pxiSendEnqueue((PxiPrio)s_pxiChannels[ch].send_prio, packet, NULL, 0);
+	armIrqUnlockByPsr(st);
 }
 
 void pxiSendExtPacket(u32 packet, const u32* data)
 {
-	mutexLock(&s_pxiSendMutex);
-
+	PxiChannel ch = pxiExtPacketGetChannel(packet);
 	u32 num_words = pxiExtPacketGetNumWords(packet);
+	_traceRecord(TraceEvent_PxiSend, ch, packet, num_words);
+
+	PxiChannelState* state = &s_pxiChannels[ch];
+	PxiPrio prio = (PxiPrio)state->send_prio;
+	ArmIrqState st = armIrqLockByPsr();
+	_pxiStatsTx(ch, 1 + num_words);
 
-	_pxiSendWord(packet);
-	while (num_words--)
-		_pxiSendWord(*data++);
+	// The doorbell goes through the same send queue, which keeps the message in order
+	if (state->bulk_tx && _pxiBulkSend(state, packet, data)) {
+		_pxiStatsTx(PxiChannel_Bulk, 1);
+		_pxiSendEnqueue(prio, pxiMakePacket(PxiChannel_Bulk, false, ch), NULL, 0);
+	} else {
+		_pxiSendEnqueue(prio, packet, data, num_words);
+	}
 
-	mutexUnlock(&s_pxiSendMutex);
+	armIrqUnlockByPsr(st);
 }
 
+#if defined(ARM9)
+
+bool pxiBulkAttach(PxiChannel ch, void* mem, size_t size)
+{
+	uptr p = (uptr)mem;
+	if (ch >= PxiChannel_Count || ch == PxiChannel_Bulk || (p & (PXI_BULK_SLOT_SZ-1)) ||
+		p < MM_MAINRAM || p >= MM_DTCM || size < PXI_BULK_MEM_SZ(PXI_BULK_MIN_SLOTS) || (size & (2*PXI_BULK_SLOT_SZ-1))) {
+		return false;
+	}
+
+	PxiChannelState* state = &s_pxiChannels[ch];
+	if (state->bulk_rx) {
+		return false;
+	}
+
+	// Clear the control words of both rings, and make sure no dirty cache lines are left behind
+	memset(mem, 0, sizeof(PxiBulkRing));
+	memset((u8*)mem + size/2, 0, sizeof(PxiBulkRing));
+	armDCacheFlush(mem, size);
+	_pxiBulkSetup(state, mem, size);
+
+	// Announce the transport. Messages sent through the FIFO before this point
+	// are processed by the ARM7 before it starts looking at the rings.
+	u32 args[2] = { p, size };
+	u32 packet = pxiMakeExtPacket(PxiChannel_Bulk, false, sizeof(args)/sizeof(u32), ch);
+	pxiWaitRemote(PxiChannel_Bulk);
+	_traceRecord(TraceEvent_PxiSend, PxiChannel_Bulk, packet, sizeof(args)/sizeof(u32));
+
+	// The announcement is queued at the priority of the target channel (which is
+	// also used by its doorbells), so that no doorbell can overtake it
+	ArmIrqState st = armIrqLockByPsr();
+	_pxiStatsTx(PxiChannel_Bulk, 1 + sizeof(args)/sizeof(u32));
+	_pxiSendEnqueue((PxiPrio)state->send_prio, packet, args, sizeof(args)/sizeof(u32));
+	state->bulk_tx = (PxiBulkRing*)mem;
+	armIrqUnlockByPsr(st);
+	return true;
+}
+
+#endif
+
 void pxiBeginReceive(PxiChannel ch)
 {
 	PxiChannelState* state = &s_pxiChannels[ch];
 	mutexLock(&state->recv_mutex);
 	state->reply = PXI_NO_REPLY;
+	_pxiStatsRequest(ch);
 }
 
 u32 pxiEndReceive(PxiChannel ch)
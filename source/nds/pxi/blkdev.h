@@ -2,16 +2,21 @@
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
 #include <calico/types.h>
 #include <calico/dev/blk.h>
+#include <calico/dev/dldi_defs.h>
 #include <calico/nds/pxi.h>
+#include <calico/nds/pxirpc.h>
 
-typedef enum PxiBlkDevMsgType {
-	// ARM9 -> ARM7
-	PxiBlkDevMsg_IsPresent    = 0,
-	PxiBlkDevMsg_Init         = 1,
-	PxiBlkDevMsg_ReadSectors  = 2,
-	PxiBlkDevMsg_WriteSectors = 3,
-	PxiBlkDevMsg_DumpDldi     = 4,
+// ARM9 -> ARM7 remote procedures
+#define PXI_BLKDEV_RPC(_, _x) \
+	_(_x, blkDevIsPresent,    PXI_RPC_RET(bool), PXI_RPC_VAL(BlkDevice, dev)) \
+	_(_x, blkDevInit,         PXI_RPC_RET(bool), PXI_RPC_VAL(BlkDevice, dev)) \
+	_(_x, blkDevReadSectors,  PXI_RPC_RET(bool), PXI_RPC_VAL(BlkDevice, dev), \
+		PXI_RPC_OUT(void*, buffer, num_sectors*BLK_SECTOR_SZ), PXI_RPC_VAL(u32, first_sector), PXI_RPC_VAL(u32, num_sectors)) \
+	_(_x, blkDevWriteSectors, PXI_RPC_RET(bool), PXI_RPC_VAL(BlkDevice, dev), \
+		PXI_RPC_IN(const void*, buffer, num_sectors*BLK_SECTOR_SZ), PXI_RPC_VAL(u32, first_sector), PXI_RPC_VAL(u32, num_sectors)) \
+	_(_x, _blkDumpDldi,       PXI_RPC_RET(bool), PXI_RPC_OUT(void*, buffer, DLDI_MAX_ALLOC_SZ))
 
+typedef enum PxiBlkDevMsgType {
 	// ARM7 -> ARM9
 	PxiBlkDevMsg_Removed      = 0x1e,
 	PxiBlkDevMsg_Inserted     = 0x1f,
@@ -19,7 +24,7 @@ typedef enum PxiBlkDevMsgType {
 
 MK_CONSTEXPR u32 pxiBlkDevMakeMsg(PxiBlkDevMsgType type, unsigned imm)
 {
-	return (type & 0x1f) | ((imm & 0x7ff) << 5);
+	return (type & 0x1f) | ((imm & 0xff) << 5);
 }
 
 MK_CONSTEXPR PxiBlkDevMsgType pxiBlkDevMsgGetType(u32 msg)
@@ -29,5 +34,5 @@ MK_CONSTEXPR PxiBlkDevMsgType pxiBlkDevMsgGetType(u32 msg)
 
 MK_CONSTEXPR unsigned pxiBlkDevMsgGetImmediate(u32 msg)
 {
-	return (msg >> 5) & 0x7ff;
+	return (msg >> 5) & 0xff;
 }
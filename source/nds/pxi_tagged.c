@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/mailbox.h>
+#include <calico/nds/pxi.h>
+#include <calico/nds/pxirpc.h>
+#include "pxi-priv.h"
+
+// Tagged request bookkeeping and remote procedure call dispatch. These only
+// depend on the PXI packet format (not on the hardware), so that they can also
+// be exercised against a software loopback.
+
+static ThrListNode s_pxiTagQueue;
+static u32 s_pxiTagReplies[PXI_NUM_TAGS];
+static u16 s_pxiTagsUsed;
+static u16 s_pxiTagsDone;
+
+void _pxiTagComplete(unsigned tag, u32 data)
+{
+	u32 mask = 1U << tag;
+	if_likely (tag < PXI_NUM_TAGS && (s_pxiTagsUsed & mask)) {
+		s_pxiTagReplies[tag] = data;
+		s_pxiTagsDone |= mask;
+		threadUnblockAllByMask(&s_pxiTagQueue, mask);
+	}
+}
+
+unsigned pxiBeginTaggedReceive(void)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	while (s_pxiTagsUsed == (1U << PXI_NUM_TAGS) - 1) {
+		threadBlock(&s_pxiTagQueue, 1U << PXI_NUM_TAGS);
+	}
+
+	unsigned tag = __builtin_ctz(~s_pxiTagsUsed);
+	s_pxiTagsUsed |= 1U << tag;
+	_pxiStatsTagRequest(tag);
+
+	armIrqUnlockByPsr(st);
+	return tag;
+}
+
+u32 pxiEndTaggedReceive(unsigned tag)
+{
+	u32 mask = 1U << tag;
+	if (tag >= PXI_NUM_TAGS || !(s_pxiTagsUsed & mask)) {
+		return PXI_NO_REPLY;
+	}
+
+	ArmIrqState st = armIrqLockByPsr();
+
+	while (!(s_pxiTagsDone & mask)) {
+		threadBlock(&s_pxiTagQueue, mask);
+	}
+
+	u32 reply = s_pxiTagReplies[tag];
+	s_pxiTagsDone &= ~mask;
+	s_pxiTagsUsed &= ~mask;
+
+	// Let a thread waiting for a free tag in
+	threadUnblockOneByMask(&s_pxiTagQueue, 1U << PXI_NUM_TAGS);
+
+	armIrqUnlockByPsr(st);
+
+	return reply;
+}
+
+void pxiRpcDispatch(PxiChannel ch, const PxiRpcTable* table, Mailbox* mb, u32 msg)
+{
+	// Calls without parameters are sent as simple messages
+	unsigned num_words = msg >> 26;
+	unsigned id = num_words ? (msg & 0x1fff) : (msg & 0x7fffff);
+
+	u32 args[PXI_RPC_MAX_ARGS];
+	for (unsigned i = 0; i < num_words; i ++) {
+		u32 word = mailboxRecv(mb);
+		if_likely (i < PXI_RPC_MAX_ARGS) {
+			args[i] = word;
+		}
+	}
+
+	// Unknown procedures are still replied to, so that the caller does not hang
+	u32 ret = 0;
+	if_likely (id < table->num_fns) {
+		ret = table->fns[id](args);
+	}
+
+	pxiReplyTagged(ch, pxiMsgGetTag(msg), ret);
+}
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/waitany.h>
+#include <calico/system/coro.h>
+#include "thread-priv.h"
+
+#define CORO_MAX_WAIT_OBJS (1+CORO_MAX_MAILBOX_WAITS)
+
+static void _coroTimerTask(TickTask* task)
+{
+	Coro* co = (Coro*)task;
+	co->timer_fired = true;
+	coroWake(co);
+}
+
+void _coroArmTimer(Coro* co, u32 ticks)
+{
+	co->timer_fired = false;
+	tickTaskStart(&co->timer, _coroTimerTask, ticks, 0);
+}
+
+void coroWake(Coro* co)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	co->woken = true;
+	if (!co->queued && !co->finished) {
+		co->queued = mailboxTrySend(&co->loop->wake_mb, threadPtrToToken(co));
+	}
+
+	armIrqUnlockByPsr(st);
+}
+
+void coroStart(CoroLoop* loop, Coro* co, CoroFn fn)
+{
+	*co = (Coro){0};
+	co->loop = loop;
+	co->fn = fn;
+
+	co->next = loop->list;
+	loop->list = co;
+
+	// Schedule the first run
+	coroWake(co);
+}
+
+static void _coroResume(CoroLoop* loop, Coro* co)
+{
+	if_unlikely (co->finished) {
+		return;
+	}
+
+	if_likely (co->fn(co) == CORO_WAITING) {
+		return;
+	}
+
+	// Remove the coroutine from the loop
+	tickTaskStop(&co->timer);
+	co->finished = true;
+	co->wait_mb = NULL;
+
+	Coro** pco = &loop->list;
+	while (*pco != co) {
+		pco = &(*pco)->next;
+	}
+	*pco = co->next;
+}
+
+void coroLoopRun(CoroLoop* loop)
+{
+	ThrWaitObj objs[CORO_MAX_WAIT_OBJS];
+
+	while (loop->list) {
+		// Resume all coroutines that were woken up
+		u32 msg;
+		if (mailboxTryRecv(&loop->wake_mb, &msg)) {
+			Coro* co = (Coro*)threadTokenToPtr(msg);
+			ArmIrqState st = armIrqLockByPsr();
+			co->queued = false;
+			armIrqUnlockByPsr(st);
+			_coroResume(loop, co);
+			continue;
+		}
+
+		// Resume coroutines whose mailbox has messages, collecting the rest
+		objs[0].type = ThrWaitType_Mailbox;
+		objs[0].mailbox = &loop->wake_mb;
+		unsigned num_objs = 1;
+		bool progress = false;
+		bool overflow = false;
+
+		Coro* next;
+		for (Coro* co = loop->list; co; co = next) {
+			next = co->next;
+			if (!co->wait_mb) {
+				continue;
+			}
+
+			if (co->wait_mb->pending_slots) {
+				_coroResume(loop, co);
+				progress = true;
+			} else if (num_objs < CORO_MAX_WAIT_OBJS) {
+				objs[num_objs].type = ThrWaitType_Mailbox;
+				objs[num_objs].mailbox = co->wait_mb;
+				num_objs ++;
+			} else {
+				overflow = true;
+			}
+		}
+
+		// Sleep until anything happens, polling the mailboxes that did not fit
+		if (!progress && loop->list) {
+			threadWaitAny(objs, num_objs, overflow ? CORO_POLL_TICKS : THREAD_WAIT_INFINITE);
+		}
+	}
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/dpc.h>
+
+typedef struct DpcQueue {
+	DpcItem* head;
+	DpcItem* tail;
+} DpcQueue;
+
+static Thread s_dpcThread;
+alignas(8) static u8 s_dpcThreadStack[1024];
+
+static ThrListNode s_dpcWaitQueue;
+static DpcQueue s_dpcQueues[DPC_NUM_PRIOS];
+static u32 s_dpcMask;
+static bool s_dpcStarted;
+
+bool dpcQueue(DpcItem* item)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (item->pending) {
+		armIrqUnlockByPsr(st);
+		return false;
+	}
+
+	// Append the item to the tail of its priority level
+	DpcQueue* q = &s_dpcQueues[item->prio];
+	item->next = NULL;
+	item->pending = true;
+	if (q->tail) {
+		q->tail->next = item;
+	} else {
+		q->head = item;
+		s_dpcMask |= 1U << item->prio;
+	}
+	q->tail = item;
+
+	// Wake up the worker thread
+	if_likely (s_dpcWaitQueue.next) {
+		threadUnblockAllByValue(&s_dpcWaitQueue, 1);
+	}
+
+	armIrqUnlockByPsr(st);
+	return true;
+}
+
+bool dpcCancel(DpcItem* item)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = item->pending;
+	if (rc) {
+		DpcQueue* q = &s_dpcQueues[item->prio];
+		DpcItem* prev = NULL;
+		for (DpcItem* cur = q->head; cur != item; cur = cur->next) {
+			prev = cur;
+		}
+
+		if (prev) {
+			prev->next = item->next;
+		} else {
+			q->head = item->next;
+		}
+		if (q->tail == item) {
+			q->tail = prev;
+		}
+		if (!q->head) {
+			s_dpcMask &= ~(1U << item->prio);
+		}
+
+		item->pending = false;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+static int _dpcThreadMain(void* arg)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	for (;;) {
+		if_unlikely (!s_dpcMask) {
+			threadBlock(&s_dpcWaitQueue, 1);
+			continue;
+		}
+
+		// Pop the oldest item from the highest priority level
+		unsigned prio = __builtin_ctz(s_dpcMask);
+		DpcQueue* q = &s_dpcQueues[prio];
+		DpcItem* item = q->head;
+		q->head = item->next;
+		if (!q->head) {
+			q->tail = NULL;
+			s_dpcMask &= ~(1U << prio);
+		}
+		item->pending = false;
+
+		// Run the item with interrupts enabled (it may queue itself again)
+		armIrqUnlockByPsr(st);
+		item->fn(item);
+		st = armIrqLockByPsr();
+	}
+
+	return 0;
+}
+
+void dpcStartServer(u8 thread_prio)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	bool started = s_dpcStarted;
+	s_dpcStarted = true;
+	armIrqUnlockByPsr(st);
+
+	if_unlikely (started) {
+		return;
+	}
+
+	threadPrepareWithStack(&s_dpcThread, _dpcThreadMain, NULL, s_dpcThreadStack, sizeof(s_dpcThreadStack), thread_prio);
+	threadStart(&s_dpcThread);
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/eventgroup.h>
+
+#define EV_NO_TIMEOUT UINT32_MAX
+
+void eventGroupSet(EventGroup* e, u32 mask)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	e->flags |= mask;
+
+	// Wake up waiters interested in any of the new flags, they will recheck their condition
+	if (e->waiters.next) {
+		threadUnblockAllByMask(&e->waiters, mask);
+	}
+
+	armIrqUnlockByPsr(st);
+}
+
+void eventGroupClear(EventGroup* e, u32 mask)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	e->flags &= ~mask;
+	armIrqUnlockByPsr(st);
+}
+
+static u32 _eventGroupWait(EventGroup* e, u32 mask, unsigned mode, u32 timeout_ticks)
+{
+	if_unlikely (!mask) {
+		return 0;
+	}
+
+	ArmIrqState st = armIrqLockByPsr();
+
+	u32 deadline = 0;
+	if (timeout_ticks != EV_NO_TIMEOUT) {
+		deadline = (u32)tickGetCount() + timeout_ticks;
+	}
+
+	for (;;) {
+		u32 cur = e->flags & mask;
+		if ((mode & EVENT_WAIT_ALL) ? cur == mask : cur != 0) {
+			if (mode & EVENT_WAIT_CLEAR) {
+				e->flags &= ~cur;
+			}
+
+			armIrqUnlockByPsr(st);
+			return cur;
+		}
+
+		if_likely (timeout_ticks == EV_NO_TIMEOUT) {
+			threadBlock(&e->waiters, mask);
+			continue;
+		}
+
+		// Partial wakeups (in wait-all mode) only wait for the remaining time
+		s32 remaining = deadline - (u32)tickGetCount();
+		if (remaining <= 0 || !threadBlockTimeout(&e->waiters, mask, remaining)) {
+			armIrqUnlockByPsr(st);
+			return 0;
+		}
+	}
+}
+
+u32 eventGroupWait(EventGroup* e, u32 mask, unsigned mode)
+{
+	return _eventGroupWait(e, mask, mode, EV_NO_TIMEOUT);
+}
+
+u32 eventGroupWaitTimeout(EventGroup* e, u32 mask, unsigned mode, u32 timeout_ticks)
+{
+	return _eventGroupWait(e, mask, mode, timeout_ticks);
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/irq.h>
+
+// Only sources of the main interrupt controller can be prioritized
+#if MK_IRQ_NUM_HANDLERS > 32
+#define IRQ_NEST_NUM_SOURCES 32
+#else
+#define IRQ_NEST_NUM_SOURCES MK_IRQ_NUM_HANDLERS
+#endif
+
+u32 __irq_nest_depth;
+
+// Mask of sources allowed to preempt the ISR of each source (read by the IRQ dispatcher).
+// Zero means that the ISR is not preemptible, and runs with interrupts disabled.
+u32 __irq_nest_allow[IRQ_NEST_NUM_SOURCES];
+
+static void* s_irqNestStackTop;
+static u8 s_irqNestBoost[IRQ_NEST_NUM_SOURCES]; // IRQ_PRIO_DEFAULT minus the priority level
+static IrqMask s_irqNestPinned;
+
+// IE as seen by software while any preemptible ISR runs, and the sources currently masked
+static IrqMask s_irqNestSoftIe;
+static IrqMask s_irqNestBlocked;
+static IrqMask s_irqNestSavedBlocked[IRQ_NUM_PRIOS];
+#if MK_IRQ_NUM_HANDLERS > 32
+static IrqMask s_irqNestSoftIe2;
+#endif
+
+static void _irqNestRecalc(void)
+{
+	// Pinned sources take the highest priority level in use, so that they
+	// preempt every other source and are never preempted themselves
+	u8 boost[IRQ_NEST_NUM_SOURCES];
+	u8 top = 0;
+	for (unsigned i = 0; i < IRQ_NEST_NUM_SOURCES; i ++) {
+		if (!(s_irqNestPinned & (1U << i)) && s_irqNestBoost[i] > top) {
+			top = s_irqNestBoost[i];
+		}
+	}
+	for (unsigned i = 0; i < IRQ_NEST_NUM_SOURCES; i ++) {
+		boost[i] = (s_irqNestPinned & (1U << i)) ? top : s_irqNestBoost[i];
+	}
+
+	for (unsigned i = 0; i < IRQ_NEST_NUM_SOURCES; i ++) {
+		u32 allow = 0;
+		if (s_irqNestStackTop) {
+			for (unsigned j = 0; j < IRQ_NEST_NUM_SOURCES; j ++) {
+				if (boost[j] > boost[i]) {
+					allow |= 1U << j;
+				}
+			}
+		}
+		__irq_nest_allow[i] = allow;
+	}
+}
+
+void irqEnableNesting(void* stack_top)
+{
+	IrqState st = irqLock();
+	s_irqNestStackTop = stack_top;
+	_irqNestRecalc();
+	irqUnlock(st);
+}
+
+void irqSetPrio(IrqMask mask, unsigned prio)
+{
+	if (prio > IRQ_PRIO_DEFAULT) {
+		prio = IRQ_PRIO_DEFAULT;
+	}
+
+	IrqState st = irqLock();
+	for (unsigned i = 0; i < IRQ_NEST_NUM_SOURCES; i ++) {
+		if (mask & (1U << i)) {
+			s_irqNestBoost[i] = IRQ_PRIO_DEFAULT - prio;
+		}
+	}
+	_irqNestRecalc();
+	irqUnlock(st);
+}
+
+// Called by the tick subsystem for the sources that update its counters, since
+// readers of the counters cannot cope with their ISRs being preempted
+void _irqNestPin(IrqMask mask)
+{
+	IrqState st = irqLock();
+	s_irqNestPinned |= mask;
+	_irqNestRecalc();
+	irqUnlock(st);
+}
+
+// Called by the IRQ dispatcher (with interrupts disabled) before running a preemptible ISR.
+// Returns the stack to run the ISR on, or NULL if it is already running on the ISR stack.
+void* _irqNestEnter(unsigned id)
+{
+	unsigned depth = __irq_nest_depth++;
+	s_irqNestSavedBlocked[depth] = s_irqNestBlocked;
+
+	if (!depth) {
+		s_irqNestSoftIe = REG_IE;
+#if MK_IRQ_NUM_HANDLERS > 32
+		s_irqNestSoftIe2 = REG_IE2;
+		REG_IE2 = 0;
+#endif
+	}
+
+	s_irqNestBlocked |= ~__irq_nest_allow[id];
+	REG_IE = s_irqNestSoftIe & ~s_irqNestBlocked;
+
+	return depth ? NULL : s_irqNestStackTop;
+}
+
+// Called by the IRQ dispatcher (with interrupts disabled) after running a preemptible ISR
+void _irqNestExit(void)
+{
+	unsigned depth = --__irq_nest_depth;
+	s_irqNestBlocked = s_irqNestSavedBlocked[depth];
+	REG_IE = s_irqNestSoftIe & ~s_irqNestBlocked;
+
+#if MK_IRQ_NUM_HANDLERS > 32
+	if (!depth) {
+		REG_IE2 = s_irqNestSoftIe2;
+	}
+#endif
+}
+
+void _irqNestModifyIe(IrqMask set, IrqMask clear)
+{
+	s_irqNestSoftIe = (s_irqNestSoftIe | set) &~ clear;
+	REG_IE = s_irqNestSoftIe & ~s_irqNestBlocked;
+}
+
+#if MK_IRQ_NUM_HANDLERS > 32
+
+void _irqNestModifyIe2(IrqMask set, IrqMask clear)
+{
+	s_irqNestSoftIe2 = (s_irqNestSoftIe2 | set) &~ clear;
+}
+
+#endif
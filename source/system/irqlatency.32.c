@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <string.h>
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/irq.h>
+#include <calico/system/irqlatency.h>
+#include <calico/gba/timer.h>
+
+#if defined(CALICO_IRQ_LATENCY)
+
+static IrqLatencyStats s_irqLatencyStats;
+static u32 s_irqLatencyIrqId = UINT32_MAX;
+static unsigned s_irqLatencyTimer;
+static u16 s_irqLatencyReload;
+
+static void _irqLatencyProbeIsr(void)
+{
+	// Nothing to do: the sample is taken by the IRQ dispatcher
+}
+
+static void _irqLatencyRecordSite(u32 cycles, u32 pc)
+{
+	IrqLatencySite* sites = s_irqLatencyStats.sites;
+
+	// Replace the entry for the same address if present, otherwise the least delayed one
+	unsigned i;
+	for (i = 0; i < IRQ_LATENCY_NUM_SITES-1 && sites[i].pc != pc; i ++);
+	if (cycles <= sites[i].cycles) {
+		return;
+	}
+
+	// Keep the list sorted by descending latency
+	for (; i && sites[i-1].cycles < cycles; i --) {
+		sites[i] = sites[i-1];
+	}
+
+	sites[i].pc = pc;
+	sites[i].cycles = cycles;
+}
+
+// Called by the IRQ dispatcher (with interrupts disabled) before each interrupt handler
+void _irqLatencyEnter(unsigned irq_id, u32 pc)
+{
+	if_likely (irq_id != s_irqLatencyIrqId) {
+		return;
+	}
+
+	// The probe timer keeps counting up from its reload value after asserting the interrupt
+	u32 cycles = (u16)(REG_TMxCNT_L(s_irqLatencyTimer) - s_irqLatencyReload);
+
+	IrqLatencyStats* s = &s_irqLatencyStats;
+	s->num_samples ++;
+	s->total_cycles += cycles;
+	if (cycles < s->min_cycles) {
+		s->min_cycles = cycles;
+	}
+	if (cycles > s->max_cycles) {
+		s->max_cycles = cycles;
+	}
+
+	s->hist[cycles ? (32 - __builtin_clz(cycles)) : 0] ++;
+	_irqLatencyRecordSite(cycles, pc);
+}
+
+bool irqLatencyStart(unsigned timer_id, unsigned freq)
+{
+	// Timers 2 and 3 are reserved by the tick subsystem
+	if (timer_id >= 2 || !freq) {
+		return false;
+	}
+
+	irqLatencyStop();
+	irqLatencyReset();
+
+	IrqMask mask = IRQ_TIMER(timer_id);
+	IrqState st = irqLock();
+	s_irqLatencyTimer = timer_id;
+	s_irqLatencyIrqId = __builtin_ctz(mask);
+	s_irqLatencyReload = timerCalcReload(TIMER_PRESCALER_1, freq);
+	irqUnlock(st);
+
+	irqSet(mask, _irqLatencyProbeIsr);
+	timerBegin(timer_id, TIMER_PRESCALER_1, freq, true);
+	irqEnable(mask);
+	return true;
+}
+
+void irqLatencyStop(void)
+{
+	if (s_irqLatencyIrqId == UINT32_MAX) {
+		return;
+	}
+
+	IrqMask mask = IRQ_TIMER(s_irqLatencyTimer);
+	irqDisable(mask);
+	timerEnd(s_irqLatencyTimer);
+	irqClear(mask);
+	s_irqLatencyIrqId = UINT32_MAX;
+}
+
+void irqLatencyReset(void)
+{
+	IrqState st = irqLock();
+	memset(&s_irqLatencyStats, 0, sizeof(s_irqLatencyStats));
+	s_irqLatencyStats.min_cycles = UINT32_MAX;
+	irqUnlock(st);
+}
+
+bool irqLatencyGetStats(IrqLatencyStats* out)
+{
+	IrqState st = irqLock();
+	*out = s_irqLatencyStats;
+	irqUnlock(st);
+	return true;
+}
+
+#else
+
+bool irqLatencyStart(unsigned timer_id, unsigned freq)
+{
+	return false;
+}
+
+void irqLatencyStop(void)
+{
+}
+
+void irqLatencyReset(void)
+{
+}
+
+bool irqLatencyGetStats(IrqLatencyStats* out)
+{
+	return false;
+}
+
+#endif
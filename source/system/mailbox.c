@@ -4,8 +4,18 @@
 #include <calico/arm/common.h>
 #include <calico/system/thread.h>
 #include <calico/system/mailbox.h>
+#include "thread-priv.h"
 
-static ThrListNode s_mailboxRecvQueue;
+MK_INLINE u32 _mailboxPop(Mailbox* mb)
+{
+	u32 message = mb->slots[mb->cur_slot++];
+	mb->pending_slots --;
+	if (mb->cur_slot >= mb->num_slots) {
+		mb->cur_slot -= mb->num_slots;
+	}
+
+	return message;
+}
 
 bool mailboxTrySend(Mailbox* mb, u32 message)
 {
@@ -22,9 +32,10 @@ bool mailboxTrySend(Mailbox* mb, u32 message)
 	}
 
 	mb->slots[next_slot] = message;
-	if_likely (mb->recv_waiters) {
-		mb->recv_waiters --;
-		threadUnblockOneByValue(&s_mailboxRecvQueue, (u32)mb);
+	if_likely (mb->recv_queue.next) {
+		threadUnblockOneByValue(&mb->recv_queue, threadPtrToToken(mb));
+	} else {
+		threadWaitAnyNotify(ThrWaitType_Mailbox, mb);
 	}
 
 	armIrqUnlockByPsr(st);
@@ -40,11 +51,7 @@ bool mailboxTryRecv(Mailbox* mb, u32* out)
 		return false;
 	}
 
-	*out = mb->slots[mb->cur_slot++];
-	mb->pending_slots --;
-	if (mb->cur_slot >= mb->num_slots) {
-		mb->cur_slot -= mb->num_slots;
-	}
+	*out = _mailboxPop(mb);
 
 	armIrqUnlockByPsr(st);
 	return true;
@@ -54,17 +61,34 @@ u32 mailboxRecv(Mailbox* mb)
 {
 	ArmIrqState st = armIrqLockByPsr();
 
-	if_unlikely (!mb->pending_slots) {
-		mb->recv_waiters ++;
-		threadBlock(&s_mailboxRecvQueue, (u32)mb);
+	while (!mb->pending_slots) {
+		threadBlock(&mb->recv_queue, threadPtrToToken(mb));
 	}
 
-	u32 message = mb->slots[mb->cur_slot++];
-	mb->pending_slots --;
-	if (mb->cur_slot >= mb->num_slots) {
-		mb->cur_slot -= mb->num_slots;
-	}
+	u32 message = _mailboxPop(mb);
 
 	armIrqUnlockByPsr(st);
 	return message;
 }
+
+bool mailboxRecvTimeout(Mailbox* mb, u32* out, u32 timeout_ticks)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	u32 deadline = (u32)tickGetCount() + timeout_ticks;
+
+	// Another receiver may take the message we were woken up for, in which
+	// case only wait for the remaining time
+	while (!mb->pending_slots) {
+		s32 remaining = deadline - (u32)tickGetCount();
+		if_unlikely (remaining <= 0 || !threadBlockTimeout(&mb->recv_queue, threadPtrToToken(mb), remaining)) {
+			armIrqUnlockByPsr(st);
+			return false;
+		}
+	}
+
+	*out = _mailboxPop(mb);
+
+	armIrqUnlockByPsr(st);
+	return true;
+}
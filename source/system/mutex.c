@@ -6,6 +6,7 @@
 #include <calico/system/condvar.h>
 #include "thread-priv.h"
 
+// Shared wait queue for condition variables that cannot embed their own (see _condvarCompatWait)
 static ThrListNode s_cvWaitQueue;
 
 void threadUpdateDynamicPrio(Thread* t)
@@ -23,16 +24,16 @@ void threadUpdateDynamicPrio(Thread* t)
 			break;
 		}
 
-		// Requeue the thread
-		threadDequeue(t);
-		t->prio = prio;
-		threadEnqueue(t);
-
-		// If the thread is running we're done
+		// If the thread is running, requeue it into its new priority band and we're done
 		if_likely (t->status == ThrStatus_Running) {
+			threadDequeue(t);
+			t->prio = prio;
+			threadEnqueue(t);
 			break;
 		}
 
+		t->prio = prio;
+
 		// If the thread is paused (== not waiting on any queue) we're also done
 		ThrListNode* queue = t->queue;
 		if_likely (!queue) {
@@ -43,13 +44,15 @@ void threadUpdateDynamicPrio(Thread* t)
 		threadLinkDequeue(queue, t);
 		threadLinkEnqueue(queue, t);
 
-		// If the thread is not waiting on a mutex, we're done
-		if_likely (t->status != ThrStatus_WaitingOnMutex) {
+		// Update the holder thread's dynamic priority as well
+		if_likely (t->status == ThrStatus_WaitingOnMutex) {
+			t = ((Mutex*)threadTokenToPtr(t->token))->owner;
+		} else if (t->status == ThrStatus_WaitingOnRwLock) {
+			t = threadGetRwLockFromToken(t->token)->owner;
+		} else {
+			// The thread is not waiting on a lock, we're done
 			break;
 		}
-
-		// Update the holder thread's dynamic priority as well
-		t = ((Mutex*)t->token)->owner;
 	}
 }
 
@@ -63,7 +66,12 @@ static Thread* threadRemoveWaiter(Thread* t, u32 token)
 			threadLinkDequeue(&t->waiters, cur);
 			if_likely (!next_owner) {
 				next_owner = cur;
-				cur->status = !cur->pause ? ThrStatus_Running : ThrStatus_Waiting;
+				if_likely (!cur->pause) {
+					cur->status = ThrStatus_Running;
+					threadEnqueue(cur);
+				} else {
+					cur->status = ThrStatus_Waiting;
+				}
 			} else {
 				// TODO: Both the source list and the target list are sorted.
 				// Should we try to optimize this to take that into account?
@@ -95,6 +103,63 @@ bool mutexTryLock(Mutex* m)
 	return rc;
 }
 
+static void _mutexLockSlow(Mutex* m, Thread* self, ArmIrqState st)
+{
+	// Add current thread to owner thread's list of waiters
+	threadDequeue(self);
+	self->status = ThrStatus_WaitingOnMutex;
+	self->token = threadPtrToToken(m);
+	threadLinkEnqueue(&m->owner->waiters, self);
+
+	// Bump dynamic priority of owner thread if needed
+	Thread* next = NULL;
+	if_unlikely (self->prio < m->owner->prio) {
+		threadUpdateDynamicPrio(m->owner);
+
+		// Fast path when the owner thread is runnable
+		if_likely (m->owner->status == ThrStatus_Running) {
+			next = m->owner;
+		}
+	}
+
+	// Select next thread to run if above code didn't
+	if_likely (!next) {
+		next = threadFindRunnable();
+	}
+
+	threadSwitchTo(next, st);
+}
+
+static void _mutexTimeoutTask(TickTask* task)
+{
+	ThrTimeout* to = (ThrTimeout*)task;
+	Thread* t = to->thread;
+	Mutex* m = (Mutex*)to->obj;
+	ArmIrqState st = armIrqLockByPsr();
+
+	// Do nothing if the thread already acquired the mutex
+	if (t->status != ThrStatus_WaitingOnMutex || t->token != threadPtrToToken(m)) {
+		armIrqUnlockByPsr(st);
+		return;
+	}
+
+	// Remove the thread from the owner thread's list of waiters
+	Thread* resched = NULL;
+	threadLinkDequeue(t->queue, t);
+	if_likely (!t->pause) {
+		t->status = ThrStatus_Running;
+		threadEnqueue(t);
+		resched = t;
+	} else {
+		t->status = ThrStatus_Waiting;
+	}
+
+	// Drop the priority the owner thread may have inherited from us
+	threadUpdateDynamicPrio(m->owner);
+
+	threadReschedule(resched, st);
+}
+
 void mutexLock(Mutex* m)
 {
 	Thread* self = threadGetSelf();
@@ -105,29 +170,28 @@ void mutexLock(Mutex* m)
 		m->owner = self;
 		armIrqUnlockByPsr(st);
 	} else {
-		// Add current thread to owner thread's list of waiters
-		self->status = ThrStatus_WaitingOnMutex;
-		self->token = (u32)m;
-		threadLinkEnqueue(&m->owner->waiters, self);
-
-		// Bump dynamic priority of owner thread if needed
-		Thread* next = NULL;
-		if_unlikely (self->prio < m->owner->prio) {
-			threadUpdateDynamicPrio(m->owner);
-
-			// Fast path when the owner thread is runnable
-			if_likely (m->owner->status == ThrStatus_Running) {
-				next = m->owner;
-			}
-		}
+		_mutexLockSlow(m, self, st);
+	}
+}
 
-		// Select next thread to run if above code didn't
-		if_likely (!next) {
-			next = threadFindRunnable(s_firstThread);
-		}
+bool mutexLockTimeout(Mutex* m, u32 timeout_ticks)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
 
-		threadSwitchTo(next, st);
+	if_unlikely (m->owner) {
+		ThrTimeout to;
+		threadTimeoutStart(&to, _mutexTimeoutTask, m, timeout_ticks);
+		_mutexLockSlow(m, self, armIrqLockByPsr());
+		threadTimeoutStop(&to);
+	} else {
+		// Fast path: success
+		m->owner = self;
 	}
+
+	bool rc = m->owner == self;
+	armIrqUnlockByPsr(st);
+	return rc;
 }
 
 void mutexUnlock(Mutex* m)
@@ -140,11 +204,11 @@ void mutexUnlock(Mutex* m)
 	}
 
 	unsigned old_prio = self->prio;
-	m->owner = threadRemoveWaiter(self, (u32)m);
+	m->owner = threadRemoveWaiter(self, threadPtrToToken(m));
 
 	Thread* next = self;
 	if_unlikely (old_prio < self->prio) {
-		next = threadFindRunnable(s_firstThread);
+		next = threadFindRunnable();
 	}
 
 	if_unlikely (next != self)
@@ -153,27 +217,80 @@ void mutexUnlock(Mutex* m)
 		armIrqUnlockByPsr(st);
 }
 
+#define CV_NO_TIMEOUT UINT32_MAX
+
+static u32 _condvarBlock(ThrListNode* queue, u32 token, Mutex* m, u32 timeout_ticks)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (m->owner != self) {
+		for (;;); // ERROR
+	}
+
+	m->owner = threadRemoveWaiter(self, threadPtrToToken(m));
+	u32 rc;
+	if_likely (timeout_ticks == CV_NO_TIMEOUT) {
+		rc = threadBlock(queue, token);
+	} else {
+		rc = threadBlockTimeout(queue, token, timeout_ticks);
+	}
+	mutexLock(m);
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
 void condvarSignal(CondVar* cv)
 {
-	threadUnblockOneByValue(&s_cvWaitQueue, (u32)cv);
+	threadUnblockOneByValue(&cv->waiters, threadPtrToToken(cv));
 }
 
 void condvarBroadcast(CondVar* cv)
 {
-	threadUnblockAllByValue(&s_cvWaitQueue, (u32)cv);
+	threadUnblockAllByValue(&cv->waiters, threadPtrToToken(cv));
 }
 
 void condvarWait(CondVar* cv, Mutex* m)
 {
-	Thread* self = threadGetSelf();
+	_condvarBlock(&cv->waiters, threadPtrToToken(cv), m, CV_NO_TIMEOUT);
+}
+
+bool condvarWaitTimeout(CondVar* cv, Mutex* m, u32 timeout_ticks)
+{
+	return _condvarBlock(&cv->waiters, threadPtrToToken(cv), m, timeout_ticks) != 0;
+}
+
+void _condvarCompatSignal(u32 cv)
+{
+	threadUnblockOneByValue(&s_cvWaitQueue, cv);
+}
+
+void _condvarCompatBroadcast(u32 cv)
+{
+	threadUnblockAllByValue(&s_cvWaitQueue, cv);
+}
+
+bool _condvarCompatWait(u32 cv, Mutex* m, u32 timeout_ticks)
+{
+	return _condvarBlock(&s_cvWaitQueue, cv, m, timeout_ticks) != 0;
+}
+
+bool _condvarCompatWaitAddrLock(u32 cv, vu32* lock, u32 timeout_ticks)
+{
 	ArmIrqState st = armIrqLockByPsr();
 
-	if_unlikely (m->owner != self) {
-		for (;;); // ERROR
+	// Any thread woken up by the release is picked up by threadBlock below.
+	// Rescheduling right away could cause a signal sent before we block to be lost.
+	_threadAddrLockReleaseLocked(lock);
+
+	u32 rc;
+	if_likely (timeout_ticks == CV_NO_TIMEOUT) {
+		rc = threadBlock(&s_cvWaitQueue, cv);
+	} else {
+		rc = threadBlockTimeout(&s_cvWaitQueue, cv, timeout_ticks);
 	}
 
-	m->owner = threadRemoveWaiter(self, (u32)m);
-	threadBlock(&s_cvWaitQueue, (u32)cv);
-	mutexLock(m);
 	armIrqUnlockByPsr(st);
+	_threadAddrLockAcquire(lock);
+	return rc != 0;
 }
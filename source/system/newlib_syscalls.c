@@ -2,33 +2,48 @@
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
 #include <calico/types.h>
 #include <calico/system/mutex.h>
-#include <calico/system/condvar.h>
 #include <calico/system/thread.h>
+#include <calico/system/tick.h>
 #include <errno.h>
 #include <malloc.h>
+#include <time.h>
 #include <sys/iosupport.h>
+#include "thread-priv.h"
 
 #if defined(__NDS__)
 #include "../nds/transfer.h"
 
-MK_INLINE time_t _getUnixTime(void)
+// Returns the current time since the epoch, in units of TICK_HIRES_FREQ
+static u64 _getRealTime(void)
 {
-	return s_transferRegion->unix_time;
+	static u64 s_rtcOffset;
+
+	u64 now = tickHiresGetCount();
+	u64 rtc = (u64)s_transferRegion->unix_time * TICK_HIRES_FREQ;
+
+	// The RTC only has a resolution of one second, so the sub-second part is taken from
+	// the high resolution clock. The offset between both is moved forward whenever the RTC
+	// is seen ticking past our estimate, and resynchronized if the RTC was changed.
+	ArmIrqState st = armIrqLockByPsr();
+	u64 t = now + s_rtcOffset;
+	if (t < rtc || t >= rtc + 2*TICK_HIRES_FREQ) {
+		s_rtcOffset = rtc - now;
+		t = rtc;
+	}
+	armIrqUnlockByPsr(st);
+
+	return t;
 }
 
 #else
 
-MK_INLINE time_t _getUnixTime(void)
+MK_INLINE u64 _getRealTime(void)
 {
 	return 0;
 }
 
 #endif
 
-struct __pthread_t {
-	Thread base;
-};
-
 // Dummy symbol referenced by crt0 so that this object file is pulled in by the linker
 const u32 __newlib_syscalls = 0xdeadbeef;
 
@@ -47,8 +62,9 @@ int* __errno(void)
 int __SYSCALL(gettod_r)(struct _reent* ptr, struct timeval* tp, struct timezone* tz)
 {
 	if (tp) {
-		tp->tv_sec = _getUnixTime();
-		tp->tv_usec = 0;
+		u64 t = _getRealTime();
+		tp->tv_sec = t / TICK_HIRES_FREQ;
+		tp->tv_usec = (u32)(t % TICK_HIRES_FREQ) * 1000000ULL / TICK_HIRES_FREQ;
 	}
 
 	if (tz) {
@@ -59,6 +75,28 @@ int __SYSCALL(gettod_r)(struct _reent* ptr, struct timeval* tp, struct timezone*
 	return 0;
 }
 
+int __SYSCALL(clock_gettime)(clockid_t clock_id, struct timespec* tp)
+{
+	u64 t;
+	switch (clock_id) {
+		case CLOCK_REALTIME:
+			t = _getRealTime();
+			break;
+
+		case CLOCK_MONOTONIC:
+			t = tickHiresGetCount();
+			break;
+
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+
+	tp->tv_sec = t / TICK_HIRES_FREQ;
+	tp->tv_nsec = (u32)(t % TICK_HIRES_FREQ) * 1000000000ULL / TICK_HIRES_FREQ;
+	return 0;
+}
+
 MK_CODE32 int __SYSCALL(nanosleep)(const struct timespec* req, struct timespec* rem)
 {
 	threadSleep((unsigned)req->tv_sec*1000000U + (unsigned)req->tv_nsec/1000U);
@@ -72,17 +110,17 @@ void __SYSCALL(lock_init)(_LOCK_T* lock)
 
 void __SYSCALL(lock_acquire)(_LOCK_T* lock)
 {
-	mutexLock((Mutex*)lock);
+	_threadAddrLockAcquire((vu32*)lock);
 }
 
 int __SYSCALL(lock_try_acquire)(_LOCK_T* lock)
 {
-	return mutexTryLock((Mutex*)lock) ? 0 : 1;
+	return _threadAddrLockTryAcquire((vu32*)lock) ? 0 : 1;
 }
 
 void __SYSCALL(lock_release)(_LOCK_T* lock)
 {
-	mutexUnlock((Mutex*)lock);
+	_threadAddrLockRelease((vu32*)lock);
 }
 
 void __SYSCALL(lock_init_recursive)(_LOCK_RECURSIVE_T* lock)
@@ -105,42 +143,65 @@ void __SYSCALL(lock_release_recursive)(_LOCK_RECURSIVE_T* lock)
 	rmutexUnlock((RMutex*)lock);
 }
 
+// _COND_T is too small to hold a CondVar, so the compatibility mode is used instead
+
 int __SYSCALL(cond_signal)(_COND_T* cond)
 {
-	condvarSignal((CondVar*)cond);
+	_condvarCompatSignal((u32)cond);
 	return 0;
 }
 
 int __SYSCALL(cond_broadcast)(_COND_T* cond)
 {
-	condvarBroadcast((CondVar*)cond);
+	_condvarCompatBroadcast((u32)cond);
 	return 0;
 }
 
-int __SYSCALL(cond_wait)(_COND_T* cond, _LOCK_T* lock, uint64_t timeout_ns)
+// Either a Mutex (recursive locks) or a lock word (non-recursive locks) is passed
+static bool _condWaitTicks(_COND_T* cond, Mutex* m, vu32* lock, u32 timeout_ticks)
 {
-	if (timeout_ns != UINT64_MAX) {
-		return ETIMEDOUT;
+	if (m) {
+		return _condvarCompatWait((u32)cond, m, timeout_ticks);
+	} else {
+		return _condvarCompatWaitAddrLock((u32)cond, lock, timeout_ticks);
 	}
-
-	condvarWait((CondVar*)cond, (Mutex*)lock);
-	return 0;
 }
 
-int __SYSCALL(cond_wait_recursive)(_COND_T* cond, _LOCK_RECURSIVE_T* lock, uint64_t timeout_ns)
+static int _condWaitImpl(_COND_T* cond, Mutex* m, vu32* lock, uint64_t timeout_ns)
 {
-	if (timeout_ns != UINT64_MAX) {
-		return ETIMEDOUT;
+	if (timeout_ns == UINT64_MAX) {
+		_condWaitTicks(cond, m, lock, UINT32_MAX);
+		return 0;
 	}
 
+	// Timeouts beyond what the tick scheduler can represent are turned into
+	// spurious wakeups, which are allowed by condition variable semantics
+	static const u64 max_ns = (u64)TICK_MAX_DELAY * 1000000000U / TICK_FREQ;
+	if (timeout_ns >= max_ns) {
+		_condWaitTicks(cond, m, lock, TICK_MAX_DELAY);
+		return 0;
+	}
+
+	// Round up so that we never wake up earlier than requested
+	u32 timeout_ticks = (timeout_ns * TICK_FREQ + 999999999U) / 1000000000U;
+	return _condWaitTicks(cond, m, lock, timeout_ticks) ? 0 : ETIMEDOUT;
+}
+
+int __SYSCALL(cond_wait)(_COND_T* cond, _LOCK_T* lock, uint64_t timeout_ns)
+{
+	return _condWaitImpl(cond, NULL, (vu32*)lock, timeout_ns);
+}
+
+int __SYSCALL(cond_wait_recursive)(_COND_T* cond, _LOCK_RECURSIVE_T* lock, uint64_t timeout_ns)
+{
 	RMutex* r = (RMutex*)lock;
 	u32 counter_backup = r->counter;
 	r->counter = 0;
 
-	condvarWait((CondVar*)cond, &r->mutex);
+	int rc = _condWaitImpl(cond, &r->mutex, NULL, timeout_ns);
 
 	r->counter = counter_backup;
-	return 0;
+	return rc;
 }
 
 int __SYSCALL(thread_create)(struct __pthread_t** thread, void* (*func)(void*), void* arg, void* stack_addr, size_t stack_size)
@@ -156,24 +217,32 @@ int __SYSCALL(thread_create)(struct __pthread_t** thread, void* (*func)(void*),
 	size_t struct_sz = (sizeof(struct __pthread_t) + 7) &~ 7;
 
 	size_t needed_sz = struct_sz + threadGetLocalStorageSize();
+	PthreadPoolClass* cls = NULL;
 	if (!stack_addr) {
+		// Try to use a preallocated slot first, falling back to the heap
+		cls = _pthreadPoolAlloc(stack_size, thread);
+		if (cls) {
+			stack_size = cls->stack_size;
+		}
 		needed_sz += stack_size;
 	}
 
-	*thread = _malloc_r(__SYSCALL(getreent)(), needed_sz); // malloc align is 2*sizeof(void*); which is already 8
-	if (!*thread) {
-		return ENOMEM;
+	if (!cls) {
+		*thread = _malloc_r(__SYSCALL(getreent)(), needed_sz); // malloc align is 2*sizeof(void*); which is already 8
+		if (!*thread) {
+			return ENOMEM;
+		}
 	}
 
-	void* stack_top;
-	if (stack_addr) {
-		stack_top = (u8*)stack_addr + stack_size;
-	} else {
-		stack_top = (u8*)*thread + needed_sz;
+	(*thread)->pool = cls;
+
+	void* stack = stack_addr;
+	if (!stack) {
+		stack = (u8*)*thread + needed_sz - stack_size;
 	}
 
 	Thread* t = &(*thread)->base;
-	threadPrepare(t, (ThreadFunc)func, arg, stack_top, THREAD_MIN_PRIO);
+	threadPrepareWithStack(t, (ThreadFunc)func, arg, stack, stack_size, THREAD_MIN_PRIO);
 	threadAttachLocalStorage(t, (u8*)*thread + struct_sz);
 	threadStart(t);
 
@@ -183,7 +252,11 @@ int __SYSCALL(thread_create)(struct __pthread_t** thread, void* (*func)(void*),
 void* __SYSCALL(thread_join)(struct __pthread_t* thread)
 {
 	void* rc = (void*)threadJoin(&thread->base);
-	_free_r(__SYSCALL(getreent)(), thread);
+	if (thread->pool) {
+		_pthreadPoolFree(thread->pool, thread);
+	} else {
+		_free_r(__SYSCALL(getreent)(), thread);
+	}
 	return rc;
 }
 
@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/rwlock.h>
+#include "thread-priv.h"
+
+// Shared wait queue for locks that have no holder able to inherit priority
+// (i.e. locks only held by readers that are not tracked, see _rwlockAddReader)
+static ThrListNode s_rwWaitQueue;
+
+MK_INLINE bool _rwlockIsWriteHeld(RwLock* l)
+{
+	return l->owner && !l->readers;
+}
+
+MK_INLINE bool _rwlockCanRead(RwLock* l, Thread* self)
+{
+	// Waiting writers take precedence over new readers, but not over threads
+	// that already hold the lock for reading (otherwise they would deadlock)
+	return !_rwlockIsWriteHeld(l) && (!l->wwait || self->rwlock == l);
+}
+
+static void _rwlockAddReader(RwLock* l, Thread* t)
+{
+	l->readers ++;
+
+	if_likely (!t->rwlock) {
+		// Track the thread as a holder, so that it can inherit priority from waiters
+		t->rwlock = l;
+		t->rwcount = 1;
+		t->rwnext = l->rdlist;
+		l->rdlist = t;
+		if (!l->owner) {
+			l->owner = t;
+		}
+	} else if (t->rwlock == l) {
+		t->rwcount ++;
+	}
+}
+
+static void _rwlockRemoveReader(RwLock* l, Thread* t)
+{
+	l->readers --;
+
+	if_likely (t->rwlock == l && !--t->rwcount) {
+		Thread** pp = &l->rdlist;
+		while (*pp != t) {
+			pp = &(*pp)->rwnext;
+		}
+		*pp = t->rwnext;
+		t->rwlock = NULL;
+
+		// Pick another tracked reader to inherit priority from waiters
+		if (l->owner == t) {
+			l->owner = l->rdlist;
+		}
+	}
+}
+
+static void _rwlockMoveWaiters(RwLock* l, ThrListNode* from, Thread* to)
+{
+	ThrListNode* queue = to ? &to->waiters : &s_rwWaitQueue;
+	Thread* next;
+	for (Thread* cur = from->next; cur; cur = next) {
+		next = cur->link.next;
+		if (threadGetRwLockFromToken(cur->token) == l) {
+			threadLinkDequeue(from, cur);
+			cur->status = to ? ThrStatus_WaitingOnRwLock : ThrStatus_Waiting;
+			threadLinkEnqueue(queue, cur);
+		}
+	}
+}
+
+static Thread* _rwlockWake(RwLock* l, Thread* holder)
+{
+	// Gather all waiters in the shared queue, sorted by priority
+	if (holder) {
+		_rwlockMoveWaiters(l, &holder->waiters, NULL);
+	}
+
+	// Grant the lock to waiters in priority order: readers are let in until
+	// a writer is found, which is only let in if the lock is not held at all
+	Thread* resched = NULL;
+	Thread* next;
+	for (Thread* cur = s_rwWaitQueue.next; cur; cur = next) {
+		next = cur->link.next;
+		if (threadGetRwLockFromToken(cur->token) != l) {
+			continue;
+		}
+
+		bool is_reader = cur->token & THR_RWLOCK_READ;
+		if (is_reader) {
+			if (_rwlockIsWriteHeld(l)) {
+				break;
+			}
+			_rwlockAddReader(l, cur);
+		} else {
+			if (l->owner || l->readers) {
+				break;
+			}
+			l->owner = cur;
+			l->wwait --;
+		}
+
+		threadLinkDequeue(&s_rwWaitQueue, cur);
+		cur->token = 1;
+		if_likely (!cur->pause) {
+			cur->status = ThrStatus_Running;
+			threadEnqueue(cur);
+			if (!resched) {
+				resched = cur; // Remember the first unblocked (highest priority) thread
+			}
+		} else {
+			cur->status = ThrStatus_Waiting;
+		}
+
+		if (!is_reader) {
+			break;
+		}
+	}
+
+	// Remaining waiters boost the (possibly new) holder of the lock
+	if (l->owner) {
+		_rwlockMoveWaiters(l, &s_rwWaitQueue, l->owner);
+	}
+
+	// Update dynamic priorities for both threads if needed
+	if (holder) {
+		threadUpdateDynamicPrio(holder);
+	}
+	if (l->owner && l->owner != holder) {
+		threadUpdateDynamicPrio(l->owner);
+	}
+
+	return resched;
+}
+
+static void _rwlockBlock(RwLock* l, Thread* self, u32 token, ArmIrqState st)
+{
+	threadDequeue(self);
+	self->token = token;
+
+	Thread* next = NULL;
+	Thread* holder = l->owner;
+	if_likely (holder) {
+		// Add current thread to holder thread's list of waiters
+		self->status = ThrStatus_WaitingOnRwLock;
+		threadLinkEnqueue(&holder->waiters, self);
+
+		// Bump dynamic priority of holder thread if needed
+		if_unlikely (self->prio < holder->prio) {
+			threadUpdateDynamicPrio(holder);
+
+			// Fast path when the holder thread is runnable
+			if_likely (holder->status == ThrStatus_Running) {
+				next = holder;
+			}
+		}
+	} else {
+		self->status = ThrStatus_Waiting;
+		threadLinkEnqueue(&s_rwWaitQueue, self);
+	}
+
+	// Select next thread to run if above code didn't
+	if_likely (!next) {
+		next = threadFindRunnable();
+	}
+
+	threadSwitchTo(next, st);
+}
+
+static void _rwlockTimeoutTask(TickTask* task)
+{
+	ThrTimeout* to = (ThrTimeout*)task;
+	Thread* t = to->thread;
+	RwLock* l = (RwLock*)to->obj;
+	ArmIrqState st = armIrqLockByPsr();
+
+	// Do nothing if the thread already acquired the lock
+	if (!t->queue || threadGetRwLockFromToken(t->token) != l) {
+		armIrqUnlockByPsr(st);
+		return;
+	}
+
+	// Remove the thread from the queue it is waiting on
+	Thread* resched = NULL;
+	bool is_writer = !(t->token & THR_RWLOCK_READ);
+	threadLinkDequeue(t->queue, t);
+	t->token = 0;
+	if_likely (!t->pause) {
+		t->status = ThrStatus_Running;
+		threadEnqueue(t);
+		resched = t;
+	} else {
+		t->status = ThrStatus_Waiting;
+	}
+
+	if (is_writer) {
+		l->wwait --;
+	}
+
+	if (is_writer && !_rwlockIsWriteHeld(l)) {
+		// Readers held back by this writer may be able to proceed now
+		Thread* woken = _rwlockWake(l, l->owner);
+		if (woken && (!resched || woken->prio < resched->prio)) {
+			resched = woken;
+		}
+	} else if (l->owner) {
+		// Drop the priority the holder thread may have inherited from us
+		threadUpdateDynamicPrio(l->owner);
+	}
+
+	threadReschedule(resched, st);
+}
+
+static void _rwlockReleaseCommon(Thread* self, unsigned old_prio, Thread* resched, ArmIrqState st)
+{
+	Thread* next = self;
+	if_unlikely (old_prio < self->prio) {
+		next = threadFindRunnable();
+	} else if_unlikely (resched && resched->prio < self->prio) {
+		next = resched;
+	}
+
+	if_unlikely (next != self)
+		threadSwitchTo(next, st);
+	else
+		armIrqUnlockByPsr(st);
+}
+
+bool rwlockTryReadLock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+	bool rc = _rwlockCanRead(l, self);
+
+	if_likely (rc) {
+		_rwlockAddReader(l, self);
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+void rwlockReadLock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_likely (_rwlockCanRead(l, self)) {
+		// Fast path: success
+		_rwlockAddReader(l, self);
+		armIrqUnlockByPsr(st);
+	} else {
+		_rwlockBlock(l, self, threadPtrToToken(l) | THR_RWLOCK_READ, st);
+	}
+}
+
+bool rwlockReadLockTimeout(RwLock* l, u32 timeout_ticks)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = true;
+	if_likely (_rwlockCanRead(l, self)) {
+		// Fast path: success
+		_rwlockAddReader(l, self);
+	} else {
+		ThrTimeout to;
+		threadTimeoutStart(&to, _rwlockTimeoutTask, l, timeout_ticks);
+		_rwlockBlock(l, self, threadPtrToToken(l) | THR_RWLOCK_READ, armIrqLockByPsr());
+		threadTimeoutStop(&to);
+		rc = self->token != 0;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+void rwlockReadUnlock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (!l->readers) {
+		for (;;); // ERROR
+	}
+
+	unsigned old_prio = self->prio;
+	Thread* holder = l->owner;
+	_rwlockRemoveReader(l, self);
+
+	// Hand over waiters if the lock was released or its tracked holder changed
+	Thread* resched = NULL;
+	if (!l->readers || l->owner != holder) {
+		resched = _rwlockWake(l, holder);
+	}
+
+	_rwlockReleaseCommon(self, old_prio, resched, st);
+}
+
+bool rwlockTryWriteLock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+	bool rc = !l->owner && !l->readers;
+
+	if_likely (rc) {
+		l->owner = self;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+void rwlockWriteLock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_likely (!l->owner && !l->readers) {
+		// Fast path: success
+		l->owner = self;
+		armIrqUnlockByPsr(st);
+	} else {
+		l->wwait ++;
+		_rwlockBlock(l, self, threadPtrToToken(l), st);
+	}
+}
+
+bool rwlockWriteLockTimeout(RwLock* l, u32 timeout_ticks)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = true;
+	if_likely (!l->owner && !l->readers) {
+		// Fast path: success
+		l->owner = self;
+	} else {
+		ThrTimeout to;
+		l->wwait ++;
+		threadTimeoutStart(&to, _rwlockTimeoutTask, l, timeout_ticks);
+		_rwlockBlock(l, self, threadPtrToToken(l), armIrqLockByPsr());
+		threadTimeoutStop(&to);
+		rc = self->token != 0;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+void rwlockWriteUnlock(RwLock* l)
+{
+	Thread* self = threadGetSelf();
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (l->owner != self || l->readers) {
+		for (;;); // ERROR
+	}
+
+	unsigned old_prio = self->prio;
+	l->owner = NULL;
+	Thread* resched = _rwlockWake(l, self);
+
+	_rwlockReleaseCommon(self, old_prio, resched, st);
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/semaphore.h>
+#include "thread-priv.h"
+
+void semaphoreSignal(Semaphore* s)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_likely (!s->waiters.next) {
+		s->count ++;
+	} else {
+		// Hand the unit directly to the highest priority waiter
+		threadUnblockOneByValue(&s->waiters, threadPtrToToken(s));
+	}
+
+	armIrqUnlockByPsr(st);
+}
+
+bool semaphoreTryWait(Semaphore* s)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = s->count != 0;
+	if_likely (rc) {
+		s->count --;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+void semaphoreWait(Semaphore* s)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_likely (s->count) {
+		s->count --;
+	} else {
+		threadBlock(&s->waiters, threadPtrToToken(s));
+	}
+
+	armIrqUnlockByPsr(st);
+}
+
+bool semaphoreWaitTimeout(Semaphore* s, u32 timeout_ticks)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = true;
+	if_likely (s->count) {
+		s->count --;
+	} else {
+		rc = threadBlockTimeout(&s->waiters, threadPtrToToken(s), timeout_ticks) != 0;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <string.h>
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include <calico/system/spscring.h>
+
+// The head and tail positions are free-running counters, masked on access.
+// The producer only ever writes head, and the consumer only ever writes tail.
+
+static void _spscRingCopyIn(SpscRing* r, u32 pos, const void* data, size_t size)
+{
+	u32 off = pos & (r->size - 1);
+	size_t first = r->size - off;
+	if (first > size) {
+		first = size;
+	}
+
+	memcpy(&r->buf[off], data, first);
+	memcpy(r->buf, (const u8*)data + first, size - first);
+}
+
+static void _spscRingCopyOut(SpscRing* r, u32 pos, void* out, size_t size)
+{
+	u32 off = pos & (r->size - 1);
+	size_t first = r->size - off;
+	if (first > size) {
+		first = size;
+	}
+
+	memcpy(out, &r->buf[off], first);
+	memcpy((u8*)out + first, r->buf, size - first);
+}
+
+static void _spscRingCommitWrite(SpscRing* r, u32 head)
+{
+	// Publish the data before the new head position
+	armCompilerBarrier();
+	r->head = head;
+
+	// Wake up the consumer if it is blocked. It sets the flag before rechecking
+	// the head position atomically, so the wakeup cannot be missed.
+	if_unlikely (r->waiting) {
+		threadWakeAddress(&r->head, 1);
+	}
+}
+
+static void _spscRingCommitRead(SpscRing* r, u32 tail)
+{
+	// Finish reading the data before releasing its space
+	armCompilerBarrier();
+	r->tail = tail;
+}
+
+static void _spscRingWaitUsed(SpscRing* r, size_t size)
+{
+	for (;;) {
+		u32 head = r->head;
+		if_likely (head - r->tail >= size) {
+			break;
+		}
+
+		r->waiting = 1;
+		threadWaitOnAddress(&r->head, head);
+	}
+
+	r->waiting = 0;
+	armCompilerBarrier();
+}
+
+size_t spscRingWrite(SpscRing* r, const void* data, size_t size)
+{
+	u32 head = r->head;
+	size_t avail = r->size - (head - r->tail);
+	if (size > avail) {
+		size = avail;
+	}
+
+	if_likely (size) {
+		_spscRingCopyIn(r, head, data, size);
+		_spscRingCommitWrite(r, head + size);
+	}
+
+	return size;
+}
+
+size_t spscRingRead(SpscRing* r, void* out, size_t size)
+{
+	u32 tail = r->tail;
+	size_t used = r->head - tail;
+	armCompilerBarrier();
+	if (size > used) {
+		size = used;
+	}
+
+	if_likely (size) {
+		_spscRingCopyOut(r, tail, out, size);
+		_spscRingCommitRead(r, tail + size);
+	}
+
+	return size;
+}
+
+size_t spscRingReadWait(SpscRing* r, void* out, size_t size)
+{
+	if_unlikely (!size) {
+		return 0;
+	}
+
+	_spscRingWaitUsed(r, 1);
+	return spscRingRead(r, out, size);
+}
+
+bool spscRingPush(SpscRing* r, const void* rec, size_t size)
+{
+	u32 head = r->head;
+	if_unlikely (r->size - (head - r->tail) < size) {
+		return false;
+	}
+
+	_spscRingCopyIn(r, head, rec, size);
+	_spscRingCommitWrite(r, head + size);
+	return true;
+}
+
+bool spscRingPop(SpscRing* r, void* rec, size_t size)
+{
+	u32 tail = r->tail;
+	if_unlikely (r->head - tail < size) {
+		return false;
+	}
+
+	armCompilerBarrier();
+	_spscRingCopyOut(r, tail, rec, size);
+	_spscRingCommitRead(r, tail + size);
+	return true;
+}
+
+void spscRingPopWait(SpscRing* r, void* rec, size_t size)
+{
+	_spscRingWaitUsed(r, size);
+	spscRingPop(r, rec, size);
+}
@@ -6,18 +6,27 @@
 #include <calico/arm/common.h>
 #include <calico/system/irq.h>
 #include <calico/system/thread.h>
+#include <calico/system/mutex.h>
+#include <calico/system/rwlock.h>
+#include <calico/system/waitany.h>
+#include "trace-priv.h"
+
+#if defined(__NDS__)
+#include <calico/nds/mm.h>
+#endif
 
 extern ThrSchedState __sched_state;
 
 #define s_curThread __sched_state.cur
 #define s_deferredThread __sched_state.deferred
-#define s_firstThread __sched_state.first
 #define s_irqWaitMask __sched_state.irqWaitMask
 #define s_irqWaitList __sched_state.irqWaitList
 #if MK_IRQ_NUM_HANDLERS > 32
 #define s_irqWaitMask2 __sched_state.irqWaitMask2
 #define s_irqWaitList2 __sched_state.irqWaitList2
 #endif
+#define s_readyMask __sched_state.readyMask
+#define s_readyQueue __sched_state.readyQueue
 
 typedef enum ThrUnblockMode {
 	ThrUnblockMode_Any,
@@ -25,53 +34,50 @@ typedef enum ThrUnblockMode {
 	ThrUnblockMode_ByMask,
 } ThrUnblockMode;
 
-MK_INLINE Thread* threadGetInsertPosition(Thread* t)
-{
-	Thread* pos = NULL;
-	for (Thread* cur = s_firstThread; cur && cur->prio <= t->prio; cur = cur->next)
-		pos = cur;
-	return pos;
-}
-
-MK_INLINE Thread* threadGetPrevious(Thread* t)
+MK_INLINE u32 threadPrioGetReadyBit(unsigned prio)
 {
-	for (Thread* cur = s_firstThread; cur; cur = cur->next) {
-		if (cur->next == t) {
-			return cur;
-		}
-	}
-	return NULL;
+	return 0x80000000U >> (prio & 0x1f);
 }
 
 MK_INLINE void threadEnqueue(Thread* t)
 {
-	Thread* pos = threadGetInsertPosition(t);
-	if (pos) {
-		t->next = pos->next;
-		pos->next = t;
+	// Append the thread to the tail of its priority band
+	unsigned prio = t->prio;
+	ThrListNode* band = &s_readyQueue[prio];
+	t->sched.next = NULL;
+	t->sched.prev = band->prev;
+	if (band->prev) {
+		band->prev->sched.next = t;
 	} else {
-		t->next = s_firstThread;
-		s_firstThread = t;
+		band->next = t;
+		s_readyMask[prio >> 5] |= threadPrioGetReadyBit(prio);
 	}
+	band->prev = t;
 }
 
 MK_INLINE void threadDequeue(Thread* t)
 {
-	if (s_firstThread == t) {
-		s_firstThread = t->next;
-	} else {
-		Thread* prev = threadGetPrevious(t);
-		if (prev) {
-			prev->next = t->next;
-		}
+	unsigned prio = t->prio;
+	ThrListNode* band = &s_readyQueue[prio];
+	(t->sched.prev ? &t->sched.prev->sched : band)->next = t->sched.next;
+	(t->sched.next ? &t->sched.next->sched : band)->prev = t->sched.prev;
+	if (!band->next) {
+		s_readyMask[prio >> 5] &= ~threadPrioGetReadyBit(prio);
 	}
 }
 
-MK_INLINE Thread* threadFindRunnable(Thread* first)
+MK_INLINE Thread* threadFindRunnable(void)
 {
-	Thread* t;
-	for (t = first; t && t->status != ThrStatus_Running; t = t->next);
-	return t;
+	// The idle thread lives in an extra band past THREAD_MIN_PRIO without a bit
+	unsigned prio;
+	if_likely (s_readyMask[0]) {
+		prio = __builtin_clz(s_readyMask[0]);
+	} else if_likely (s_readyMask[1]) {
+		prio = 0x20 + __builtin_clz(s_readyMask[1]);
+	} else {
+		prio = THREAD_MIN_PRIO+1;
+	}
+	return s_readyQueue[prio].next;
 }
 
 MK_INLINE Thread* threadLinkGetInsertPosition(ThrListNode* queue, Thread* t)
@@ -122,8 +128,150 @@ MK_INLINE bool threadTestUnblock(Thread* t, ThrUnblockMode mode, u32 ref)
 	}
 }
 
+#if defined(__CALICO_HOST__)
+void _hostSimBadAddress(const volatile void* p) MK_NORETURN;
+#endif
+
+// Tokens that identify objects hold their address, which must fit in 32 bits
+MK_INLINE u32 threadPtrToToken(const volatile void* p)
+{
+#if defined(__CALICO_HOST__)
+	if_unlikely ((uptr)p != (u32)(uptr)p) {
+		_hostSimBadAddress(p);
+	}
+#endif
+	return (u32)(uptr)p;
+}
+
+MK_INLINE void* threadTokenToPtr(u32 token)
+{
+	return (void*)(uptr)token;
+}
+
+// Threads waiting on a RwLock use the lowest bit of the token to tell readers apart
+#define THR_RWLOCK_READ 1
+
+MK_INLINE RwLock* threadGetRwLockFromToken(u32 token)
+{
+	return (RwLock*)threadTokenToPtr(token &~ THR_RWLOCK_READ);
+}
+
+typedef struct ThrWaitAny {
+	struct ThrWaitAny* next;
+	Thread* thread;
+	ThrWaitObj* objs;
+	unsigned num_objs;
+	u32 timers_fired;
+} ThrWaitAny;
+
+extern ThrWaitAny* __wait_any_list;
+
+void _threadWaitAnyNotify(ThrWaitType type, const void* obj);
+
+MK_INLINE void threadWaitAnyNotify(ThrWaitType type, const void* obj)
+{
+	if_unlikely (__wait_any_list) {
+		_threadWaitAnyNotify(type, obj);
+	}
+}
+
+typedef struct ThrTimeout {
+	TickTask task;
+	Thread* thread;
+	void* obj;
+} ThrTimeout;
+
+MK_INLINE void threadTimeoutStart(ThrTimeout* to, TickTaskFn fn, void* obj, u32 timeout_ticks)
+{
+	to->thread = s_curThread;
+	to->obj = obj;
+	tickTaskStart(&to->task, fn, timeout_ticks, 0);
+}
+
+MK_INLINE void threadTimeoutStop(ThrTimeout* to)
+{
+	tickTaskStop(&to->task);
+}
+
+#if defined(CALICO_THREAD_STATS)
+
+// The IRQ dispatcher accesses the first three fields directly
+typedef struct ThrStatsState {
+	u32 irq_start;        // Low 16 bits of the tick counter on handler entry
+	u32 irq_count;
+	u64 irq_ticks;
+	u64 switch_tick;      // Tick counter when the current thread was switched in
+	u64 switch_irq_ticks; // irq_ticks when the current thread was switched in
+	u32 switches;
+} ThrStatsState;
+
+extern ThrStatsState __sched_stats;
+
+MK_EXTERN32 void _threadStatsSwitch(Thread* prev, Thread* next, bool voluntary);
+
+#else
+
+MK_INLINE void _threadStatsSwitch(Thread* prev, Thread* next, bool voluntary)
+{
+}
+
+#endif
+
+#if defined(CALICO_STACK_CHECK)
+
+// Pattern used to fill unused thread stack memory
+#define THR_STACK_PAINT 0xa5a5a5a5
+
+// Number of words at the bottom of the stack checked on context switch
+#define THR_STACK_CANARY_WORDS 2
+
+// Encoding of the undefined instruction used to report stack overflows ("udf #0x5354")
+#define THR_STACK_OVERFLOW_UDF 0xe7f535f4
+
+MK_INLINE bool threadStackHasGuard(Thread* t)
+{
+#if __ARM_ARCH >= 5 && !defined(__CALICO_HOST__)
+	// MPU region 4 (DTCM) takes precedence over the guard region, so don't bother
+	if (((uptr)t->stack - MM_DTCM) < MM_DTCM_SZ) {
+		return false;
+	}
+
+	return ((uptr)t->stack & (THREAD_STACK_GUARD_SZ-1)) == 0 && t->stack_size >= 2*THREAD_STACK_GUARD_SZ;
+#else
+	return false;
+#endif
+}
+
+// Returns the lowest stack address usable by the thread (excluding the guard region)
+MK_INLINE u32* threadStackGetBottom(Thread* t)
+{
+	return (u32*)((u8*)t->stack + (threadStackHasGuard(t) ? THREAD_STACK_GUARD_SZ : 0));
+}
+
+MK_EXTERN32 void _threadStackSwitch(Thread* prev, Thread* next);
+
+#else
+
+MK_INLINE void _threadStackSwitch(Thread* prev, Thread* next)
+{
+}
+
+#endif
+
+// Called by the IRQ dispatcher when performing a deferred context switch
+MK_EXTERN32 void _threadIrqSwitchHook(Thread* prev, Thread* next);
+
 MK_EXTERN32 void threadSwitchTo(Thread* t, ArmIrqState st);
 
+// Unblocks at most max threads (or all if negative) in the queue matching the
+// specified ref value, without rescheduling. Must be called with IRQs disabled.
+// Returns the highest priority thread that became runnable, if any.
+MK_EXTERN32 Thread* threadUnblockByValueLocked(ThrListNode* queue, int max, u32 ref);
+
+// Same as threadBlockCancel, but without rescheduling. Must be called with IRQs
+// disabled. Returns the thread if it became runnable.
+MK_EXTERN32 Thread* threadBlockCancelLocked(ThrListNode* queue, Thread* t);
+
 MK_INLINE void threadReschedule(Thread* t, ArmIrqState st)
 {
 	if (t && t->prio < s_curThread->prio) {
@@ -134,3 +282,50 @@ MK_INLINE void threadReschedule(Thread* t, ArmIrqState st)
 }
 
 void threadUpdateDynamicPrio(Thread* t);
+
+// Releases the timeslice quantum of an exiting thread. Only threads that were given a
+// quantum call this, so the reference is weak and does not pull in the timeslicing code.
+void _threadSliceExit(Thread* t) MK_WEAK;
+
+// Compatibility mode for condition variables whose storage is too small to hold
+// a CondVar object (such as newlib's _COND_T): waiters are kept in a shared
+// queue and identified by the address of the object. Passing UINT32_MAX as the
+// timeout waits forever.
+void _condvarCompatSignal(u32 cv);
+void _condvarCompatBroadcast(u32 cv);
+bool _condvarCompatWait(u32 cv, Mutex* m, u32 timeout_ticks);
+bool _condvarCompatWaitAddrLock(u32 cv, vu32* lock, u32 timeout_ticks);
+
+// Lightweight lock built on top of address waits (used by newlib's _LOCK_T).
+// The lock is a single zero-initialized word, and the uncontended paths only
+// perform a single atomic swap without disabling interrupts. Unlike Mutex,
+// it does not implement priority inheritance.
+void _threadAddrLockAcquire(vu32* lock);
+bool _threadAddrLockTryAcquire(vu32* lock);
+void _threadAddrLockRelease(vu32* lock);
+
+// Releases the lock without rescheduling. Must be called with IRQs disabled.
+// Returns the highest priority thread that became runnable, if any.
+Thread* _threadAddrLockReleaseLocked(vu32* lock);
+
+// POSIX thread object, followed by its thread local storage and (unless
+// user supplied) its stack. Pooled threads remember the class they came from.
+struct __pthread_t {
+	Thread base;
+	struct PthreadPoolClass* pool;
+};
+
+typedef struct PthreadPoolSlot {
+	struct PthreadPoolSlot* next;
+} PthreadPoolSlot;
+
+typedef struct PthreadPoolClass {
+	PthreadPoolSlot* free_list;
+	size_t stack_size;
+} PthreadPoolClass;
+
+// Takes a slot from the smallest pool class fitting the stack size. Returns NULL if none is free.
+PthreadPoolClass* _pthreadPoolAlloc(size_t stack_size, struct __pthread_t** out);
+
+// Returns a slot to the pool class it was allocated from.
+void _pthreadPoolFree(PthreadPoolClass* cls, struct __pthread_t* thread);
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include "thread-priv.h"
+
+#define THR_ADDR_NUM_QUEUES 16
+
+// States of the lock word used by _threadAddrLock*
+#define THR_ADDR_LOCK_FREE      0
+#define THR_ADDR_LOCK_HELD      1
+#define THR_ADDR_LOCK_CONTENDED 2
+
+static ThrListNode s_addrWaitQueues[THR_ADDR_NUM_QUEUES];
+
+MK_INLINE ThrListNode* _threadAddrGetQueue(volatile u32* addr)
+{
+	u32 key = (uptr)addr >> 2;
+	return &s_addrWaitQueues[(key ^ (key >> 4)) & (THR_ADDR_NUM_QUEUES-1)];
+}
+
+bool threadWaitOnAddress(volatile u32* addr, u32 expected)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	bool rc = *addr == expected;
+	if_likely (rc) {
+		threadBlock(_threadAddrGetQueue(addr), threadPtrToToken(addr));
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
+MK_INLINE Thread* _threadWakeAddressLocked(volatile u32* addr, u32 count)
+{
+	int max = count > INT32_MAX ? -1 : (int)count;
+	return threadUnblockByValueLocked(_threadAddrGetQueue(addr), max, threadPtrToToken(addr));
+}
+
+void threadWakeAddress(volatile u32* addr, u32 count)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	threadReschedule(_threadWakeAddressLocked(addr, count), st);
+}
+
+void _threadAddrLockAcquire(vu32* lock)
+{
+	// Fast path: the lock was free
+	if_likely (armSwapWord(THR_ADDR_LOCK_HELD, (u32*)lock) == THR_ADDR_LOCK_FREE) {
+		return;
+	}
+
+	// Mark the lock as contended so that the holder wakes us up on release
+	while (armSwapWord(THR_ADDR_LOCK_CONTENDED, (u32*)lock) != THR_ADDR_LOCK_FREE) {
+		threadWaitOnAddress(lock, THR_ADDR_LOCK_CONTENDED);
+	}
+}
+
+bool _threadAddrLockTryAcquire(vu32* lock)
+{
+	u32 old = armSwapWord(THR_ADDR_LOCK_HELD, (u32*)lock);
+
+	// Restore the contended state if we overwrote it. If the holder released the
+	// lock in the meantime it did not wake anyone up, and we become the holder.
+	if_unlikely (old == THR_ADDR_LOCK_CONTENDED) {
+		old = armSwapWord(THR_ADDR_LOCK_CONTENDED, (u32*)lock);
+	}
+
+	return old == THR_ADDR_LOCK_FREE;
+}
+
+void _threadAddrLockRelease(vu32* lock)
+{
+	if_unlikely (armSwapWord(THR_ADDR_LOCK_FREE, (u32*)lock) == THR_ADDR_LOCK_CONTENDED) {
+		threadWakeAddress(lock, 1);
+	}
+}
+
+Thread* _threadAddrLockReleaseLocked(vu32* lock)
+{
+	Thread* t = NULL;
+	if_unlikely (armSwapWord(THR_ADDR_LOCK_FREE, (u32*)lock) == THR_ADDR_LOCK_CONTENDED) {
+		t = _threadWakeAddressLocked(lock, 1);
+	}
+	return t;
+}
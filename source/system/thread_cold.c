@@ -13,7 +13,9 @@ typedef struct TlsInfo {
 
 extern TlsInfo __tls_info MK_WEAK;
 
-#if defined(__GBA__) || (defined(__NDS__) && defined(ARM7))
+#if defined(__CALICO_HOST__)
+int _hostIdleThread(void* arg);
+#elif defined(__GBA__) || (defined(__NDS__) && defined(ARM7))
 void svcHalt(void);
 
 //static alignas(8) u32 s_idleThreadStack[6];
@@ -36,24 +38,28 @@ MK_INLINE void* _threadGetMainTp(void)
 
 static void _threadTickTask(TickTask* task)
 {
-	threadUnblockAllByValue(&s_sleepThreads, (u32)task);
+	threadUnblockAllByValue(&s_sleepThreads, threadPtrToToken(task));
+	threadWaitAnyNotify(ThrWaitType_Timer, task);
 }
 
 void _threadInit(void)
 {
 	// Set up main thread (which is also the current one)
-	s_firstThread          = &s_mainThread;
 	s_curThread            = &s_mainThread;
 	s_mainThread.tp        = _threadGetMainTp();
+#if !defined(__CALICO_HOST__)
 	s_mainThread.impure    = &_impure_data;
-	s_mainThread.next      = &s_idleThread;
+#endif
 	s_mainThread.status    = ThrStatus_Running;
 	s_mainThread.prio      = MAIN_THREAD_PRIO;
 	s_mainThread.baseprio  = s_mainThread.prio;
+	threadEnqueue(&s_mainThread);
 
 	// Set up idle thread
 	s_idleThread.ctx.psr   = ARM_PSR_MODE_SYS;
-#if __ARM_ARCH >= 5
+#if defined(__CALICO_HOST__)
+	s_idleThread.ctx.r[15] = (uptr)_hostIdleThread;
+#elif __ARM_ARCH >= 5
 	s_idleThread.ctx.r[15] = (u32)armWaitForIrq;
 	s_idleThread.ctx.r[14] = s_idleThread.ctx.r[15];
 #elif defined(__GBA__) || defined(__NDS__)
@@ -70,17 +76,26 @@ void _threadInit(void)
 	s_idleThread.status    = ThrStatus_Running;
 	s_idleThread.prio      = THREAD_MIN_PRIO+1;
 	s_idleThread.baseprio  = s_idleThread.prio;
+
+	// The idle thread permanently occupies the last band, which has no ready bit
+	s_readyQueue[s_idleThread.prio].next = &s_idleThread;
+	s_readyQueue[s_idleThread.prio].prev = &s_idleThread;
+
+#if defined(CALICO_THREAD_STATS)
+	// CPU usage accounting relies on the tick counter
+	tickInit();
+#endif
 }
 
 void threadPrepare(Thread* t, ThreadFunc entrypoint, void* arg, void* stack_top, u8 prio)
 {
 	// Initialize thread state and context
 	memset(t, 0, sizeof(Thread));
-	t->ctx.r[0]   = (u32)arg;
-	t->ctx.sp_svc = (u32)stack_top &~ 7;
+	t->ctx.r[0]   = (uptr)arg;
+	t->ctx.sp_svc = (uptr)stack_top &~ 7;
 	t->ctx.r[13]  = t->ctx.sp_svc - 0x10;
-	t->ctx.r[14]  = (u32)threadExit;
-	t->ctx.r[15]  = (u32)entrypoint;
+	t->ctx.r[14]  = (uptr)threadExit;
+	t->ctx.r[15]  = (uptr)entrypoint;
 	t->ctx.psr    = ARM_PSR_MODE_SYS;
 	t->tp         = s_mainThread.tp;
 	t->impure     = s_mainThread.impure;
@@ -94,11 +109,20 @@ void threadPrepare(Thread* t, ThreadFunc entrypoint, void* arg, void* stack_top,
 		t->ctx.r[15] &= ~1;
 		t->ctx.psr   |= ARM_PSR_T;
 	}
+}
 
-	// Insert into thread list
-	ArmIrqState st = armIrqLockByPsr();
-	threadEnqueue(t);
-	armIrqUnlockByPsr(st);
+void threadPrepareWithStack(Thread* t, ThreadFunc entrypoint, void* arg, void* stack, size_t stack_size, u8 prio)
+{
+	threadPrepare(t, entrypoint, arg, (u8*)stack + stack_size, prio);
+
+#if defined(CALICO_STACK_CHECK)
+	t->stack      = stack;
+	t->stack_size = stack_size;
+
+	// Paint the stack so that its usage can be measured later
+	u32* bottom = threadStackGetBottom(t);
+	armFillMem32(bottom, THR_STACK_PAINT, t->ctx.sp_svc - (uptr)bottom);
+#endif
 }
 
 size_t threadGetLocalStorageSize(void)
@@ -107,9 +131,11 @@ size_t threadGetLocalStorageSize(void)
 	if (&__tls_info) {
 		needed_sz += __tls_info.total_sz;
 	}
+#if !defined(__CALICO_HOST__)
 	if (&_impure_data) {
 		needed_sz += sizeof(struct _reent);
 	}
+#endif
 	return (needed_sz + 7) &~ 7;
 }
 
@@ -141,6 +167,7 @@ void threadAttachLocalStorage(Thread* t, void* storage)
 		}
 	}
 
+#if !defined(__CALICO_HOST__)
 	// Handle impure data if present
 	if (&_impure_data) {
 		// Attach reent struct to thread
@@ -159,6 +186,7 @@ void threadAttachLocalStorage(Thread* t, void* storage)
 		r->_stdout = _stdout;
 		r->_stderr = _stderr;
 	}
+#endif
 }
 
 void threadStart(Thread* t)
@@ -172,6 +200,7 @@ void threadStart(Thread* t)
 
 	if (!t->queue) {
 		t->status = ThrStatus_Running;
+		threadEnqueue(t);
 		threadReschedule(t, st);
 	} else {
 		armIrqUnlockByPsr(st);
@@ -189,11 +218,12 @@ void threadPause(Thread* t)
 		return;
 	}
 
+	threadDequeue(t);
 	t->status = ThrStatus_Waiting;
 	t->queue = NULL;
 
 	if (self == t) {
-		Thread* next = threadFindRunnable(s_firstThread);
+		Thread* next = threadFindRunnable();
 		threadSwitchTo(next, st);
 	} else {
 		armIrqUnlockByPsr(st);
@@ -212,7 +242,7 @@ void threadSetPrio(Thread* t, u8 prio)
 	Thread* next = NULL;
 	if (t == self) {
 		if (self->prio > curprio) {
-			next = threadFindRunnable(s_firstThread);
+			next = threadFindRunnable();
 		}
 	} else if (t->status == ThrStatus_Running) {
 		next = t;
@@ -227,7 +257,7 @@ int threadJoin(Thread* t)
 
 	// Block on thread if it's not already finished
 	if (t->status >= ThrStatus_Running)
-		threadBlock(&s_joinThreads, (u32)t);
+		threadBlock(&s_joinThreads, threadPtrToToken(t));
 
 	int rc = t->rc;
 
@@ -235,15 +265,33 @@ int threadJoin(Thread* t)
 	return rc;
 }
 
+bool threadJoinTimeout(Thread* t, int* out_rc, u32 timeout_ticks)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	// Block on thread if it's not already finished
+	bool rc = true;
+	if (t->status >= ThrStatus_Running)
+		rc = threadBlockTimeout(&s_joinThreads, threadPtrToToken(t), timeout_ticks) != 0;
+
+	if (rc && out_rc) {
+		*out_rc = t->rc;
+	}
+
+	armIrqUnlockByPsr(st);
+	return rc;
+}
+
 void threadYield(void)
 {
 	Thread* self = s_curThread;
 	ArmIrqState st = armIrqLockByPsr();
 
-	Thread* t = threadFindRunnable(self->next);
-	if (t->prio > self->prio)
-		t = threadFindRunnable(s_firstThread);
+	// Move the current thread to the tail of its priority band
+	threadDequeue(self);
+	threadEnqueue(self);
 
+	Thread* t = threadFindRunnable();
 	if (t != self)
 		threadSwitchTo(t, st);
 	else
@@ -292,24 +340,47 @@ void threadExit(int rc)
 	armIrqLockByPsr();
 
 	threadDequeue(self);
+	if_unlikely (self->quantum) {
+		_threadSliceExit(self);
+	}
 	self->status = ThrStatus_Finished;
 	self->prio = THREAD_MAX_PRIO; // avoid preemption in threadUnblock
 	self->rc = rc;
-	threadUnblockAllByValue(&s_joinThreads, (u32)self);
+	threadUnblockAllByValue(&s_joinThreads, threadPtrToToken(self));
 
-	s_curThread = threadFindRunnable(s_firstThread);
+	s_curThread = threadFindRunnable();
+	_threadStatsSwitch(self, s_curThread, true);
+	_traceRecord(TraceEvent_Switch, 0, (u32)(uptr)self, (u32)(uptr)s_curThread);
+	_threadStackSwitch(self, s_curThread);
 	armContextLoad(&s_curThread->ctx);
 }
 
 void threadSleepTicks(u32 ticks)
 {
-	TickTask task;
+	// The thread itself serves as the token, since periodic timers (which wake up
+	// this same queue) use the address of their TickTask instead
 	ArmIrqState st = armIrqLockByPsr();
-	tickTaskStart(&task, _threadTickTask, ticks, 0);
-	threadBlock(&s_sleepThreads, (u32)&task);
+	threadBlockTimeout(&s_sleepThreads, threadPtrToToken(s_curThread), ticks);
 	armIrqUnlockByPsr(st);
 }
 
+static void _threadBlockTimeoutTask(TickTask* task)
+{
+	ThrTimeout* to = (ThrTimeout*)task;
+	threadBlockCancel((ThrListNode*)to->obj, to->thread);
+}
+
+u32 threadBlockTimeout(ThrListNode* queue, u32 token, u32 timeout_ticks)
+{
+	ThrTimeout to;
+	ArmIrqState st = armIrqLockByPsr();
+	threadTimeoutStart(&to, _threadBlockTimeoutTask, queue, timeout_ticks);
+	u32 ret = threadBlock(queue, token);
+	threadTimeoutStop(&to);
+	armIrqUnlockByPsr(st);
+	return ret;
+}
+
 void threadTimerStartTicks(TickTask* task, u32 period_ticks)
 {
 	tickTaskStart(task, _threadTickTask, period_ticks, period_ticks);
@@ -318,6 +389,70 @@ void threadTimerStartTicks(TickTask* task, u32 period_ticks)
 void threadTimerWait(TickTask* task)
 {
 	ArmIrqState st = armIrqLockByPsr();
-	threadBlock(&s_sleepThreads, (u32)task);
+	threadBlock(&s_sleepThreads, threadPtrToToken(task));
+	armIrqUnlockByPsr(st);
+}
+
+bool threadGetStats(Thread* t, ThrStats* out)
+{
+#if defined(CALICO_THREAD_STATS)
+	ArmIrqState st = armIrqLockByPsr();
+
+	*out = t->stats;
+
+	// Include the time slice of the currently running thread
+	if (t == s_curThread) {
+		u64 elapsed = tickGetCount() - __sched_stats.switch_tick;
+		u64 irq_elapsed = __sched_stats.irq_ticks - __sched_stats.switch_irq_ticks;
+		if (elapsed > irq_elapsed) {
+			out->run_ticks += elapsed - irq_elapsed;
+		}
+	}
+
+	armIrqUnlockByPsr(st);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool schedGetStats(SchedStats* out)
+{
+#if defined(CALICO_THREAD_STATS)
+	ThrStats idle;
+	threadGetStats(&s_idleThread, &idle);
+
+	ArmIrqState st = armIrqLockByPsr();
+	out->uptime_ticks = tickGetCount();
+	out->idle_ticks   = idle.run_ticks;
+	out->irq_ticks    = __sched_stats.irq_ticks;
+	out->irq_count    = __sched_stats.irq_count;
+	out->switches     = __sched_stats.switches;
 	armIrqUnlockByPsr(st);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool threadGetStackUsage(Thread* t, ThrStackUsage* out)
+{
+#if defined(CALICO_STACK_CHECK)
+	if (!t->stack) {
+		return false;
+	}
+
+	// Find the lowest word that no longer contains the paint pattern
+	u32* bottom = threadStackGetBottom(t);
+	u32* top = (u32*)((u8*)t->stack + t->stack_size);
+	u32* pos;
+	for (pos = bottom; pos < top && *pos == THR_STACK_PAINT; pos ++);
+
+	out->size = (u8*)top - (u8*)bottom;
+	out->peak = (u8*)top - (u8*)pos;
+	return true;
+#else
+	return false;
+#endif
 }
@@ -1,19 +1,108 @@
 // SPDX-License-Identifier: ZPL-2.1
 // SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/arm/cp15.h>
 #include "thread-priv.h"
 
 ThrSchedState __sched_state;
 IrqHandler __irq_table[MK_IRQ_NUM_HANDLERS];
 
+#if defined(CALICO_THREAD_STATS)
+
+ThrStatsState __sched_stats;
+
+void _threadStatsSwitch(Thread* prev, Thread* next, bool voluntary)
+{
+	u64 now = tickGetCount();
+	u64 irq_ticks = __sched_stats.irq_ticks;
+
+	// Charge the elapsed time (minus interrupt handling) to the outgoing thread
+	u64 elapsed = now - __sched_stats.switch_tick;
+	u64 irq_elapsed = irq_ticks - __sched_stats.switch_irq_ticks;
+	if_likely (elapsed > irq_elapsed) {
+		prev->stats.run_ticks += elapsed - irq_elapsed;
+	}
+
+	if (voluntary) {
+		prev->stats.voluntary ++;
+	} else {
+		prev->stats.involuntary ++;
+	}
+
+	next->stats.switches ++;
+	__sched_stats.switches ++;
+	__sched_stats.switch_tick = now;
+	__sched_stats.switch_irq_ticks = irq_ticks;
+}
+
+#endif
+
+#if defined(CALICO_STACK_CHECK)
+
+MK_NOINLINE MK_NORETURN static void _threadStackOverflow(Thread* t)
+{
+#if defined(__CALICO_HOST__)
+	(void)t;
+	__builtin_trap();
+#else
+	// Raise an Undefined Instruction exception so that the overflow is reported
+	// by the registered exception handler, with r0 pointing to the offending thread
+	register Thread* r0 __asm__("r0") = t;
+	__asm__ __volatile__ (".inst %c1" :: "r" (r0), "i" (THR_STACK_OVERFLOW_UDF) : "memory");
+	for (;;);
+#endif
+}
+
+void _threadStackSwitch(Thread* prev, Thread* next)
+{
+	// Verify that the outgoing thread did not overflow its stack
+	if (prev->stack) {
+		u32* bottom = threadStackGetBottom(prev);
+		for (unsigned i = 0; i < THR_STACK_CANARY_WORDS; i ++) {
+			if_unlikely (bottom[i] != THR_STACK_PAINT) {
+				_threadStackOverflow(prev);
+			}
+		}
+	}
+
+#if __ARM_ARCH >= 5 && !defined(__CALICO_HOST__)
+	// Move the MPU guard region (region 3, no access) to the incoming thread
+	u32 region = 0;
+	if (threadStackHasGuard(next)) {
+		region = (uptr)next->stack | CP15_PU_4K | CP15_PU_ENABLE;
+	}
+	__asm__ __volatile__ ("mcr p15, 0, %0, c6, c3, 0" :: "r" (region) : "memory");
+#endif
+}
+
+#endif
+
+#if defined(CALICO_THREAD_STATS) || defined(CALICO_TRACE) || defined(CALICO_STACK_CHECK)
+
+void _threadIrqSwitchHook(Thread* prev, Thread* next)
+{
+	_threadStatsSwitch(prev, next, false);
+	_traceRecord(TraceEvent_Switch, 0, (u32)(uptr)prev, (u32)(uptr)next);
+	_threadStackSwitch(prev, next);
+}
+
+#endif
+
 void threadSwitchTo(Thread* t, ArmIrqState st)
 {
-	if_likely ((armGetCpsr() & ARM_PSR_MODE_MASK) == ARM_PSR_MODE_IRQ) {
+	// Preemptible ISRs run in system mode, but must defer context switches too
+	if_likely ((armGetCpsr() & ARM_PSR_MODE_MASK) == ARM_PSR_MODE_IRQ || __irq_nest_depth) {
 		if (!s_deferredThread || t->prio < s_deferredThread->prio)
 			s_deferredThread = t;
 		armIrqUnlockByPsr(st);
 		return;
 	}
 
+	// Switching to a thread of equal or lower priority means we gave up the CPU
+	Thread* self = s_curThread;
+	_threadStatsSwitch(self, t, self->status != ThrStatus_Running || t->prio >= self->prio);
+	_traceRecord(TraceEvent_Switch, 0, (u32)(uptr)self, (u32)(uptr)t);
+	_threadStackSwitch(self, t);
+
 	if (!armContextSave(&s_curThread->ctx, st, 1)) {
 		s_curThread = t;
 		armContextLoad(&t->ctx);
@@ -25,19 +114,20 @@ u32 threadBlock(ThrListNode* queue, u32 token)
 	Thread* self = s_curThread;
 	ArmIrqState st = armIrqLockByPsr();
 
+	threadDequeue(self);
 	self->status = ThrStatus_Waiting;
 	self->token = token;
 	threadLinkEnqueue(queue, self);
+	_traceRecord(TraceEvent_Block, 0, (u32)(uptr)queue, token);
 
-	Thread* next = threadFindRunnable(s_firstThread);
+	Thread* next = threadFindRunnable();
 	threadSwitchTo(next, st);
 
 	return self->token;
 }
 
-MK_INLINE void _threadUnblockCommon(ThrListNode* queue, int max, ThrUnblockMode mode, u32 ref)
+MK_INLINE Thread* _threadUnblockLocked(ThrListNode* queue, int max, ThrUnblockMode mode, u32 ref)
 {
-	ArmIrqState st = armIrqLockByPsr();
 	Thread* resched = NULL;
 	Thread* next;
 
@@ -55,8 +145,11 @@ MK_INLINE void _threadUnblockCommon(ThrListNode* queue, int max, ThrUnblockMode
 			cur->token = 1;
 		}
 
+		_traceRecord(TraceEvent_Unblock, 0, (u32)(uptr)cur, cur->token);
+
 		if (!cur->pause) {
 			cur->status = ThrStatus_Running;
+			threadEnqueue(cur);
 			if (!resched) {
 				resched = cur; // Remember the first unblocked (highest priority) thread
 			}
@@ -67,7 +160,18 @@ MK_INLINE void _threadUnblockCommon(ThrListNode* queue, int max, ThrUnblockMode
 		}
 	}
 
-	threadReschedule(resched, st);
+	return resched;
+}
+
+MK_INLINE void _threadUnblockCommon(ThrListNode* queue, int max, ThrUnblockMode mode, u32 ref)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	threadReschedule(_threadUnblockLocked(queue, max, mode, ref), st);
+}
+
+Thread* threadUnblockByValueLocked(ThrListNode* queue, int max, u32 ref)
+{
+	return _threadUnblockLocked(queue, max, ThrUnblockMode_ByValue, ref);
 }
 
 void threadUnblockOneByValue(ThrListNode* queue, u32 ref)
@@ -90,24 +194,28 @@ void threadUnblockAllByMask(ThrListNode* queue, u32 ref)
 	_threadUnblockCommon(queue, -1, ThrUnblockMode_ByMask, ref);
 }
 
-void threadBlockCancel(ThrListNode* queue, Thread* t)
+Thread* threadBlockCancelLocked(ThrListNode* queue, Thread* t)
 {
-	ArmIrqState st = armIrqLockByPsr();
-	Thread* resched = NULL;
-
 	if (t->status != ThrStatus_Waiting || t->queue != queue) {
-		armIrqUnlockByPsr(st);
-		return;
+		return NULL;
 	}
 
 	threadLinkDequeue(queue, t);
 
 	t->token = 0;
+	_traceRecord(TraceEvent_Unblock, 0, (u32)(uptr)t, 0);
 
-	if (!t->pause) {
-		t->status = ThrStatus_Running;
-		resched = t;
+	if (t->pause) {
+		return NULL;
 	}
 
-	threadReschedule(resched, st);
+	t->status = ThrStatus_Running;
+	threadEnqueue(t);
+	return t;
+}
+
+void threadBlockCancel(ThrListNode* queue, Thread* t)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	threadReschedule(threadBlockCancelLocked(queue, t), st);
 }
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/thread.h>
+#include "thread-priv.h"
+
+static PthreadPoolClass s_pthreadPool[PTHREAD_POOL_MAX_CLASSES];
+static u8 s_pthreadPoolOrder[PTHREAD_POOL_MAX_CLASSES]; // Class indices sorted by stack size
+static unsigned s_pthreadPoolNumClasses;
+
+size_t pthreadPoolGetSlotSize(size_t stack_size)
+{
+	size_t struct_sz = (sizeof(struct __pthread_t) + 7) &~ 7;
+	return struct_sz + threadGetLocalStorageSize() + stack_size;
+}
+
+bool pthreadPoolAddClass(void* mem, size_t num_slots, size_t stack_size)
+{
+	if (((uptr)mem & 7) || (stack_size & 7)) {
+		return false;
+	}
+
+	ArmIrqState st = armIrqLockByPsr();
+
+	if_unlikely (s_pthreadPoolNumClasses >= PTHREAD_POOL_MAX_CLASSES) {
+		armIrqUnlockByPsr(st);
+		return false;
+	}
+
+	// Threads allocated from a class keep a pointer to it, so classes never move.
+	// Instead, their indices are kept sorted by stack size, so that the smallest
+	// fitting class is found first.
+	unsigned id = s_pthreadPoolNumClasses++;
+	unsigned pos = id;
+	for (; pos > 0 && s_pthreadPool[s_pthreadPoolOrder[pos-1]].stack_size > stack_size; pos --) {
+		s_pthreadPoolOrder[pos] = s_pthreadPoolOrder[pos-1];
+	}
+	s_pthreadPoolOrder[pos] = id;
+
+	PthreadPoolClass* cls = &s_pthreadPool[id];
+	cls->free_list = NULL;
+	cls->stack_size = stack_size;
+
+	size_t slot_sz = pthreadPoolGetSlotSize(stack_size);
+	for (size_t i = 0; i < num_slots; i ++) {
+		PthreadPoolSlot* slot = (PthreadPoolSlot*)((u8*)mem + i*slot_sz);
+		slot->next = cls->free_list;
+		cls->free_list = slot;
+	}
+
+	armIrqUnlockByPsr(st);
+	return true;
+}
+
+PthreadPoolClass* _pthreadPoolAlloc(size_t stack_size, struct __pthread_t** out)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	PthreadPoolClass* cls = NULL;
+	for (unsigned i = 0; i < s_pthreadPoolNumClasses; i ++) {
+		PthreadPoolClass* cur = &s_pthreadPool[s_pthreadPoolOrder[i]];
+		if (cur->stack_size >= stack_size && cur->free_list) {
+			cls = cur;
+			*out = (struct __pthread_t*)cur->free_list;
+			cur->free_list = cur->free_list->next;
+			break;
+		}
+	}
+
+	armIrqUnlockByPsr(st);
+	return cls;
+}
+
+void _pthreadPoolFree(PthreadPoolClass* cls, struct __pthread_t* thread)
+{
+	ArmIrqState st = armIrqLockByPsr();
+
+	PthreadPoolSlot* slot = (PthreadPoolSlot*)thread;
+	slot->next = cls->free_list;
+	cls->free_list = slot;
+
+	armIrqUnlockByPsr(st);
+}
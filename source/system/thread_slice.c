@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include "thread-priv.h"
+
+// Timeslicing is implemented as a self-rearming TickTask that checks on the
+// current thread. A thread is only moved to the back of its priority band if it
+// was already the current thread when its quantum started; threads that block
+// and resume within the same quantum are not tracked separately. The task stops
+// rearming itself once no quantum is configured anymore.
+static TickTask s_sliceTask;
+static Thread* s_sliceOwner;
+static bool s_sliceActive;
+static u32 s_sliceRecheck;
+static u32 s_prioQuantum[THREAD_MIN_PRIO+1];
+
+// Threads with their own quantum, and the shortest such quantum. The latter is
+// only reset once no thread has a quantum left: a stale (shorter) value merely
+// makes the task check more often than needed.
+static unsigned s_sliceThreads;
+static u32 s_sliceThreadMin;
+
+MK_INLINE u32 _threadGetQuantum(Thread* t)
+{
+	if (t->quantum) {
+		return t->quantum;
+	}
+
+	return t->prio <= THREAD_MIN_PRIO ? s_prioQuantum[t->prio] : 0;
+}
+
+static void _threadSliceTask(TickTask* task)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	Thread* self = s_curThread;
+	u32 quantum = _threadGetQuantum(self);
+
+	if (self == s_sliceOwner && quantum && self->status == ThrStatus_Running && (self->sched.next || self->sched.prev)) {
+		// Quantum expired and there are other threads in the band: rotate
+		threadDequeue(self);
+		threadEnqueue(self);
+		self = threadFindRunnable();
+		quantum = _threadGetQuantum(self);
+		threadSwitchTo(self, st);
+		st = armIrqLockByPsr();
+	}
+
+	// Threads without a quantum are checked again at the shortest configured interval
+	if (!quantum) {
+		quantum = s_sliceRecheck;
+	}
+
+	s_sliceOwner = self;
+	s_sliceActive = quantum != 0;
+	if (quantum) {
+		tickTaskStart(task, _threadSliceTask, quantum, 0);
+	}
+
+	armIrqUnlockByPsr(st);
+}
+
+static void _threadSliceUpdate(void)
+{
+	u32 recheck = s_sliceThreads ? s_sliceThreadMin : 0;
+	for (unsigned i = 0; i <= THREAD_MIN_PRIO; i ++) {
+		u32 quantum = s_prioQuantum[i];
+		if (quantum && (!recheck || quantum < recheck)) {
+			recheck = quantum;
+		}
+	}
+
+	s_sliceRecheck = recheck;
+	if (!recheck) {
+		// Nothing left to slice
+		if (s_sliceActive) {
+			s_sliceActive = false;
+			tickTaskStop(&s_sliceTask);
+		}
+	} else if (!s_sliceActive) {
+		s_sliceActive = true;
+		s_sliceOwner = s_curThread;
+		tickTaskStart(&s_sliceTask, _threadSliceTask, recheck, 0);
+	}
+}
+
+static void _threadSliceSetThreadQuantum(Thread* t, u32 quantum_ticks)
+{
+	if (t->quantum) {
+		s_sliceThreads --;
+	}
+
+	t->quantum = quantum_ticks;
+	if (quantum_ticks) {
+		if (!s_sliceThreads++ || quantum_ticks < s_sliceThreadMin) {
+			s_sliceThreadMin = quantum_ticks;
+		}
+	}
+
+	if (!s_sliceThreads) {
+		s_sliceThreadMin = 0;
+	}
+}
+
+void threadSetPrioQuantum(u8 prio, u32 quantum_ticks)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	s_prioQuantum[prio & THREAD_MIN_PRIO] = quantum_ticks;
+	_threadSliceUpdate();
+	armIrqUnlockByPsr(st);
+}
+
+void threadSetQuantum(Thread* t, u32 quantum_ticks)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	_threadSliceSetThreadQuantum(t, quantum_ticks);
+	_threadSliceUpdate();
+	armIrqUnlockByPsr(st);
+}
+
+void _threadSliceExit(Thread* t)
+{
+	_threadSliceSetThreadQuantum(t, 0);
+	_threadSliceUpdate();
+}
@@ -4,61 +4,195 @@
 #include <calico/system/irq.h>
 #include <calico/system/tick.h>
 #include <calico/gba/timer.h>
+#include "trace-priv.h"
+
+// Tasks are kept in a hierarchical timing wheel. Level n has 32 buckets, each
+// covering 32^n ticks, selected by bits [5n, 5n+5) of the target. A task is
+// placed in the lowest level whose range (relative to the wheel clock) covers
+// its target, and buckets above level 0 are cascaded into lower levels when the
+// wheel clock enters them. Tasks beyond the range of the top level are parked
+// in its furthest bucket and cascaded again from there.
+#define TICK_WHEEL_BITS   5
+#define TICK_WHEEL_SLOTS  (1U << TICK_WHEEL_BITS)
+#define TICK_WHEEL_LEVELS 4
+#define TICK_WHEEL_RANGE  (1U << (TICK_WHEEL_BITS*TICK_WHEEL_LEVELS))
 
 static bool s_tickInit;
 static vu64 s_highTickCount;
-static TickTask* s_firstTask;
+static vu32 s_tickSeq; // Incremented every time s_highTickCount is updated
+static bool s_tickHiresInit;
+static vu32 s_tickHiresHigh;
+static u64 s_tickHiresBase;
+static bool s_tickArmed;
+static u32 s_tickArmedTarget;
+static u32 s_tickWheelClk; // Earliest tick not yet processed by the wheel
+static u32 s_tickWheelMask[TICK_WHEEL_LEVELS];
+static TickTask* s_tickWheel[TICK_WHEEL_LEVELS][TICK_WHEEL_SLOTS];
 
 MK_CONSTEXPR bool _tickIsSequential32(u32 lhs, u32 rhs)
 {
 	return (s32)(rhs - lhs) > 0;
 }
 
-MK_INLINE TickTask* _tickTaskGetInsertPosition(TickTask* t)
+MK_INLINE bool _tickWheelIsEmpty(void)
 {
-	TickTask* pos = NULL;
-	for (TickTask* cur = s_firstTask; cur && _tickIsSequential32(cur->target, t->target); cur = cur->next)
-		pos = cur;
-	return pos;
+	u32 mask = 0;
+	for (unsigned i = 0; i < TICK_WHEEL_LEVELS; i ++) {
+		mask |= s_tickWheelMask[i];
+	}
+	return mask == 0;
+}
+
+MK_INLINE void _tickListInsert(TickTask** head, TickTask* t)
+{
+	t->next = *head;
+	t->pprev = head;
+	if (t->next) {
+		t->next->pprev = &t->next;
+	}
+	*head = t;
+}
+
+static u32 _tickWheelInsert(TickTask* t)
+{
+	// Late tasks are processed as soon as possible
+	u32 target = t->target;
+	u32 delta = target - s_tickWheelClk;
+	if_unlikely ((s32)delta < 0) {
+		target = s_tickWheelClk;
+		delta = 0;
+	}
+
+	// Park far away tasks in the top level
+	if_unlikely (delta >= TICK_WHEEL_RANGE) {
+		target = s_tickWheelClk + TICK_WHEEL_RANGE - 1;
+		delta = TICK_WHEEL_RANGE - 1;
+	}
+
+	unsigned level = 0;
+	while (delta >= (1U << (TICK_WHEEL_BITS*(level+1)))) {
+		level ++;
+	}
+
+	unsigned shift = TICK_WHEEL_BITS*level;
+	unsigned slot = (target >> shift) & (TICK_WHEEL_SLOTS-1);
+	_tickListInsert(&s_tickWheel[level][slot], t);
+	s_tickWheelMask[level] |= 1U << slot;
+
+	// Return the time at which the bucket will be processed
+	return (target >> shift) << shift;
 }
 
-MK_INLINE TickTask* _tickTaskGetPrevious(TickTask* t)
+static void _tickWheelRemove(TickTask* t)
 {
-	TickTask* pos = NULL;
-	for (TickTask* cur = s_firstTask; cur && cur != t; cur = cur->next)
-		pos = cur;
-	return pos;
+	TickTask** pprev = t->pprev;
+	*pprev = t->next;
+	if (t->next) {
+		t->next->pprev = pprev;
+	}
+	t->pprev = NULL;
+
+	// Clear the bucket bit if the task was the last one in it
+	uptr off = (uptr)pprev - (uptr)&s_tickWheel[0][0];
+	if (off < sizeof(s_tickWheel) && !*pprev) {
+		unsigned idx = off / sizeof(TickTask*);
+		s_tickWheelMask[idx / TICK_WHEEL_SLOTS] &= ~(1U << (idx % TICK_WHEEL_SLOTS));
+	}
 }
 
-MK_INLINE void _tickTaskEnqueue(TickTask* t)
+static bool _tickWheelNextEvent(u32* out)
 {
-	TickTask* pos = _tickTaskGetInsertPosition(t);
-	if (pos) {
-		t->next = pos->next;
-		pos->next = t;
-	} else {
-		t->next = s_firstTask;
-		s_firstTask = t;
+	u32 clk = s_tickWheelClk;
+	bool found = false;
+	u32 best = 0;
+
+	for (unsigned level = 0; level < TICK_WHEEL_LEVELS; level ++) {
+		u32 mask = s_tickWheelMask[level];
+		if (!mask) {
+			continue;
+		}
+
+		// Find the first bucket entered at or after the wheel clock
+		unsigned shift = TICK_WHEEL_BITS*level;
+		u32 bucket = (clk >> shift) + ((clk & ((1U << shift) - 1)) != 0);
+		unsigned cur = bucket & (TICK_WHEEL_SLOTS-1);
+		mask = (mask >> cur) | (mask << ((TICK_WHEEL_SLOTS - cur) & (TICK_WHEEL_SLOTS-1)));
+		u32 when = (bucket + __builtin_ctz(mask)) << shift;
+
+		if (!found || (when - clk) < (best - clk)) {
+			found = true;
+			best = when;
+		}
 	}
+
+	*out = best;
+	return found;
 }
 
-MK_INLINE void _tickTaskDequeue(TickTask* t)
+static void _tickWheelAdvance(u32 clk)
 {
-	TickTask* prev = _tickTaskGetPrevious(t);
-	if (prev)
-		prev->next = t->next;
-	else
-		s_firstTask = t->next;
+	s_tickWheelClk = clk;
+
+	// Cascade buckets entered at this tick, starting from the top level
+	for (unsigned level = TICK_WHEEL_LEVELS-1; level > 0; level --) {
+		unsigned shift = TICK_WHEEL_BITS*level;
+		unsigned slot = (clk >> shift) & (TICK_WHEEL_SLOTS-1);
+		if ((clk & ((1U << shift) - 1)) || !(s_tickWheelMask[level] & (1U << slot))) {
+			continue;
+		}
+
+		TickTask* cur = s_tickWheel[level][slot];
+		s_tickWheel[level][slot] = NULL;
+		s_tickWheelMask[level] &= ~(1U << slot);
+
+		while (cur) {
+			TickTask* next = cur->next;
+			_tickWheelInsert(cur);
+			cur = next;
+		}
+	}
+
+	// Detach the expired level 0 bucket, so that tasks started by callbacks
+	// cannot end up being run in this same pass
+	unsigned slot = clk & (TICK_WHEEL_SLOTS-1);
+	TickTask* expired = NULL;
+	if (s_tickWheelMask[0] & (1U << slot)) {
+		expired = s_tickWheel[0][slot];
+		s_tickWheel[0][slot] = NULL;
+		s_tickWheelMask[0] &= ~(1U << slot);
+		expired->pprev = &expired;
+	}
+
+	s_tickWheelClk = clk + 1;
+
+	while (expired) {
+		TickTask* cur = expired;
+		_tickWheelRemove(cur);
+
+		_traceRecord(TraceEvent_TickTask, 0, (u32)(uptr)cur, (u32)(uptr)cur->fn);
+		cur->fn(cur);
+
+		if_unlikely (cur->pprev) {
+			// The callback restarted the task
+		} else if_likely (cur->period != 0 && cur->fn) {
+			cur->target += cur->period;
+			_tickWheelInsert(cur);
+		} else {
+			cur->fn = NULL;
+		}
+	}
 }
 
-static void _tickTaskSchedule(TickTask* t)
+static void _tickTaskSchedule(bool armed, u32 target)
 {
 	REG_TMxCNT_H(3) = 0;
-	if_likely (!t) {
+	s_tickArmed = armed;
+	s_tickArmedTarget = target;
+	if_likely (!armed) {
 		return;
 	}
 
-	s32 diff = t->target - (s32)tickGetCount();
+	s32 diff = target - (s32)tickGetCount();
 	u16 preload = 0;
 	if (diff <= 0) {
 		preload = -1;
@@ -72,26 +206,26 @@ static void _tickTaskSchedule(TickTask* t)
 
 static void _tickCountIsr(void)
 {
+	// This ISR is never preempted (see tickInit), so readers running in other
+	// ISRs never observe an acknowledged overflow that is not yet accounted for
+	s_tickSeq ++;
 	s_highTickCount ++;
 }
 
-static void _tickTaskIsr(void)
+static void _tickHiresIsr(void)
 {
-	while (s_firstTask && !_tickIsSequential32(tickGetCount(), s_firstTask->target)) {
-		TickTask* cur = s_firstTask;
-		s_firstTask = cur->next;
-
-		cur->fn(cur);
+	s_tickHiresHigh ++;
+}
 
-		if_likely (cur->period != 0 && cur->fn) {
-			cur->target += cur->period;
-			_tickTaskEnqueue(cur);
-		} else {
-			cur->fn = NULL;
-		}
+static void _tickTaskIsr(void)
+{
+	u32 next;
+	bool armed;
+	while ((armed = _tickWheelNextEvent(&next)) && !_tickIsSequential32(tickGetCount(), next)) {
+		_tickWheelAdvance(next);
 	}
 
-	_tickTaskSchedule(s_firstTask);
+	_tickTaskSchedule(armed, next);
 }
 
 void tickInit(void)
@@ -113,6 +247,7 @@ void tickInit(void)
 	// Set up ISRs
 	irqSet(IRQ_TIMER2, _tickCountIsr);
 	irqSet(IRQ_TIMER3, _tickTaskIsr);
+	_irqNestPin(IRQ_TIMER2);
 	irqEnable(IRQ_TIMER2 | IRQ_TIMER3);
 
 	s_tickInit = true;
@@ -121,18 +256,72 @@ void tickInit(void)
 
 u64 tickGetCount(void)
 {
-	IrqState st = irqLock();
+	u32 seq;
+	u16 lo;
+	u64 hi;
+
+	// Retry if the counter ISR ran while we were reading
+	do {
+		seq = s_tickSeq;
+		lo = REG_TMxCNT_L(2);
+		hi = s_highTickCount;
+
+		if_unlikely ((REG_IF & IRQ_TIMER2) && !(lo & (1U << 15))) {
+			hi ++;
+		}
+	} while (seq != s_tickSeq);
+
+	return lo | (hi << 16);
+}
 
-	u16 lo = REG_TMxCNT_L(2);
-	u64 hi = s_highTickCount;
+void tickHiresStart(void)
+{
+	IrqState st = irqLock();
+	if_unlikely (!s_tickInit) {
+		tickInit();
+	}
 
-	if_unlikely ((REG_IF & IRQ_TIMER2) && !(lo & (1U << 15))) {
-		hi ++;
+	if_unlikely (s_tickHiresInit) {
+		irqUnlock(st);
+		return;
 	}
 
+	// Initialize timer1 (counting overflows of timer0) and timer0 (counting bus cycles)
+	REG_TMxCNT_H(0) = 0;
+	REG_TMxCNT_H(1) = 0;
+	REG_TMxCNT_L(0) = 0;
+	REG_TMxCNT_L(1) = 0;
+	REG_TMxCNT_H(1) = TIMER_CASCADE | TIMER_ENABLE | TIMER_ENABLE_IRQ;
+
+	irqSet(IRQ_TIMER1, _tickHiresIsr);
+	_irqNestPin(IRQ_TIMER1);
+	irqEnable(IRQ_TIMER1);
+
+	// Align the clock with the tick counter, rounding up so that it never goes back in time
+	s_tickHiresBase = (tickGetCount() + 1) * (TICK_HIRES_FREQ/TICK_FREQ);
+	REG_TMxCNT_H(0) = TIMER_PRESCALER_1 | TIMER_ENABLE;
+
+	s_tickHiresInit = true;
 	irqUnlock(st);
+}
 
-	return lo | (hi << 16);
+u64 tickHiresGetCount(void)
+{
+	if_unlikely (!s_tickHiresInit) {
+		return tickGetCount() * (TICK_HIRES_FREQ/TICK_FREQ);
+	}
+
+	// The high word is updated with a single store, so it doubles as the sequence counter
+	u32 hi, carry;
+	u16 mid, lo;
+	do {
+		hi = s_tickHiresHigh;
+		mid = REG_TMxCNT_L(1);
+		lo = REG_TMxCNT_L(0);
+		carry = (REG_IF & IRQ_TIMER1) && !(mid & (1U << 15));
+	} while (mid != REG_TMxCNT_L(1) || hi != s_tickHiresHigh);
+
+	return s_tickHiresBase + (lo | ((u32)mid << 16) | ((u64)(hi + carry) << 32));
 }
 
 void tickTaskStart(TickTask* t, TickTaskFn fn, u32 delay_ticks, u32 period_ticks)
@@ -143,13 +332,18 @@ void tickTaskStart(TickTask* t, TickTaskFn fn, u32 delay_ticks, u32 period_ticks
 		tickInit();
 	}
 
-	t->target = tickGetCount() + delay_ticks;
+	u32 now = tickGetCount();
+	if (_tickWheelIsEmpty()) {
+		s_tickWheelClk = now;
+	}
+
+	t->target = now + delay_ticks;
 	t->period = period_ticks;
 	t->fn = fn;
-	_tickTaskEnqueue(t);
+	u32 when = _tickWheelInsert(t);
 
-	if (s_firstTask == t) {
-		_tickTaskSchedule(t);
+	if (!s_tickArmed || _tickIsSequential32(when, s_tickArmedTarget)) {
+		_tickTaskSchedule(true, when);
 	}
 
 	irqUnlock(st);
@@ -164,10 +358,9 @@ void tickTaskStop(TickTask* t)
 		return;
 	}
 
-	bool need_resched = s_firstTask == t;
-	_tickTaskDequeue(t);
-	if (need_resched) {
-		_tickTaskSchedule(s_firstTask);
+	// Tasks that are currently running their callback are not linked anywhere
+	if_likely (t->pprev) {
+		_tickWheelRemove(t);
 	}
 
 	t->fn = NULL;
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include <calico/types.h>
+#include <calico/system/trace.h>
+
+#if defined(CALICO_TRACE)
+
+MK_EXTERN32 void _traceRecord(TraceEvent type, unsigned aux, u32 arg0, u32 arg1);
+
+// Called by the IRQ dispatcher around each interrupt handler
+MK_EXTERN32 void _traceIrqEnter(unsigned irq_id);
+MK_EXTERN32 void _traceIrqExit(void);
+
+#else
+
+MK_INLINE void _traceRecord(TraceEvent type, unsigned aux, u32 arg0, u32 arg1)
+{
+}
+
+#endif
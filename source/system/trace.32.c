@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/types.h>
+#include <calico/arm/common.h>
+#include <calico/system/tick.h>
+#include "trace-priv.h"
+
+#if defined(CALICO_TRACE)
+
+// Entries are claimed by incrementing the head index with interrupts disabled,
+// which is enough to serialize writers on a single core. Only the increment is
+// done in the critical section: the timestamp is read beforehand and the entry
+// is filled in afterwards, marked as in progress until its type is written.
+#define TRACE_ENTRY_BUSY 0xffff
+
+static TraceEntry s_traceRing[TRACE_NUM_ENTRIES];
+static u32 s_traceHead, s_traceTail;
+
+void _traceRecord(TraceEvent type, unsigned aux, u32 arg0, u32 arg1)
+{
+	u32 timestamp = tickGetCount();
+
+	ArmIrqState st = armIrqLockByPsr();
+	TraceEntry* e = &s_traceRing[s_traceHead++ & (TRACE_NUM_ENTRIES-1)];
+	e->type = TRACE_ENTRY_BUSY;
+	armIrqUnlockByPsr(st);
+
+	e->timestamp = timestamp;
+	e->aux       = aux;
+	e->arg0      = arg0;
+	e->arg1      = arg1;
+	armCompilerBarrier();
+	e->type      = type;
+}
+
+size_t traceSnapshot(void* buf, size_t size)
+{
+	if (size < sizeof(TraceHeader)) {
+		return 0;
+	}
+
+	ArmIrqState st = armIrqLockByPsr();
+
+	u32 head = s_traceHead;
+	u32 count = head - s_traceTail;
+	if (count > TRACE_NUM_ENTRIES) {
+		count = TRACE_NUM_ENTRIES;
+	}
+
+	u32 max_count = (size - sizeof(TraceHeader)) / sizeof(TraceEntry);
+	if (count > max_count) {
+		count = max_count;
+	}
+
+	TraceHeader* hdr = (TraceHeader*)buf;
+	hdr->magic       = TRACE_MAGIC;
+	hdr->version     = TRACE_VERSION;
+	hdr->entry_sz    = sizeof(TraceEntry);
+	hdr->tick_freq   = TICK_FREQ;
+
+	// Skip entries whose writer was preempted by us before filling them in
+	TraceEntry* out = (TraceEntry*)(hdr + 1);
+	for (u32 i = head - count; i != head; i ++) {
+		TraceEntry* e = &s_traceRing[i & (TRACE_NUM_ENTRIES-1)];
+		if_likely (e->type != TRACE_ENTRY_BUSY) {
+			*out++ = *e;
+		}
+	}
+
+	count = out - (TraceEntry*)(hdr + 1);
+	hdr->num_entries = count;
+
+	armIrqUnlockByPsr(st);
+	return sizeof(TraceHeader) + count*sizeof(TraceEntry);
+}
+
+void traceClear(void)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	s_traceTail = s_traceHead;
+	armIrqUnlockByPsr(st);
+}
+
+void _traceIrqEnter(unsigned irq_id)
+{
+	_traceRecord(TraceEvent_IrqEnter, irq_id, 0, 0);
+}
+
+void _traceIrqExit(void)
+{
+	_traceRecord(TraceEvent_IrqExit, 0, 0, 0);
+}
+
+#else
+
+size_t traceSnapshot(void* buf, size_t size)
+{
+	return 0;
+}
+
+void traceClear(void)
+{
+}
+
+#endif
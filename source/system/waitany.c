@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include "thread-priv.h"
+
+// Threads blocked in threadWaitAny sit on the interrupt wait list, which is
+// woken up by the IRQ dispatcher on its own; mailboxes and timers have no way
+// of reaching them, so they notify all active waits through this list instead.
+ThrWaitAny* __wait_any_list;
+
+void _threadWaitAnyNotify(ThrWaitType type, const void* obj)
+{
+	ArmIrqState st = armIrqLockByPsr();
+	Thread* resched = NULL;
+
+	for (ThrWaitAny* w = __wait_any_list; w; w = w->next) {
+		for (unsigned i = 0; i < w->num_objs; i ++) {
+			ThrWaitObj* o = &w->objs[i];
+			if (o->type != type || (type == ThrWaitType_Mailbox ? (const void*)o->mailbox : (const void*)o->timer) != obj) {
+				continue;
+			}
+
+			if (type == ThrWaitType_Timer) {
+				w->timers_fired |= 1U << i;
+			}
+
+			// Switching to the woken thread is deferred until the list has been
+			// walked, since the thread unlinks its (stack allocated) entry upon return
+			Thread* t = threadBlockCancelLocked(&s_irqWaitList, w->thread);
+			if (t && (!resched || t->prio < resched->prio)) {
+				resched = t;
+			}
+			break;
+		}
+	}
+
+	threadReschedule(resched, st);
+}
+
+static void _threadWaitAnyUpdateIrqMask(void)
+{
+	// Only interrupt wakeups clear the bits we added to the wait mask; on every
+	// other exit path they would linger and make the dispatcher swallow the next
+	// interrupt of that source. Rebuild the mask from the remaining waiters.
+	IrqMask mask = 0;
+	for (Thread* t = s_irqWaitList.next; t; t = t->link.next) {
+		mask |= t->token;
+	}
+	s_irqWaitMask = mask;
+}
+
+static u32 _threadWaitAnyScan(ThrWaitAny* w, IrqMask irq_fired)
+{
+	u32 ready = 0;
+
+	for (unsigned i = 0; i < w->num_objs; i ++) {
+		ThrWaitObj* o = &w->objs[i];
+		u32 result = 0;
+
+		switch (o->type) {
+			case ThrWaitType_Mailbox:
+				result = o->mailbox->pending_slots;
+				break;
+
+			case ThrWaitType_Irq:
+				// Consume both latched flags and interrupts delivered to us directly
+				result = (__irq_flags | irq_fired) & o->irq_mask;
+				__irq_flags &= ~result;
+				break;
+
+			case ThrWaitType_Timer:
+				result = (w->timers_fired >> i) & 1;
+				break;
+		}
+
+		o->result = result;
+		if (result) {
+			ready |= 1U << i;
+		}
+	}
+
+	return ready;
+}
+
+u32 threadWaitAny(ThrWaitObj* objs, unsigned num_objs, u32 timeout_ticks)
+{
+	if_unlikely (!num_objs || num_objs > 32) {
+		return 0;
+	}
+
+	ThrWaitAny w = {
+		.thread   = s_curThread,
+		.objs     = objs,
+		.num_objs = num_objs,
+	};
+
+	IrqMask irq_mask = 0;
+	for (unsigned i = 0; i < num_objs; i ++) {
+		if (objs[i].type == ThrWaitType_Irq) {
+			irq_mask |= objs[i].irq_mask;
+		}
+	}
+
+	ArmIrqState st = armIrqLockByPsr();
+
+	w.next = __wait_any_list;
+	__wait_any_list = &w;
+
+	u32 deadline = 0;
+	if (timeout_ticks != THREAD_WAIT_INFINITE) {
+		deadline = (u32)tickGetCount() + timeout_ticks;
+	}
+
+	u32 ready;
+	IrqMask irq_fired = 0;
+	while (!(ready = _threadWaitAnyScan(&w, irq_fired))) {
+		s32 remaining = 0;
+		if (timeout_ticks != THREAD_WAIT_INFINITE) {
+			remaining = deadline - (u32)tickGetCount();
+			if (remaining <= 0) {
+				break;
+			}
+		}
+
+		// Block on the interrupt wait list (with a zero mask if no interrupts are waited on).
+		// Notifications from mailboxes and timers cancel the wait, returning 0.
+		s_irqWaitMask |= irq_mask;
+		if_likely (timeout_ticks == THREAD_WAIT_INFINITE) {
+			irq_fired |= threadBlock(&s_irqWaitList, irq_mask);
+		} else {
+			irq_fired |= threadBlockTimeout(&s_irqWaitList, irq_mask, remaining);
+		}
+	}
+
+	ThrWaitAny** pw = &__wait_any_list;
+	while (*pw != &w) {
+		pw = &(*pw)->next;
+	}
+	*pw = w.next;
+
+	if (irq_mask) {
+		_threadWaitAnyUpdateIrqMask();
+	}
+
+	armIrqUnlockByPsr(st);
+	return ready;
+}
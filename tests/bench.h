@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include <time.h>
+#include "test.h"
+
+// Microbenchmarks run on the host simulation and report host wall clock time.
+// Absolute figures include the cost of the simulation itself (context switches
+// are implemented with ucontext), so they are only meaningful as comparisons
+// between runs or between algorithms measured by the same program.
+
+MK_INLINE u64 benchGetNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+MK_INLINE void benchReport(const char* name, u64 ns, unsigned iterations)
+{
+	printf("%-40s %10.1f ns/op\n", name, (double)ns / iterations);
+}
+
+#define BENCH_RUN(_name, _iterations, ...) do { \
+	u64 _start = benchGetNs(); \
+	for (unsigned _i = 0; _i < (_iterations); _i ++) { \
+		__VA_ARGS__; \
+	} \
+	benchReport((_name), benchGetNs() - _start, (_iterations)); \
+} while (0)
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include <calico/system/mailbox.h>
+#include <calico/system/dpc.h>
+#include "bench.h"
+
+#define ITERATIONS 100000
+
+static DpcItem s_item;
+static Mailbox s_mailbox;
+static u32 s_mailboxSlots[4];
+static u64 s_raiseNs, s_totalNs;
+
+static void _dpcFn(DpcItem* item)
+{
+	s_totalNs += benchGetNs() - s_raiseNs;
+}
+
+static void _dpcIsr(void)
+{
+	dpcQueue(&s_item);
+}
+
+static void _mailboxIsr(void)
+{
+	mailboxTrySend(&s_mailbox, 1);
+}
+
+static int _workerThread(void* arg)
+{
+	while (mailboxRecv(&s_mailbox)) {
+		s_totalNs += benchGetNs() - s_raiseNs;
+	}
+	return 0;
+}
+
+static void _measure(const char* name)
+{
+	s_totalNs = 0;
+	for (unsigned i = 0; i < ITERATIONS; i ++) {
+		s_raiseNs = benchGetNs();
+		hostSimRaiseIrq(IRQ_VBLANK);
+	}
+	benchReport(name, s_totalNs, ITERATIONS);
+}
+
+int main(void)
+{
+	// Latency from interrupt to deferred work, both running at the same thread priority
+	irqEnable(IRQ_VBLANK);
+
+	dpcItemPrepare(&s_item, _dpcFn, NULL, 0);
+	dpcStartServer(THREAD_MAX_PRIO);
+	irqSet(IRQ_VBLANK, _dpcIsr);
+	_measure("irq -> dpc item");
+
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+	testThreadStart(0, _workerThread, NULL, THREAD_MAX_PRIO);
+	irqSet(IRQ_VBLANK, _mailboxIsr);
+	_measure("irq -> mailbox worker thread");
+
+	irqSet(IRQ_VBLANK, NULL);
+	mailboxTrySend(&s_mailbox, 0);
+	testThreadJoin(0);
+	return 0;
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include <calico/system/irqlatency.h>
+#include <calico/gba/timer.h>
+#include "bench.h"
+
+#define PROBE_FREQ   4096
+#define LOAD_FREQ    1000
+#define LOAD_CYCLES  3000
+#define RUN_CYCLES   (SYSTEM_CLOCK/4)
+
+// Interrupt entry latency seen by the latency probe (timer 0) with nested
+// interrupt dispatch disabled and enabled, under a long low priority ISR
+// (timer 1) and under critical sections of the main thread. Simulated time
+// only advances when requested, so the work done by the ISR and the critical
+// sections is represented by advancing the clock. Unlike the other benchmarks,
+// figures are in simulated cycles and do not depend on the host.
+
+alignas(8) static u8 s_nestStack[1024];
+
+static void _loadIsr(void)
+{
+	hostSimAdvance(LOAD_CYCLES);
+}
+
+static void _runIdle(void)
+{
+	hostSimAdvance(RUN_CYCLES);
+}
+
+static void _runLongIsr(void)
+{
+	irqSet(IRQ_TIMER1, _loadIsr);
+	timerBegin(1, TIMER_PRESCALER_1, LOAD_FREQ, true);
+	irqEnable(IRQ_TIMER1);
+	hostSimAdvance(RUN_CYCLES);
+	irqDisable(IRQ_TIMER1);
+	timerEnd(1);
+}
+
+static void _runCritSection(void)
+{
+	unsigned period = SYSTEM_CLOCK / LOAD_FREQ;
+	for (unsigned i = 0; i < RUN_CYCLES / period; i ++) {
+		IrqState st = irqLock();
+		hostSimAdvance(LOAD_CYCLES);
+		irqUnlock(st);
+		hostSimAdvance(period - LOAD_CYCLES);
+	}
+}
+
+static void _measure(const char* name, bool nesting, void (*run)(void))
+{
+	IrqLatencyStats stats;
+
+	irqEnableNesting(nesting ? &s_nestStack[sizeof(s_nestStack)] : NULL);
+	irqLatencyStart(0, PROBE_FREQ);
+	run();
+	irqLatencyStop();
+	irqLatencyGetStats(&stats);
+
+	unsigned late = 0;
+	for (unsigned i = 8; i < IRQ_LATENCY_NUM_BUCKETS; i ++) {
+		late += stats.hist[i];
+	}
+
+	printf("%-16s nesting %-3s %6lu samples, avg %6.1f, max %5lu cycles, %5u over 128\n",
+		name, nesting ? "on" : "off", (unsigned long)stats.num_samples,
+		stats.num_samples ? (double)stats.total_cycles / stats.num_samples : 0.0,
+		(unsigned long)stats.max_cycles, late);
+}
+
+int main(void)
+{
+	if (!irqLatencyStart(0, PROBE_FREQ)) {
+		printf("calico was built without CALICO_IRQ_LATENCY\n");
+		return 0;
+	}
+	irqLatencyStop();
+
+	// The probe takes priority over every other source when nesting is enabled
+	irqSetPrio(IRQ_TIMER0, IRQ_PRIO_HIGHEST);
+
+	for (unsigned i = 0; i < 2; i ++) {
+		_measure("idle", i, _runIdle);
+		_measure("long ISR", i, _runLongIsr);
+		_measure("critical section", i, _runCritSection);
+	}
+
+	irqEnableNesting(NULL);
+	return 0;
+}
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mailbox.h>
+#include "bench.h"
+
+#define ITERATIONS  200000
+#define MAX_BLOCKED 128
+
+// Scheduler switch/wakeup cost with a growing number of blocked threads, which
+// is the case that made the previous sorted thread list degrade. Two threads
+// take turns running (one blocks, the other one is picked; then the first one
+// is woken up again), while the blocked threads have a higher priority than both.
+
+//-----------------------------------------------------------------------------
+// Models of both algorithms, running on mock threads
+//-----------------------------------------------------------------------------
+
+typedef struct ModelThread ModelThread;
+
+typedef struct ModelNode {
+	ModelThread* next;
+	ModelThread* prev;
+} ModelNode;
+
+struct ModelThread {
+	ModelThread* next; // Sorted list (old)
+	ModelNode sched;   // Ready queue band (new)
+	u8 prio;
+	bool running;
+};
+
+static ModelThread s_model[MAX_BLOCKED+2];
+
+// Old: a single list of all threads sorted by priority, walked to find the first running one
+static ModelThread* s_oldFirst;
+
+static void _oldEnqueue(ModelThread* t)
+{
+	ModelThread* pos = NULL;
+	for (ModelThread* cur = s_oldFirst; cur && cur->prio <= t->prio; cur = cur->next) {
+		pos = cur;
+	}
+	if (pos) {
+		t->next = pos->next;
+		pos->next = t;
+	} else {
+		t->next = s_oldFirst;
+		s_oldFirst = t;
+	}
+}
+
+MK_NOINLINE static ModelThread* _oldBlock(ModelThread* t)
+{
+	t->running = false;
+	ModelThread* cur;
+	for (cur = s_oldFirst; cur && !cur->running; cur = cur->next);
+	return cur;
+}
+
+MK_NOINLINE static ModelThread* _oldWakeup(ModelThread* t)
+{
+	t->running = true;
+	ModelThread* cur;
+	for (cur = s_oldFirst; cur && !cur->running; cur = cur->next);
+	return cur;
+}
+
+// New: one FIFO band per priority level, indexed by a bitmap of nonempty bands
+static u32 s_newMask[2];
+static ModelNode s_newBands[64];
+
+static void _newEnqueue(ModelThread* t)
+{
+	ModelNode* band = &s_newBands[t->prio];
+	t->sched.next = NULL;
+	t->sched.prev = band->prev;
+	if (band->prev) {
+		band->prev->sched.next = t;
+	} else {
+		band->next = t;
+		s_newMask[t->prio >> 5] |= 0x80000000U >> (t->prio & 0x1f);
+	}
+	band->prev = t;
+}
+
+static void _newDequeue(ModelThread* t)
+{
+	ModelNode* band = &s_newBands[t->prio];
+	(t->sched.prev ? &t->sched.prev->sched : band)->next = t->sched.next;
+	(t->sched.next ? &t->sched.next->sched : band)->prev = t->sched.prev;
+	if (!band->next) {
+		s_newMask[t->prio >> 5] &= ~(0x80000000U >> (t->prio & 0x1f));
+	}
+}
+
+MK_INLINE ModelThread* _newFindRunnable(void)
+{
+	if (s_newMask[0]) {
+		return s_newBands[__builtin_clz(s_newMask[0])].next;
+	} else if (s_newMask[1]) {
+		return s_newBands[0x20 + __builtin_clz(s_newMask[1])].next;
+	}
+	return NULL;
+}
+
+MK_NOINLINE static ModelThread* _newBlock(ModelThread* t)
+{
+	_newDequeue(t);
+	return _newFindRunnable();
+}
+
+MK_NOINLINE static ModelThread* _newWakeup(ModelThread* t)
+{
+	_newEnqueue(t);
+	return _newFindRunnable();
+}
+
+static void _modelSetup(unsigned num_blocked)
+{
+	s_oldFirst = NULL;
+	s_newMask[0] = s_newMask[1] = 0;
+	for (unsigned i = 0; i < 64; i ++) {
+		s_newBands[i].next = s_newBands[i].prev = NULL;
+	}
+
+	// Blocked threads are still part of the old list, but not of the new ready queues
+	for (unsigned i = 0; i < num_blocked; i ++) {
+		ModelThread* t = &s_model[2+i];
+		t->prio = 0x08 + (i & 0xf);
+		t->running = false;
+		_oldEnqueue(t);
+	}
+
+	for (unsigned i = 0; i < 2; i ++) {
+		ModelThread* t = &s_model[i];
+		t->prio = 0x30;
+		t->running = true;
+		_oldEnqueue(t);
+		_newEnqueue(t);
+	}
+}
+
+static void _benchModel(unsigned num_blocked)
+{
+	char name[64];
+	ModelThread* volatile sink;
+
+	_modelSetup(num_blocked);
+	snprintf(name, sizeof(name), "old sorted list, %3u blocked", num_blocked);
+	BENCH_RUN(name, ITERATIONS,
+		sink = _oldBlock(&s_model[_i & 1]);
+		sink = _oldWakeup(&s_model[_i & 1]);
+	);
+
+	snprintf(name, sizeof(name), "new run queues,  %3u blocked", num_blocked);
+	BENCH_RUN(name, ITERATIONS,
+		sink = _newBlock(&s_model[_i & 1]);
+		sink = _newWakeup(&s_model[_i & 1]);
+	);
+
+	(void)sink;
+}
+
+//-----------------------------------------------------------------------------
+// The actual scheduler
+//-----------------------------------------------------------------------------
+
+#define REAL_STACK_SZ 1024
+
+static Thread s_blocked[MAX_BLOCKED];
+alignas(8) static u8 s_blockedStack[MAX_BLOCKED][REAL_STACK_SZ];
+static unsigned s_numBlocked;
+static Mailbox s_idle, s_ping, s_pong;
+static u32 s_idleSlots[1], s_pingSlots[4], s_pongSlots[4];
+
+static int _blockedThread(void* arg)
+{
+	return mailboxRecv(&s_idle);
+}
+
+static int _pongThread(void* arg)
+{
+	while (mailboxRecv(&s_ping)) {
+		mailboxTrySend(&s_pong, 1);
+	}
+	return 0;
+}
+
+static void _benchReal(unsigned num_blocked)
+{
+	char name[64];
+
+	for (; s_numBlocked < num_blocked; s_numBlocked ++) {
+		Thread* t = &s_blocked[s_numBlocked];
+		threadPrepareWithStack(t, _blockedThread, NULL, s_blockedStack[s_numBlocked], REAL_STACK_SZ, 0x08 + (s_numBlocked & 0xf));
+		threadStart(t);
+	}
+
+	testThreadStart(0, _pongThread, NULL, MAIN_THREAD_PRIO+1);
+	snprintf(name, sizeof(name), "mailbox round trip, %3u blocked", num_blocked);
+	BENCH_RUN(name, ITERATIONS,
+		mailboxTrySend(&s_ping, 1);
+		mailboxRecv(&s_pong);
+	);
+	mailboxTrySend(&s_ping, 0);
+	testThreadJoin(0);
+}
+
+int main(void)
+{
+	static const unsigned counts[] = { 0, 8, 32, 128 };
+
+	for (unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); i ++) {
+		_benchModel(counts[i]);
+	}
+
+	mailboxPrepare(&s_idle, s_idleSlots, 1);
+	mailboxPrepare(&s_ping, s_pingSlots, 4);
+	mailboxPrepare(&s_pong, s_pongSlots, 4);
+	for (unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); i ++) {
+		_benchReal(counts[i]);
+	}
+
+	// Release the blocked threads
+	for (unsigned i = 0; i < s_numBlocked; i ++) {
+		mailboxTrySend(&s_idle, 1);
+	}
+	for (unsigned i = 0; i < s_numBlocked; i ++) {
+		threadJoin(&s_blocked[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mailbox.h>
+#include <calico/system/spscring.h>
+#include "bench.h"
+
+#define ITERATIONS 200000
+#define BATCH      16
+
+static SpscRing s_ring;
+alignas(8) static u8 s_ringBuf[BATCH*16];
+static Mailbox s_mailbox;
+static u32 s_mailboxSlots[BATCH*4];
+
+static int _ringConsumerThread(void* arg)
+{
+	u32 rec[4];
+	do {
+		spscRingPopWait(&s_ring, rec, sizeof(rec));
+	} while (rec[0]);
+	return 0;
+}
+
+static int _mailboxConsumerThread(void* arg)
+{
+	u32 rec[4];
+	do {
+		for (unsigned i = 0; i < 4; i ++) {
+			rec[i] = mailboxRecv(&s_mailbox);
+		}
+	} while (rec[0]);
+	return 0;
+}
+
+int main(void)
+{
+	u32 word = 1, rec[4] = { 1, 2, 3, 4 };
+
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, BATCH*4);
+
+	// Single word messages, no waiters
+	BENCH_RUN("spsc ring push/pop (4 bytes)", ITERATIONS,
+		spscRingPush(&s_ring, &word, sizeof(word));
+		spscRingPop(&s_ring, &word, sizeof(word));
+	);
+	BENCH_RUN("mailbox send/recv (4 bytes)", ITERATIONS,
+		mailboxTrySend(&s_mailbox, word);
+		mailboxTryRecv(&s_mailbox, &word);
+	);
+
+	// Multiword records, no waiters
+	BENCH_RUN("spsc ring push/pop (16 bytes)", ITERATIONS,
+		spscRingPush(&s_ring, rec, sizeof(rec));
+		spscRingPop(&s_ring, rec, sizeof(rec));
+	);
+	BENCH_RUN("mailbox send/recv (16 bytes)", ITERATIONS,
+		for (unsigned i = 0; i < 4; i ++) {
+			mailboxTrySend(&s_mailbox, rec[i]);
+		}
+		for (unsigned i = 0; i < 4; i ++) {
+			mailboxTryRecv(&s_mailbox, &rec[i]);
+		}
+	);
+
+	// Streaming batches of 16 byte records to a consumer thread of the same priority
+	testThreadStart(0, _ringConsumerThread, NULL, MAIN_THREAD_PRIO);
+	BENCH_RUN("spsc ring stream (batch of 16x16 bytes)", ITERATIONS/BATCH,
+		for (unsigned i = 0; i < BATCH; i ++) {
+			spscRingPush(&s_ring, rec, sizeof(rec));
+		}
+		threadYield();
+	);
+	rec[0] = 0;
+	spscRingPush(&s_ring, rec, sizeof(rec));
+	testThreadJoin(0);
+
+	rec[0] = 1;
+	testThreadStart(0, _mailboxConsumerThread, NULL, MAIN_THREAD_PRIO);
+	BENCH_RUN("mailbox stream (batch of 16x16 bytes)", ITERATIONS/BATCH,
+		for (unsigned i = 0; i < BATCH; i ++) {
+			for (unsigned j = 0; j < 4; j ++) {
+				mailboxTrySend(&s_mailbox, rec[j]);
+			}
+		}
+		threadYield();
+	);
+	rec[0] = 0;
+	for (unsigned j = 0; j < 4; j ++) {
+		mailboxTrySend(&s_mailbox, rec[j]);
+	}
+	testThreadJoin(0);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mutex.h>
+#include <calico/system/condvar.h>
+#include <calico/system/mailbox.h>
+#include "bench.h"
+
+#define ITERATIONS 200000
+
+static Mutex s_mutex;
+static Mailbox s_ping, s_pong;
+static u32 s_pingSlots[4], s_pongSlots[4];
+
+static int _pongThread(void* arg)
+{
+	for (;;) {
+		u32 msg = mailboxRecv(&s_ping);
+		if (!msg) {
+			break;
+		}
+		mailboxTrySend(&s_pong, msg);
+	}
+	return 0;
+}
+
+int main(void)
+{
+	u32 msg;
+
+	BENCH_RUN("mutex lock/unlock (uncontended)", ITERATIONS,
+		mutexLock(&s_mutex);
+		mutexUnlock(&s_mutex);
+	);
+
+	mailboxPrepare(&s_ping, s_pingSlots, 4);
+	mailboxPrepare(&s_pong, s_pongSlots, 4);
+
+	BENCH_RUN("mailbox send/recv (no waiters)", ITERATIONS,
+		mailboxTrySend(&s_ping, 1);
+		mailboxTryRecv(&s_ping, &msg);
+	);
+
+	testThreadStart(0, _pongThread, NULL, MAIN_THREAD_PRIO+1);
+	BENCH_RUN("mailbox round trip (2 switches)", ITERATIONS,
+		mailboxTrySend(&s_ping, 1);
+		mailboxRecv(&s_pong);
+	);
+	mailboxTrySend(&s_ping, 0);
+	testThreadJoin(0);
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include <calico/gba/timer.h>
+#include "bench.h"
+
+#define ITERATIONS  20000
+#define MAX_PENDING 1024
+#define SPREAD      0x10000
+#define PERIOD      1024
+#define BATCH_TICKS 256
+
+// Time spent with interrupts disabled by tick task operations as the number of
+// pending tasks grows. Starting and stopping a task run under irqLock, and
+// expiry runs in the timer interrupt handler: with the previous sorted list
+// each of these walked the list, while the timing wheel does a bounded amount
+// of work. The old list is a copy of the previous implementation driven by
+// timer 0 instead of timer 3; the wheel is the actual tick subsystem.
+
+static u32 s_seed = 1;
+static unsigned s_numFired;
+
+static u32 _rand(void)
+{
+	s_seed = s_seed*1103515245 + 12345;
+	return s_seed >> 8;
+}
+
+static void _taskFn(TickTask* t)
+{
+	s_numFired ++;
+}
+
+//-----------------------------------------------------------------------------
+// Model of the previous sorted task list
+//-----------------------------------------------------------------------------
+
+static TickTask s_oldTasks[MAX_PENDING+1];
+static TickTask* s_oldFirst;
+
+MK_CONSTEXPR bool _tickIsSequential32(u32 lhs, u32 rhs)
+{
+	return (s32)(rhs - lhs) > 0;
+}
+
+static void _oldEnqueue(TickTask* t)
+{
+	TickTask* pos = NULL;
+	for (TickTask* cur = s_oldFirst; cur && _tickIsSequential32(cur->target, t->target); cur = cur->next) {
+		pos = cur;
+	}
+	if (pos) {
+		t->next = pos->next;
+		pos->next = t;
+	} else {
+		t->next = s_oldFirst;
+		s_oldFirst = t;
+	}
+}
+
+static void _oldDequeue(TickTask* t)
+{
+	TickTask* prev = NULL;
+	for (TickTask* cur = s_oldFirst; cur && cur != t; cur = cur->next) {
+		prev = cur;
+	}
+	if (prev) {
+		prev->next = t->next;
+	} else {
+		s_oldFirst = t->next;
+	}
+}
+
+static void _oldSchedule(TickTask* t)
+{
+	REG_TMxCNT_H(0) = 0;
+	if_likely (!t) {
+		return;
+	}
+
+	s32 diff = t->target - (s32)tickGetCount();
+	u16 preload = 0;
+	if (diff <= 0) {
+		preload = -1;
+	} else if (diff < 0x10000) {
+		preload = -diff;
+	}
+
+	REG_TMxCNT_L(0) = preload;
+	REG_TMxCNT_H(0) = TIMER_PRESCALER_64 | TIMER_ENABLE_IRQ | TIMER_ENABLE;
+}
+
+static void _oldIsr(void)
+{
+	while (s_oldFirst && !_tickIsSequential32(tickGetCount(), s_oldFirst->target)) {
+		TickTask* cur = s_oldFirst;
+		s_oldFirst = cur->next;
+
+		cur->fn(cur);
+
+		if_likely (cur->period != 0 && cur->fn) {
+			cur->target += cur->period;
+			_oldEnqueue(cur);
+		} else {
+			cur->fn = NULL;
+		}
+	}
+
+	_oldSchedule(s_oldFirst);
+}
+
+MK_NOINLINE static void _oldStart(TickTask* t, u32 delay_ticks, u32 period_ticks)
+{
+	IrqState st = irqLock();
+	t->target = tickGetCount() + delay_ticks;
+	t->period = period_ticks;
+	t->fn = _taskFn;
+	_oldEnqueue(t);
+	if (s_oldFirst == t) {
+		_oldSchedule(t);
+	}
+	irqUnlock(st);
+}
+
+MK_NOINLINE static void _oldStop(TickTask* t)
+{
+	IrqState st = irqLock();
+	bool need_resched = s_oldFirst == t;
+	_oldDequeue(t);
+	if (need_resched) {
+		_oldSchedule(s_oldFirst);
+	}
+	t->fn = NULL;
+	irqUnlock(st);
+}
+
+//-----------------------------------------------------------------------------
+// Benchmarks
+//-----------------------------------------------------------------------------
+
+static TickTask s_newTasks[MAX_PENDING+1];
+
+static void _benchStartStop(unsigned num_pending)
+{
+	char name[64];
+	TickTask* old_probe = &s_oldTasks[MAX_PENDING];
+	TickTask* new_probe = &s_newTasks[MAX_PENDING];
+
+	s_oldFirst = NULL;
+	for (unsigned i = 0; i < num_pending; i ++) {
+		u32 delay = 1000 + _rand() % SPREAD;
+		_oldStart(&s_oldTasks[i], delay, 0);
+		tickTaskStart(&s_newTasks[i], _taskFn, delay, 0);
+	}
+
+	// Tasks expiring at a random point among the pending ones
+	snprintf(name, sizeof(name), "old list start/stop, %4u pending", num_pending);
+	BENCH_RUN(name, ITERATIONS,
+		_oldStart(old_probe, 1000 + _rand() % SPREAD, 0);
+		_oldStop(old_probe);
+	);
+
+	snprintf(name, sizeof(name), "wheel start/stop,    %4u pending", num_pending);
+	BENCH_RUN(name, ITERATIONS,
+		tickTaskStart(new_probe, _taskFn, 1000 + _rand() % SPREAD, 0);
+		tickTaskStop(new_probe);
+	);
+
+	// Tasks expiring after all pending ones, which is the worst case for the list
+	snprintf(name, sizeof(name), "old list start/stop last, %4u pending", num_pending);
+	BENCH_RUN(name, ITERATIONS,
+		_oldStart(old_probe, 1000 + SPREAD, 0);
+		_oldStop(old_probe);
+	);
+
+	snprintf(name, sizeof(name), "wheel start/stop last,    %4u pending", num_pending);
+	BENCH_RUN(name, ITERATIONS,
+		tickTaskStart(new_probe, _taskFn, 1000 + SPREAD, 0);
+		tickTaskStop(new_probe);
+	);
+
+	for (unsigned i = 0; i < num_pending; i ++) {
+		_oldStop(&s_oldTasks[i]);
+		tickTaskStop(&s_newTasks[i]);
+	}
+}
+
+// Lets a batch of ticks elapse with interrupts disabled, so that the timer
+// handler processes all of it in a single pass when they are enabled again
+MK_INLINE void _runBatches(unsigned batches)
+{
+	for (unsigned i = 0; i < batches; i ++) {
+		ArmIrqState st = armIrqLockByPsr();
+		testSpinTicks(BATCH_TICKS);
+		armIrqUnlockByPsr(st);
+	}
+}
+
+static void _benchExpiry(unsigned num_pending)
+{
+	char name[64];
+	unsigned batches = ITERATIONS*4 / num_pending;
+
+	// Periodic tasks with evenly spread phases, so that each batch of ticks
+	// expires (and reschedules) the same number of them
+	s_oldFirst = NULL;
+	for (unsigned i = 0; i < num_pending; i ++) {
+		_oldStart(&s_oldTasks[i], 1 + i*PERIOD/num_pending, PERIOD);
+	}
+
+	s_numFired = 0;
+	u64 start = benchGetNs();
+	_runBatches(batches);
+	snprintf(name, sizeof(name), "old list expiry, %4u pending", num_pending);
+	benchReport(name, benchGetNs() - start, s_numFired);
+
+	for (unsigned i = 0; i < num_pending; i ++) {
+		_oldStop(&s_oldTasks[i]);
+	}
+
+	for (unsigned i = 0; i < num_pending; i ++) {
+		tickTaskStart(&s_newTasks[i], _taskFn, 1 + i*PERIOD/num_pending, PERIOD);
+	}
+
+	s_numFired = 0;
+	start = benchGetNs();
+	_runBatches(batches);
+	snprintf(name, sizeof(name), "wheel expiry,    %4u pending", num_pending);
+	benchReport(name, benchGetNs() - start, s_numFired);
+
+	for (unsigned i = 0; i < num_pending; i ++) {
+		tickTaskStop(&s_newTasks[i]);
+	}
+}
+
+int main(void)
+{
+	static const unsigned counts[] = { 16, 64, 256, 1024 };
+
+	tickInit();
+	irqSet(IRQ_TIMER0, _oldIsr);
+	irqEnable(IRQ_TIMER0);
+
+	for (unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); i ++) {
+		_benchStartStop(counts[i]);
+	}
+
+	// Expiry figures are per callback, including rescheduling the periodic task;
+	// they also include the fixed cost of simulating the timers for each batch,
+	// which dominates when few tasks expire per batch
+	for (unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); i ++) {
+		_benchExpiry(counts[i]);
+	}
+
+	return 0;
+}
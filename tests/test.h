@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <calico/types.h>
+#include <calico/system/thread.h>
+#include <calico/system/tick.h>
+#include <calico/host/sim.h>
+
+// Shared scaffolding for the host simulation tests. Each test is a standalone
+// program whose main() runs as calico's main thread; a failed check aborts it.
+
+#define TEST_NUM_THREADS 8
+#define TEST_STACK_SZ    2048
+
+// System clock cycles per tick
+#define TEST_CYCLES_PER_TICK (TICK_HIRES_FREQ/TICK_FREQ)
+
+#define TEST_CHECK(_expr) do { \
+	if (!(_expr)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_expr); \
+		exit(1); \
+	} \
+} while (0)
+
+static Thread s_testThread[TEST_NUM_THREADS];
+alignas(8) static u8 s_testStack[TEST_NUM_THREADS][TEST_STACK_SZ];
+
+MK_INLINE Thread* testThreadStart(unsigned id, ThreadFunc fn, void* arg, u8 prio)
+{
+	Thread* t = &s_testThread[id];
+	threadPrepareWithStack(t, fn, arg, s_testStack[id], TEST_STACK_SZ, prio);
+	threadStart(t);
+	return t;
+}
+
+MK_INLINE int testThreadJoin(unsigned id)
+{
+	return threadJoin(&s_testThread[id]);
+}
+
+// Burns simulated CPU time in the current thread (may be preempted)
+MK_INLINE void testSpinTicks(u32 ticks)
+{
+	hostSimAdvance((u64)ticks * TEST_CYCLES_PER_TICK);
+}
+
+// Records the order in which threads reach certain points
+typedef struct TestLog {
+	unsigned count;
+	int entries[64];
+} TestLog;
+
+MK_INLINE void testLogPush(TestLog* log, int value)
+{
+	if (log->count < sizeof(log->entries)/sizeof(log->entries[0])) {
+		log->entries[log->count] = value;
+	}
+	log->count ++;
+}
+
+MK_INLINE bool testLogEquals(const TestLog* log, const int* values, unsigned count)
+{
+	if (log->count != count) {
+		return false;
+	}
+	for (unsigned i = 0; i < count; i ++) {
+		if (log->entries[i] != values[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#define TEST_LOG_EQUALS(_log, ...) ({ \
+	static const int _expected[] = { __VA_ARGS__ }; \
+	testLogEquals((_log), _expected, sizeof(_expected)/sizeof(_expected[0])); \
+})
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include "../source/system/thread-priv.h"
+#include "test.h"
+
+static TestLog s_log;
+static volatile u32 s_lock, s_shared;
+static u32 s_condvar;
+
+// Words 0 and 0x11 share the same wait queue, since the array is aligned to 0x100 words
+alignas(1024) static volatile u32 s_words[0x20];
+
+static int _waiterThread(void* arg)
+{
+	volatile u32* word = &s_words[(uptr)arg >> 4];
+	while (*word == 0) {
+		threadWaitOnAddress(word, 0);
+	}
+	testLogPush(&s_log, (int)(uptr)arg);
+	return 0;
+}
+
+static int _lockerThread(void* arg)
+{
+	_threadAddrLockAcquire(&s_lock);
+	testLogPush(&s_log, (int)(uptr)arg);
+	s_shared ++;
+	_threadAddrLockRelease(&s_lock);
+	return 0;
+}
+
+static int _condvarThread(void* arg)
+{
+	_threadAddrLockAcquire(&s_lock);
+	while (!s_shared) {
+		_condvarCompatWaitAddrLock((u32)(uptr)&s_condvar, &s_lock, UINT32_MAX);
+	}
+	testLogPush(&s_log, (int)(uptr)arg);
+	_threadAddrLockRelease(&s_lock);
+	return 0;
+}
+
+static void _vblankIsr(void)
+{
+	s_words[0] = 1;
+	threadWakeAddress(&s_words[0], UINT32_MAX);
+}
+
+static void _testWaitWake(void)
+{
+	// Waiting on a word that does not contain the expected value returns immediately
+	TEST_CHECK(!threadWaitOnAddress(&s_words[0], 1));
+
+	// Waiters are woken up in priority order, up to the specified count
+	s_log.count = 0;
+	testThreadStart(0, _waiterThread, (void*)1, 0x18);
+	testThreadStart(1, _waiterThread, (void*)2, 0x10);
+	testThreadStart(2, _waiterThread, (void*)3, 0x14);
+	s_words[0] = 1;
+	threadWakeAddress(&s_words[0], 1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2));
+	threadWakeAddress(&s_words[0], UINT32_MAX);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 3, 1));
+}
+
+static void _testSharedQueue(void)
+{
+	// Waking up an address does not wake up waiters on other addresses sharing its queue
+	s_log.count = 0;
+	s_words[0] = 0;
+	s_words[0x11] = 0;
+	testThreadStart(0, _waiterThread, (void*)0x00, 0x10);
+	testThreadStart(1, _waiterThread, (void*)0x110, 0x10);
+	s_words[0x11] = 1;
+	threadWakeAddress(&s_words[0x11], UINT32_MAX);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0x110));
+	threadWakeAddress(&s_words[0], UINT32_MAX);
+	TEST_CHECK(s_log.count == 1);
+	testThreadJoin(1);
+
+	// Wakeups can be issued from interrupt handlers
+	irqSet(IRQ_VBLANK, _vblankIsr);
+	irqEnable(IRQ_VBLANK);
+	hostSimRaiseIrq(IRQ_VBLANK);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0x110, 0x00));
+	testThreadJoin(0);
+	irqDisable(IRQ_VBLANK);
+}
+
+static void _testLock(void)
+{
+	// Contended locks are handed over on release
+	s_log.count = 0;
+	s_shared = 0;
+	_threadAddrLockAcquire(&s_lock);
+	testThreadStart(0, _lockerThread, (void*)1, 0x10);
+	TEST_CHECK(s_log.count == 0);
+	TEST_CHECK(!_threadAddrLockTryAcquire(&s_lock));
+	_threadAddrLockRelease(&s_lock);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1));
+	TEST_CHECK(s_shared == 1 && s_lock == 0);
+	testThreadJoin(0);
+
+	// Uncontended locks never touch the wait queues
+	TEST_CHECK(_threadAddrLockTryAcquire(&s_lock));
+	TEST_CHECK(s_lock == 1);
+	_threadAddrLockRelease(&s_lock);
+	TEST_CHECK(s_lock == 0);
+}
+
+static void _testCondVar(void)
+{
+	// Condition variables keyed by address cooperate with the lock word
+	s_log.count = 0;
+	s_shared = 0;
+	testThreadStart(0, _condvarThread, (void*)1, 0x10);
+	TEST_CHECK(s_lock == 0 && s_log.count == 0);
+
+	_threadAddrLockAcquire(&s_lock);
+	s_shared = 1;
+	_condvarCompatSignal((u32)(uptr)&s_condvar);
+	_threadAddrLockRelease(&s_lock);
+	testThreadJoin(0);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1));
+
+	// Timed waits give up, reacquiring the lock
+	_threadAddrLockAcquire(&s_lock);
+	TEST_CHECK(!_condvarCompatWaitAddrLock((u32)(uptr)&s_condvar, &s_lock, 10));
+	TEST_CHECK(s_lock != 0);
+	_threadAddrLockRelease(&s_lock);
+}
+
+int main(void)
+{
+	_testWaitWake();
+	_testSharedQueue();
+	_testLock();
+	_testCondVar();
+	return 0;
+}
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include <calico/system/coro.h>
+#include "test.h"
+
+typedef struct TestTask {
+	Coro co;
+	unsigned i;
+	u32 msg;
+	int id;
+} TestTask;
+
+static TestLog s_log;
+static TestTask s_tasks[3];
+static CoroLoop s_loop;
+static u32 s_loopSlots[8];
+static Mailbox s_mailbox;
+static u32 s_mailboxSlots[4];
+static TickTask s_sendTask, s_wakeTask;
+
+static int _sleeperCoro(Coro* co)
+{
+	TestTask* t = (TestTask*)co;
+	CORO_BEGIN(co);
+	for (t->i = 0; t->i < 3; t->i ++) {
+		CORO_SLEEP_TICKS(co, 10*(t->id+1));
+		testLogPush(&s_log, t->id*10 + t->i);
+	}
+	CORO_END(co);
+}
+
+static int _receiverCoro(Coro* co)
+{
+	TestTask* t = (TestTask*)co;
+	CORO_BEGIN(co);
+	CORO_AWAIT_MAILBOX(co, &s_mailbox, &t->msg);
+	testLogPush(&s_log, 100 + t->msg);
+	CORO_AWAIT_WAKE(co);
+	testLogPush(&s_log, 200);
+	CORO_END(co);
+}
+
+static int _yieldCoro(Coro* co)
+{
+	TestTask* t = (TestTask*)co;
+	CORO_BEGIN(co);
+	for (t->i = 0; t->i < 3; t->i ++) {
+		testLogPush(&s_log, t->id*10 + t->i);
+		CORO_YIELD(co);
+	}
+	if (t->id == 1) {
+		CORO_EXIT(co);
+	}
+	testLogPush(&s_log, t->id*10 + 9);
+	CORO_END(co);
+}
+
+static void _vblankIsr(void)
+{
+	mailboxTrySend(&s_mailbox, 5);
+}
+
+static void _hblankIsr(void)
+{
+	coroWake(&s_tasks[2].co);
+}
+
+static void _sendTaskFn(TickTask* task)
+{
+	hostSimRaiseIrq(IRQ_VBLANK);
+}
+
+static void _wakeTaskFn(TickTask* task)
+{
+	hostSimRaiseIrq(IRQ_HBLANK);
+}
+
+static void _testEvents(void)
+{
+	// Sleeping, mailbox and wakeup events resume coroutines in time order,
+	// with interrupts delivering messages and wakeups while the loop is idle
+	s_log.count = 0;
+	coroLoopPrepare(&s_loop, s_loopSlots, 8);
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+	irqSet(IRQ_VBLANK, _vblankIsr);
+	irqEnable(IRQ_VBLANK);
+	irqSet(IRQ_HBLANK, _hblankIsr);
+	irqEnable(IRQ_HBLANK);
+
+	s_tasks[0].id = 0;
+	s_tasks[1].id = 1;
+	coroStart(&s_loop, &s_tasks[0].co, _sleeperCoro);
+	coroStart(&s_loop, &s_tasks[1].co, _sleeperCoro);
+	coroStart(&s_loop, &s_tasks[2].co, _receiverCoro);
+	tickTaskStart(&s_sendTask, _sendTaskFn, 15, 0);
+	tickTaskStart(&s_wakeTask, _wakeTaskFn, 45, 0);
+
+	u32 start = tickGetCount();
+	coroLoopRun(&s_loop);
+	u32 elapsed = tickGetCount() - start;
+
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0, 105, 1, 10, 2, 11, 200, 12));
+	TEST_CHECK(elapsed >= 60 && elapsed < 70);
+	for (unsigned i = 0; i < 3; i ++) {
+		TEST_CHECK(coroIsFinished(&s_tasks[i].co));
+	}
+
+	irqDisable(IRQ_VBLANK | IRQ_HBLANK);
+}
+
+static void _testYield(void)
+{
+	// Yielding coroutines take turns, and can finish early
+	s_log.count = 0;
+	coroLoopPrepare(&s_loop, s_loopSlots, 8);
+	for (unsigned i = 0; i < 2; i ++) {
+		s_tasks[i].id = i;
+		coroStart(&s_loop, &s_tasks[i].co, _yieldCoro);
+	}
+
+	coroLoopRun(&s_loop);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0, 10, 1, 11, 2, 12, 9));
+}
+
+#define NUM_MANY (CORO_MAX_MAILBOX_WAITS+8)
+
+typedef struct ManyTask {
+	Coro co;
+	u32 msg;
+	u32 done;
+} ManyTask;
+
+static ManyTask s_many[NUM_MANY];
+static u32 s_manyLoopSlots[NUM_MANY];
+static Mailbox s_manyMailbox[NUM_MANY];
+static u32 s_manyMailboxSlots[NUM_MANY];
+static TickTask s_lateTask;
+
+static int _manyCoro(Coro* co)
+{
+	ManyTask* t = (ManyTask*)co;
+	CORO_BEGIN(co);
+	CORO_AWAIT_MAILBOX(co, &s_manyMailbox[t - s_many], &t->msg);
+	t->done = tickGetCount();
+	CORO_END(co);
+}
+
+// Coroutines are added to the front of the list, so the loop sleeps on the
+// mailboxes of the ones started last, and polls those of the first ones
+#define NUM_POLLED (NUM_MANY-CORO_MAX_MAILBOX_WAITS)
+
+static void _sendPolledFn(TickTask* task)
+{
+	for (unsigned i = 0; i < NUM_POLLED; i ++) {
+		mailboxTrySend(&s_manyMailbox[i], i);
+	}
+}
+
+static void _sendRestFn(TickTask* task)
+{
+	for (unsigned i = NUM_POLLED; i < NUM_MANY; i ++) {
+		mailboxTrySend(&s_manyMailbox[i], i);
+	}
+}
+
+static void _testManyMailboxes(void)
+{
+	// Coroutines awaiting mailboxes past the limit are still resumed (by
+	// polling) when their messages arrive, and not only when the loop is
+	// woken up by some other event
+	coroLoopPrepare(&s_loop, s_manyLoopSlots, NUM_MANY);
+	for (unsigned i = 0; i < NUM_MANY; i ++) {
+		mailboxPrepare(&s_manyMailbox[i], &s_manyMailboxSlots[i], 1);
+		coroStart(&s_loop, &s_many[i].co, _manyCoro);
+	}
+
+	u32 start = tickGetCount();
+	tickTaskStart(&s_sendTask, _sendPolledFn, 20, 0);
+	tickTaskStart(&s_lateTask, _sendRestFn, 20 + 10*CORO_POLL_TICKS, 0);
+	coroLoopRun(&s_loop);
+
+	for (unsigned i = 0; i < NUM_MANY; i ++) {
+		TEST_CHECK(coroIsFinished(&s_many[i].co) && s_many[i].msg == i);
+	}
+	for (unsigned i = 0; i < NUM_POLLED; i ++) {
+		TEST_CHECK(s_many[i].done - start <= 20 + CORO_POLL_TICKS + 1);
+	}
+}
+
+int main(void)
+{
+	_testEvents();
+	_testYield();
+	_testManyMailboxes();
+	return 0;
+}
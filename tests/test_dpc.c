@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include <calico/system/dpc.h>
+#include "test.h"
+
+static TestLog s_log;
+static DpcItem s_items[4];
+static bool s_queueResult;
+
+static void _dpcFn(DpcItem* item)
+{
+	testLogPush(&s_log, (int)(uptr)item->user);
+}
+
+static void _requeueFn(DpcItem* item)
+{
+	testLogPush(&s_log, (int)(uptr)item->user);
+	if (s_log.count < 3) {
+		dpcQueue(item);
+	}
+}
+
+static void _vblankIsr(void)
+{
+	dpcQueue(&s_items[2]);
+	dpcQueue(&s_items[0]);
+	dpcQueue(&s_items[1]);
+	s_queueResult = dpcQueue(&s_items[1]);
+}
+
+static int _spinThread(void* arg)
+{
+	testSpinTicks(10);
+	hostSimRaiseIrq(IRQ_VBLANK);
+	testLogPush(&s_log, (int)(uptr)arg);
+	return 0;
+}
+
+static void _testIrqOrder(void)
+{
+	// Items queued by an interrupt handler run in priority order before the
+	// interrupted thread resumes, and already pending items are coalesced
+	s_log.count = 0;
+	hostSimRaiseIrq(IRQ_VBLANK);
+	TEST_CHECK(!s_queueResult);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 1, 0));
+}
+
+static void _testPreemptsThreads(void)
+{
+	// DPCs queued while another thread is running preempt it
+	s_log.count = 0;
+	testThreadStart(0, _spinThread, (void*)10, 0x10);
+	testThreadJoin(0);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 1, 0, 10));
+}
+
+static void _testCancel(void)
+{
+	// Items can be cancelled while pending, without disturbing the rest of the queue
+	s_log.count = 0;
+	threadSetPrio(threadGetSelf(), THREAD_MAX_PRIO);
+	TEST_CHECK(dpcQueue(&s_items[3]));
+	TEST_CHECK(dpcQueue(&s_items[2]));
+	TEST_CHECK(dpcQueue(&s_items[1]));
+	TEST_CHECK(dpcCancel(&s_items[2]));
+	TEST_CHECK(!dpcCancel(&s_items[2]));
+	TEST_CHECK(s_log.count == 0);
+	threadSetPrio(threadGetSelf(), MAIN_THREAD_PRIO);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 3, 1));
+	TEST_CHECK(!dpcCancel(&s_items[3]));
+}
+
+static void _testStartTwice(void)
+{
+	// Starting the server again has no effect, and in particular does not
+	// lower the priority of the running worker thread
+	s_log.count = 0;
+	dpcStartServer(0x30);
+	testThreadStart(0, _spinThread, (void*)10, 0x10);
+	testThreadJoin(0);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 1, 0, 10));
+}
+
+static void _testRequeue(void)
+{
+	// Items can queue themselves again from their own function
+	s_log.count = 0;
+	dpcItemPrepare(&s_items[0], _requeueFn, (void*)7, 0);
+	dpcQueue(&s_items[0]);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 7, 7, 7));
+}
+
+int main(void)
+{
+	for (unsigned i = 0; i < 4; i ++) {
+		dpcItemPrepare(&s_items[i], _dpcFn, (void*)(uptr)i, i == 0 ? 5 : 1);
+	}
+
+	dpcStartServer(THREAD_MAX_PRIO);
+	irqSet(IRQ_VBLANK, _vblankIsr);
+	irqEnable(IRQ_VBLANK);
+
+	_testIrqOrder();
+	_testPreemptsThreads();
+	_testCancel();
+	_testStartTwice();
+	_testRequeue();
+	return 0;
+}
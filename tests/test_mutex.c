@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mutex.h>
+#include "test.h"
+
+static TestLog s_log;
+static Mutex s_mutex, s_mutex2;
+
+static int _lowThread(void* arg)
+{
+	mutexLock(&s_mutex);
+	testSpinTicks(1000);
+	testLogPush(&s_log, 1);
+	mutexUnlock(&s_mutex);
+	return threadGetSelf()->prio;
+}
+
+static int _hogThread(void* arg)
+{
+	threadSleepTicks(20);
+	testSpinTicks(2000);
+	testLogPush(&s_log, 2);
+	return 0;
+}
+
+static int _highThread(void* arg)
+{
+	threadSleepTicks(10);
+	mutexLock(&s_mutex);
+	testLogPush(&s_log, 3);
+	mutexUnlock(&s_mutex);
+	return 0;
+}
+
+static void _testInheritance(void)
+{
+	// A medium priority hog must not starve the lock holder a high priority thread waits for
+	s_log.count = 0;
+	testThreadStart(0, _lowThread, NULL, 0x30);
+	testThreadStart(1, _hogThread, NULL, 0x28);
+	testThreadStart(2, _highThread, NULL, 0x20);
+
+	threadSleepTicks(50);
+	TEST_CHECK(s_testThread[0].prio == 0x20);
+	TEST_CHECK(s_testThread[0].baseprio == 0x30);
+
+	// The inherited priority is dropped upon unlocking
+	TEST_CHECK(testThreadJoin(0) == 0x30);
+	testThreadJoin(1);
+	testThreadJoin(2);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 3, 2));
+}
+
+static int _holdThread(void* arg)
+{
+	Mutex* m = (Mutex*)arg;
+	mutexLock(m);
+	threadSleepTicks(1000);
+	mutexUnlock(m);
+	return threadGetSelf()->prio;
+}
+
+static int _chainThread(void* arg)
+{
+	mutexLock(&s_mutex2);
+	mutexLock(&s_mutex);
+	mutexUnlock(&s_mutex);
+	mutexUnlock(&s_mutex2);
+	return threadGetSelf()->prio;
+}
+
+static int _lockThread(void* arg)
+{
+	mutexLock((Mutex*)arg);
+	mutexUnlock((Mutex*)arg);
+	return 0;
+}
+
+static int _tryLockThread(void* arg)
+{
+	return mutexTryLock((Mutex*)arg);
+}
+
+static int _timeoutThread(void* arg)
+{
+	return mutexLockTimeout((Mutex*)arg, 100);
+}
+
+static void _testChain(void)
+{
+	// Inheritance propagates through a thread blocked on another mutex
+	testThreadStart(0, _holdThread, &s_mutex, 0x30);
+	threadSleepTicks(1);
+	testThreadStart(1, _chainThread, NULL, 0x28);
+	threadSleepTicks(1);
+	TEST_CHECK(s_testThread[0].prio == 0x28);
+
+	testThreadStart(2, _lockThread, &s_mutex2, 0x18);
+	TEST_CHECK(s_testThread[0].prio == 0x18);
+	TEST_CHECK(s_testThread[1].prio == 0x18);
+
+	TEST_CHECK(testThreadJoin(0) == 0x30);
+	TEST_CHECK(testThreadJoin(1) == 0x28);
+	testThreadJoin(2);
+	TEST_CHECK(!s_mutex.owner && !s_mutex2.owner);
+}
+
+static void _testTimeoutDropsInheritance(void)
+{
+	testThreadStart(0, _holdThread, &s_mutex, 0x30);
+	threadSleepTicks(1);
+	testThreadStart(1, _timeoutThread, &s_mutex, 0x10);
+	TEST_CHECK(s_testThread[0].prio == 0x10);
+
+	TEST_CHECK(testThreadJoin(1) == 0);
+	TEST_CHECK(s_testThread[0].prio == 0x30);
+	TEST_CHECK(testThreadJoin(0) == 0x30);
+}
+
+static void _testTryLock(void)
+{
+	TEST_CHECK(mutexTryLock(&s_mutex));
+	TEST_CHECK(mutexIsLockedByCurrentThread(&s_mutex));
+	testThreadStart(0, _tryLockThread, &s_mutex, 0x10);
+	TEST_CHECK(testThreadJoin(0) == 0);
+	mutexUnlock(&s_mutex);
+	TEST_CHECK(!mutexIsLockedByCurrentThread(&s_mutex));
+}
+
+int main(void)
+{
+	_testInheritance();
+	_testChain();
+	_testTimeoutDropsInheritance();
+	_testTryLock();
+	return 0;
+}
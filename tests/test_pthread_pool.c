@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include "../source/system/thread-priv.h"
+#include "test.h"
+
+#define SMALL_STACK_SZ 0x400
+#define MID_STACK_SZ   0x800
+#define LARGE_STACK_SZ 0x1000
+
+alignas(8) static u8 s_smallSlots[2][0x800];
+alignas(8) static u8 s_largeSlots[1][0x1800];
+alignas(8) static u8 s_midSlots[1][0x1000];
+alignas(8) static u8 s_extraSlots[PTHREAD_POOL_MAX_CLASSES][0x100];
+
+static struct __pthread_t* s_liveThread;
+static PthreadPoolClass* s_liveCls;
+
+static struct __pthread_t* _alloc(size_t stack_size, PthreadPoolClass** out_cls)
+{
+	struct __pthread_t* thread = NULL;
+	*out_cls = _pthreadPoolAlloc(stack_size, &thread);
+	return *out_cls ? thread : NULL;
+}
+
+static bool _inRange(const void* p, const void* mem, size_t size)
+{
+	return (const u8*)p >= (const u8*)mem && (const u8*)p < (const u8*)mem + size;
+}
+
+static void _testInvalid(void)
+{
+	// Misaligned storage or stack sizes are rejected
+	TEST_CHECK(!pthreadPoolAddClass(&s_smallSlots[0][4], 1, SMALL_STACK_SZ));
+	TEST_CHECK(!pthreadPoolAddClass(s_smallSlots, 1, SMALL_STACK_SZ+4));
+
+	// No classes means no slots
+	PthreadPoolClass* cls;
+	TEST_CHECK(!_alloc(SMALL_STACK_SZ, &cls));
+}
+
+static void _testBestFit(void)
+{
+	// Classes added in any order are searched from the smallest stack size up
+	TEST_CHECK(pthreadPoolGetSlotSize(SMALL_STACK_SZ) <= sizeof(s_smallSlots[0]));
+	TEST_CHECK(pthreadPoolGetSlotSize(LARGE_STACK_SZ) <= sizeof(s_largeSlots[0]));
+	TEST_CHECK(pthreadPoolAddClass(s_largeSlots, 1, LARGE_STACK_SZ));
+	TEST_CHECK(pthreadPoolAddClass(s_smallSlots, 2, SMALL_STACK_SZ));
+
+	PthreadPoolClass *cls1, *cls2, *cls3, *cls4;
+	struct __pthread_t* t1 = _alloc(0x100, &cls1);
+	struct __pthread_t* t2 = _alloc(SMALL_STACK_SZ, &cls2);
+	TEST_CHECK(t1 && t2 && t1 != t2);
+	TEST_CHECK(cls1 == cls2 && cls1->stack_size == SMALL_STACK_SZ);
+	TEST_CHECK(_inRange(t1, s_smallSlots, sizeof(s_smallSlots)));
+	TEST_CHECK(_inRange(t2, s_smallSlots, sizeof(s_smallSlots)));
+
+	// Once the best class is exhausted, larger classes are used
+	struct __pthread_t* t3 = _alloc(SMALL_STACK_SZ, &cls3);
+	TEST_CHECK(t3 && cls3->stack_size == LARGE_STACK_SZ);
+	TEST_CHECK(_inRange(t3, s_largeSlots, sizeof(s_largeSlots)));
+
+	// And when every fitting class is exhausted, the caller falls back to the heap
+	TEST_CHECK(!_alloc(SMALL_STACK_SZ, &cls4));
+	TEST_CHECK(!_alloc(LARGE_STACK_SZ+8, &cls4));
+
+	// Freed slots are reused
+	_pthreadPoolFree(cls2, t2);
+	TEST_CHECK(_alloc(SMALL_STACK_SZ, &cls4) == t2 && cls4 == cls2);
+	_pthreadPoolFree(cls3, t3);
+	TEST_CHECK(_alloc(LARGE_STACK_SZ, &cls4) == t3 && cls4 == cls3);
+	s_liveThread = t3;
+	s_liveCls = cls3;
+}
+
+static void _testAddWhileAlive(void)
+{
+	// Adding a class that sorts before the class of a live thread leaves the
+	// latter untouched, so the thread is returned to the right free list
+	TEST_CHECK(pthreadPoolGetSlotSize(MID_STACK_SZ) <= sizeof(s_midSlots[0]));
+	TEST_CHECK(pthreadPoolAddClass(s_midSlots, 1, MID_STACK_SZ));
+	TEST_CHECK(s_liveCls->stack_size == LARGE_STACK_SZ);
+
+	PthreadPoolClass* cls;
+	struct __pthread_t* t = _alloc(MID_STACK_SZ, &cls);
+	TEST_CHECK(t && cls != s_liveCls && cls->stack_size == MID_STACK_SZ);
+	TEST_CHECK(_inRange(t, s_midSlots, sizeof(s_midSlots)));
+
+	_pthreadPoolFree(s_liveCls, s_liveThread);
+	TEST_CHECK(_alloc(MID_STACK_SZ+8, &cls) == s_liveThread && cls == s_liveCls);
+	TEST_CHECK(!_alloc(MID_STACK_SZ, &cls));
+}
+
+static void _testMaxClasses(void)
+{
+	// The number of classes is bounded
+	unsigned added = 0;
+	for (unsigned i = 0; i < PTHREAD_POOL_MAX_CLASSES; i ++) {
+		added += pthreadPoolAddClass(s_extraSlots[i], 0, 8*(i+1));
+	}
+	TEST_CHECK(added == PTHREAD_POOL_MAX_CLASSES-3);
+}
+
+int main(void)
+{
+	_testInvalid();
+	_testBestFit();
+	_testAddWhileAlive();
+	_testMaxClasses();
+	return 0;
+}
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <string.h>
+#include <calico/system/mailbox.h>
+#include <calico/nds/pxi.h>
+#include <calico/nds/pxirpc.h>
+#include "../source/nds/pxi-priv.h"
+#include "test.h"
+
+// Software PXI loopback: requests are delivered to the mailbox of the remote
+// side in the same format as the receive interrupt handler does, and tagged
+// replies are routed to the tag table.
+
+#define TEST_CH PxiChannel_User0
+
+static Mailbox s_remoteMb;
+static u32 s_remoteMbSlots[PXI_RPC_MAILBOX_SLOTS];
+
+void pxiSendPacket(u32 packet)
+{
+	TEST_CHECK(pxiPacketIsRequest(packet));
+	TEST_CHECK(pxiPacketGetChannel(packet) == TEST_CH);
+	TEST_CHECK(mailboxTrySend(&s_remoteMb, pxiPacketGetImmediate(packet)));
+}
+
+void pxiSendExtPacket(u32 packet, const u32* data)
+{
+	unsigned num_words = pxiExtPacketGetNumWords(packet);
+	TEST_CHECK(pxiExtPacketGetChannel(packet) == TEST_CH);
+
+	if (pxiPacketIsResponse(packet)) {
+		TEST_CHECK(num_words == 1);
+		_pxiTagComplete(pxiExtPacketGetImmediate(packet), data[0]);
+		return;
+	}
+
+	TEST_CHECK(mailboxTrySend(&s_remoteMb, pxiExtPacketGetImmediate(packet) | (num_words << 26)));
+	for (unsigned i = 0; i < num_words; i ++) {
+		TEST_CHECK(mailboxTrySend(&s_remoteMb, data[i]));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Tagged requests
+//-----------------------------------------------------------------------------
+
+static int _taggedClientThread(void* arg)
+{
+	u32 value = (uptr)arg;
+	return pxiSendTaggedAndReceive(TEST_CH, value) == value*3;
+}
+
+static int _taggedDataClientThread(void* arg)
+{
+	u32 data[2] = { (uptr)arg, 0x12345678 };
+	return pxiSendWithDataTaggedAndReceive(TEST_CH, (uptr)arg, data, 2) == ~data[0];
+}
+
+static void _testTaggedOutOfOrder(void)
+{
+	// Replies sent in any order reach the thread that issued the request
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadStart(i, _taggedClientThread, (void*)(uptr)(0x1000*(i+1)), 0x10);
+	}
+
+	u32 msgs[3];
+	for (unsigned i = 0; i < 3; i ++) {
+		TEST_CHECK(mailboxTryRecv(&s_remoteMb, &msgs[i]));
+		TEST_CHECK((msgs[i] & 0x7fffff) == 0x1000*(i+1));
+	}
+	TEST_CHECK(pxiMsgGetTag(msgs[0]) != pxiMsgGetTag(msgs[1]));
+	TEST_CHECK(pxiMsgGetTag(msgs[1]) != pxiMsgGetTag(msgs[2]));
+	TEST_CHECK(pxiMsgGetTag(msgs[0]) != pxiMsgGetTag(msgs[2]));
+
+	for (int i = 2; i >= 0; i --) {
+		pxiReplyTagged(TEST_CH, pxiMsgGetTag(msgs[i]), (msgs[i] & 0x7fffff)*3);
+	}
+	for (unsigned i = 0; i < 3; i ++) {
+		TEST_CHECK(testThreadJoin(i) == 1);
+	}
+
+	// Extended requests carry the tag in their immediate
+	testThreadStart(0, _taggedDataClientThread, (void*)0x123, 0x10);
+	u32 msg, data[2];
+	TEST_CHECK(mailboxTryRecv(&s_remoteMb, &msg));
+	TEST_CHECK((msg >> 26) == 2 && (msg & 0x1fff) == 0x123);
+	TEST_CHECK(mailboxTryRecv(&s_remoteMb, &data[0]) && data[0] == 0x123);
+	TEST_CHECK(mailboxTryRecv(&s_remoteMb, &data[1]) && data[1] == 0x12345678);
+	pxiReplyTagged(TEST_CH, pxiMsgGetTag(msg), ~data[0]);
+	TEST_CHECK(testThreadJoin(0) == 1);
+}
+
+static void _testTaggedExhaustion(void)
+{
+	// Every tag is in use, so an additional request waits for one to be freed
+	unsigned tags[PXI_NUM_TAGS];
+	for (unsigned i = 0; i < PXI_NUM_TAGS; i ++) {
+		tags[i] = pxiBeginTaggedReceive();
+	}
+
+	testThreadStart(0, _taggedClientThread, (void*)0x42, 0x10);
+	TEST_CHECK(s_remoteMb.pending_slots == 0);
+
+	// Replies to tags that were not requested are ignored
+	pxiReplyTagged(TEST_CH, PXI_NUM_TAGS, 0);
+
+	pxiReplyTagged(TEST_CH, tags[3], 0xabcd);
+	TEST_CHECK(pxiEndTaggedReceive(tags[3]) == 0xabcd);
+
+	// The waiting thread took the freed tag and sent its request
+	u32 msg;
+	TEST_CHECK(mailboxTryRecv(&s_remoteMb, &msg));
+	TEST_CHECK(pxiMsgGetTag(msg) == tags[3]);
+	pxiReplyTagged(TEST_CH, tags[3], 0x42*3);
+	TEST_CHECK(testThreadJoin(0) == 1);
+
+	for (unsigned i = 0; i < PXI_NUM_TAGS; i ++) {
+		if (i != 3) {
+			pxiReplyTagged(TEST_CH, tags[i], i);
+			TEST_CHECK(pxiEndTaggedReceive(tags[i]) == i);
+		}
+	}
+
+	// Waiting on a tag that is not in use fails
+	TEST_CHECK(pxiEndTaggedReceive(tags[0]) == PXI_NO_REPLY);
+}
+
+//-----------------------------------------------------------------------------
+// Remote procedure calls
+//-----------------------------------------------------------------------------
+
+#define TEST_SERVICE(_, _x) \
+	_(_x, testAdd,   PXI_RPC_RET(u32), PXI_RPC_VAL(u32, a), PXI_RPC_VAL(u32, b)) \
+	_(_x, testFill,  PXI_RPC_VOID,     PXI_RPC_OUT(void*, buf, len), PXI_RPC_VAL(u32, len), PXI_RPC_VAL(u8, value)) \
+	_(_x, testSum,   PXI_RPC_RET(u32), PXI_RPC_IN(const u8*, buf, len), PXI_RPC_VAL(u32, len)) \
+	_(_x, testMagic, PXI_RPC_RET(u32)) \
+	_(_x, testSix,   PXI_RPC_RET(s32), PXI_RPC_VAL(s32, a), PXI_RPC_VAL(s32, b), PXI_RPC_VAL(s32, c), \
+		PXI_RPC_VAL(s32, d), PXI_RPC_VAL(s32, e), PXI_RPC_VAL(s32, f))
+
+static unsigned s_numCalls;
+static u8 s_buf[16];
+
+static u32 testAdd(u32 a, u32 b)
+{
+	s_numCalls ++;
+	return a + b;
+}
+
+static void testFill(void* buf, u32 len, u8 value)
+{
+	s_numCalls ++;
+	memset(buf, value, len);
+}
+
+static u32 testSum(const u8* buf, u32 len)
+{
+	u32 sum = 0;
+	s_numCalls ++;
+	for (u32 i = 0; i < len; i ++) {
+		sum += buf[i];
+	}
+	return sum;
+}
+
+static u32 testMagic(void)
+{
+	s_numCalls ++;
+	return 0x7c0ffee;
+}
+
+static s32 testSix(s32 a, s32 b, s32 c, s32 d, s32 e, s32 f)
+{
+	s_numCalls ++;
+	return a - b + c - d + e - f;
+}
+
+PXI_RPC_DEFINE_CLIENT(rpc_, TEST_CH, TEST_SERVICE)
+PXI_RPC_DEFINE_SERVER(s_testService, TEST_SERVICE);
+
+static int _serverThread(void* arg)
+{
+	for (;;) {
+		u32 msg = mailboxRecv(&s_remoteMb);
+		if (msg == UINT32_MAX) {
+			break;
+		}
+		pxiRpcDispatch(TEST_CH, &s_testService, &s_remoteMb, msg);
+	}
+	return 0;
+}
+
+static void _testRpc(void)
+{
+	testThreadStart(7, _serverThread, NULL, 0x10);
+
+	// Parameters and return values are marshalled in order
+	TEST_CHECK(rpc_testAdd(40, 2) == 42);
+	TEST_CHECK(rpc_testMagic() == 0x7c0ffee);
+	TEST_CHECK(rpc_testSix(100, 1, 20, 2, 3, 4) == 116);
+	TEST_CHECK(rpc_testSix(-1, -2, -3, -4, -5, -6) == 3);
+
+	// Buffers are passed by address
+	rpc_testFill(s_buf, sizeof(s_buf), 0x5a);
+	for (unsigned i = 0; i < sizeof(s_buf); i ++) {
+		TEST_CHECK(s_buf[i] == 0x5a);
+	}
+	TEST_CHECK(rpc_testSum(s_buf, 4) == 4*0x5a);
+	TEST_CHECK(s_numCalls == 6);
+
+	// Unknown procedures are replied to with zero
+	u32 data = 1;
+	TEST_CHECK(pxiSendWithDataTaggedAndReceive(TEST_CH, s_testService.num_fns, &data, 1) == 0);
+	TEST_CHECK(pxiSendTaggedAndReceive(TEST_CH, 0x1234) == 0);
+	TEST_CHECK(s_numCalls == 6);
+
+	mailboxTrySend(&s_remoteMb, UINT32_MAX);
+	testThreadJoin(7);
+}
+
+static int _sixClientThread(void* arg)
+{
+	s32 i = (s32)(uptr)arg;
+	return rpc_testSix(i, 1, 2, 3, 4, 5) == i - 3;
+}
+
+static void _testRpcAllTags(void)
+{
+	// Calls with the most parameters from every tag fit in the mailbox at once
+	for (unsigned i = 0; i < PXI_NUM_TAGS; i ++) {
+		testThreadStart(i, _sixClientThread, (void*)(uptr)(100*i), 0x10);
+	}
+	TEST_CHECK(s_remoteMb.pending_slots == PXI_NUM_TAGS*7);
+
+	for (unsigned i = 0; i < PXI_NUM_TAGS; i ++) {
+		pxiRpcDispatch(TEST_CH, &s_testService, &s_remoteMb, mailboxRecv(&s_remoteMb));
+	}
+	for (unsigned i = 0; i < PXI_NUM_TAGS; i ++) {
+		TEST_CHECK(testThreadJoin(i) == 1);
+	}
+}
+
+int main(void)
+{
+	mailboxPrepare(&s_remoteMb, s_remoteMbSlots, sizeof(s_remoteMbSlots)/sizeof(u32));
+
+	_testTaggedOutOfOrder();
+	_testTaggedExhaustion();
+	_testRpc();
+	_testRpcAllTags();
+	return 0;
+}
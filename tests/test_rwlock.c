@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/rwlock.h>
+#include "test.h"
+
+static TestLog s_log;
+static RwLock s_rwlock;
+static unsigned s_inside, s_maxInside;
+
+static int _readerThread(void* arg)
+{
+	rwlockReadLock(&s_rwlock);
+	if (++s_inside > s_maxInside) {
+		s_maxInside = s_inside;
+	}
+	threadSleepTicks(20);
+	s_inside --;
+	testLogPush(&s_log, (int)(uptr)arg);
+	rwlockReadUnlock(&s_rwlock);
+	return 0;
+}
+
+static int _writerThread(void* arg)
+{
+	rwlockWriteLock(&s_rwlock);
+	TEST_CHECK(s_inside == 0);
+	TEST_CHECK(rwlockIsWriteLockedByCurrentThread(&s_rwlock));
+	testLogPush(&s_log, (int)(uptr)arg);
+	threadSleepTicks(5);
+	rwlockWriteUnlock(&s_rwlock);
+	return 0;
+}
+
+static int _lowReaderThread(void* arg)
+{
+	rwlockReadLock(&s_rwlock);
+	testSpinTicks(1000);
+	testLogPush(&s_log, (int)(uptr)arg);
+	rwlockReadUnlock(&s_rwlock);
+	return 0;
+}
+
+static int _highWriterThread(void* arg)
+{
+	threadSleepTicks(5);
+	rwlockWriteLock(&s_rwlock);
+	testLogPush(&s_log, (int)(uptr)arg);
+	rwlockWriteUnlock(&s_rwlock);
+	return 0;
+}
+
+static int _midSpinThread(void* arg)
+{
+	threadSleepTicks(6);
+	testSpinTicks(5000);
+	testLogPush(&s_log, (int)(uptr)arg);
+	return 0;
+}
+
+static int _writeTimeoutThread(void* arg)
+{
+	bool ok = rwlockWriteLockTimeout(&s_rwlock, 30);
+	if (ok) {
+		rwlockWriteUnlock(&s_rwlock);
+	}
+	return ok;
+}
+
+static int _readTimeoutThread(void* arg)
+{
+	bool ok = rwlockReadLockTimeout(&s_rwlock, 30);
+	if (ok) {
+		rwlockReadUnlock(&s_rwlock);
+	}
+	return ok;
+}
+
+static void _testConcurrentReaders(void)
+{
+	// Readers hold the lock simultaneously
+	s_log.count = 0;
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadStart(i, _readerThread, (void*)(uptr)(i+1), 0x20);
+	}
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(s_maxInside == 3);
+	TEST_CHECK(s_log.count == 3);
+	TEST_CHECK(!s_rwlock.readers && !s_rwlock.owner);
+}
+
+static void _testWriterPreference(void)
+{
+	// A waiting writer excludes readers, and new readers queue up behind it
+	s_log.count = 0;
+	testThreadStart(0, _readerThread, (void*)1, 0x20);
+	threadSleepTicks(1);
+	testThreadStart(1, _writerThread, (void*)2, 0x20);
+	threadSleepTicks(1);
+	testThreadStart(2, _readerThread, (void*)3, 0x20);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 3));
+}
+
+static void _testPriorityInheritance(void)
+{
+	// A low priority reader is boosted by a high priority writer, preempting a medium priority spinner
+	s_log.count = 0;
+	testThreadStart(0, _lowReaderThread, (void*)1, 0x30);
+	testThreadStart(1, _highWriterThread, (void*)2, 0x10);
+	testThreadStart(2, _midSpinThread, (void*)3, 0x20);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 3));
+	TEST_CHECK(threadGetSelf()->prio == MAIN_THREAD_PRIO);
+}
+
+static void _testTimeouts(void)
+{
+	// Writers time out while a reader holds the lock, without leaving stale state
+	rwlockReadLock(&s_rwlock);
+	testThreadStart(0, _writeTimeoutThread, NULL, 0x10);
+	TEST_CHECK(testThreadJoin(0) == 0);
+	TEST_CHECK(s_rwlock.wwait == 0);
+	TEST_CHECK(rwlockTryReadLock(&s_rwlock));
+	rwlockReadUnlock(&s_rwlock);
+	TEST_CHECK(!rwlockTryWriteLock(&s_rwlock));
+	rwlockReadUnlock(&s_rwlock);
+
+	// Readers time out while a writer holds the lock
+	rwlockWriteLock(&s_rwlock);
+	testThreadStart(0, _readTimeoutThread, NULL, 0x10);
+	TEST_CHECK(testThreadJoin(0) == 0);
+	TEST_CHECK(!rwlockTryReadLock(&s_rwlock));
+	rwlockWriteUnlock(&s_rwlock);
+
+	// And succeed once it is free
+	testThreadStart(0, _readTimeoutThread, NULL, 0x10);
+	TEST_CHECK(testThreadJoin(0) == 1);
+	TEST_CHECK(rwlockTryWriteLock(&s_rwlock));
+	rwlockWriteUnlock(&s_rwlock);
+	TEST_CHECK(!s_rwlock.readers && !s_rwlock.owner);
+}
+
+int main(void)
+{
+	_testConcurrentReaders();
+	_testWriterPreference();
+	_testPriorityInheritance();
+	_testTimeouts();
+	return 0;
+}
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include "test.h"
+
+static TestLog s_log;
+
+static int _logThread(void* arg)
+{
+	testLogPush(&s_log, (int)(uptr)arg);
+	return 0;
+}
+
+static int _yieldThread(void* arg)
+{
+	for (unsigned i = 0; i < 3; i ++) {
+		testLogPush(&s_log, (int)(uptr)arg);
+		threadYield();
+	}
+	return 0;
+}
+
+static int _reprioThread(void* arg)
+{
+	testLogPush(&s_log, (int)(uptr)arg);
+	threadSetPrio(threadGetSelf(), 0x30);
+	testLogPush(&s_log, (int)(uptr)arg + 10);
+	return 0;
+}
+
+static void _testPriorityOrder(void)
+{
+	// Lower priority threads do not run until main blocks, then run by priority
+	s_log.count = 0;
+	testThreadStart(0, _logThread, (void*)3, 0x30);
+	testThreadStart(1, _logThread, (void*)1, 0x20);
+	testThreadStart(2, _logThread, (void*)4, 0x3f);
+	testThreadStart(3, _logThread, (void*)2, 0x21);
+	TEST_CHECK(s_log.count == 0);
+
+	for (unsigned i = 0; i < 4; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 3, 4));
+
+	// Higher priority threads preempt main as soon as they are started
+	s_log.count = 0;
+	testThreadStart(0, _logThread, (void*)1, MAIN_THREAD_PRIO-1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1));
+	testThreadJoin(0);
+
+	// Priorities in both halves of the ready bitmap
+	s_log.count = 0;
+	testThreadStart(0, _logThread, (void*)3, 0x3e);
+	testThreadStart(1, _logThread, (void*)2, 0x1f);
+	testThreadStart(2, _logThread, (void*)1, 0x1d);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 3));
+}
+
+static void _testFifoWithinPriority(void)
+{
+	s_log.count = 0;
+	for (unsigned i = 0; i < 5; i ++) {
+		testThreadStart(i, _logThread, (void*)(uptr)i, 0x28);
+	}
+	for (unsigned i = 0; i < 5; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0, 1, 2, 3, 4));
+}
+
+static void _testYield(void)
+{
+	// Yielding moves a thread to the tail of its band, interleaving equal priority threads
+	s_log.count = 0;
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadStart(i, _yieldThread, (void*)(uptr)i, 0x28);
+	}
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 0, 1, 2, 0, 1, 2, 0, 1, 2));
+}
+
+static void _testSetPrio(void)
+{
+	// Lowering the priority of the running thread lets other threads run first
+	s_log.count = 0;
+	testThreadStart(0, _reprioThread, (void*)1, 0x20);
+	testThreadStart(1, _logThread, (void*)2, 0x28);
+	testThreadJoin(0);
+	testThreadJoin(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 11));
+
+	// Raising the priority of a ready thread moves it ahead of the others
+	s_log.count = 0;
+	testThreadStart(0, _logThread, (void*)2, 0x28);
+	testThreadStart(1, _logThread, (void*)1, 0x30);
+	threadSetPrio(&s_testThread[1], 0x20);
+	testThreadJoin(0);
+	testThreadJoin(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2));
+}
+
+static void _testPause(void)
+{
+	s_log.count = 0;
+	testThreadStart(0, _logThread, (void*)1, 0x20);
+	threadPause(&s_testThread[0]);
+	testThreadStart(1, _logThread, (void*)2, 0x28);
+	testThreadJoin(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2));
+
+	threadStart(&s_testThread[0]);
+	testThreadJoin(0);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 1));
+}
+
+int main(void)
+{
+	_testPriorityOrder();
+	_testFifoWithinPriority();
+	_testYield();
+	_testSetPrio();
+	_testPause();
+	return 0;
+}
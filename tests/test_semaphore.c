@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/semaphore.h>
+#include <calico/system/eventgroup.h>
+#include "test.h"
+
+static TestLog s_log;
+static Semaphore s_sema;
+static EventGroup s_event;
+
+static int _semaThread(void* arg)
+{
+	semaphoreWait(&s_sema);
+	testLogPush(&s_log, (int)(uptr)arg);
+	return 0;
+}
+
+static int _eventThread(void* arg)
+{
+	unsigned mode = (uptr)arg;
+	u32 flags = eventGroupWait(&s_event, 3, mode);
+	testLogPush(&s_log, flags);
+	return flags;
+}
+
+static void _testSemaphoreCount(void)
+{
+	// Units are consumed without blocking while available
+	semaphorePrepare(&s_sema, 2);
+	TEST_CHECK(semaphoreTryWait(&s_sema));
+	semaphoreWait(&s_sema);
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 0);
+	TEST_CHECK(!semaphoreTryWait(&s_sema));
+	TEST_CHECK(!semaphoreWaitTimeout(&s_sema, 10));
+
+	// Signalling without waiters accumulates units
+	semaphoreSignal(&s_sema);
+	semaphoreSignal(&s_sema);
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 2);
+	TEST_CHECK(semaphoreWaitTimeout(&s_sema, 10));
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 1);
+}
+
+static void _testSemaphoreHandoff(void)
+{
+	// Waiters are woken up in priority order, and units are handed to them directly
+	s_log.count = 0;
+	semaphorePrepare(&s_sema, 0);
+	testThreadStart(0, _semaThread, (void*)1, 0x30);
+	testThreadStart(1, _semaThread, (void*)2, 0x20);
+	testThreadStart(2, _semaThread, (void*)3, 0x28);
+	threadSleepTicks(1);
+
+	semaphoreSignal(&s_sema);
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 0);
+	threadSleepTicks(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2));
+
+	// A unit handed to a waiter cannot be stolen by a thread calling TryWait
+	semaphoreSignal(&s_sema);
+	TEST_CHECK(!semaphoreTryWait(&s_sema));
+	semaphoreSignal(&s_sema);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 3, 1));
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 0);
+}
+
+static void _testSemaphoreTimeout(void)
+{
+	// A timed out waiter does not consume a later unit
+	semaphorePrepare(&s_sema, 0);
+	u32 start = tickGetCount();
+	TEST_CHECK(!semaphoreWaitTimeout(&s_sema, 20));
+	TEST_CHECK(tickGetCount() - start >= 20);
+	semaphoreSignal(&s_sema);
+	TEST_CHECK(semaphoreGetCount(&s_sema) == 1);
+}
+
+static void _testEventGroupAny(void)
+{
+	// Flags that are already set satisfy the wait immediately
+	eventGroupPrepare(&s_event, 1);
+	TEST_CHECK(eventGroupWait(&s_event, 3, EVENT_WAIT_ANY) == 1);
+	TEST_CHECK(eventGroupGet(&s_event) == 1);
+	TEST_CHECK(eventGroupWait(&s_event, 3, EVENT_WAIT_ANY | EVENT_WAIT_CLEAR) == 1);
+	TEST_CHECK(eventGroupGet(&s_event) == 0);
+	TEST_CHECK(eventGroupWaitTimeout(&s_event, 3, EVENT_WAIT_ANY, 10) == 0);
+
+	// Any waiters are woken up by a single flag, and see the flags in the mask
+	testThreadStart(0, _eventThread, (void*)EVENT_WAIT_ANY, 0x20);
+	testThreadStart(1, _eventThread, (void*)EVENT_WAIT_ANY, 0x28);
+	threadSleepTicks(1);
+	eventGroupSet(&s_event, 2 | 4);
+	TEST_CHECK(testThreadJoin(0) == 2);
+	TEST_CHECK(testThreadJoin(1) == 2);
+	TEST_CHECK(eventGroupGet(&s_event) == (2 | 4));
+}
+
+static void _testEventGroupAll(void)
+{
+	// All waiters only wake up once every flag in the mask is set
+	s_log.count = 0;
+	eventGroupPrepare(&s_event, 0);
+	testThreadStart(0, _eventThread, (void*)(EVENT_WAIT_ALL | EVENT_WAIT_CLEAR), 0x20);
+	threadSleepTicks(1);
+	eventGroupSet(&s_event, 1);
+	threadSleepTicks(1);
+	TEST_CHECK(s_log.count == 0);
+	eventGroupSet(&s_event, 2 | 4);
+	TEST_CHECK(testThreadJoin(0) == 3);
+
+	// Only the flags that satisfied the wait were cleared
+	TEST_CHECK(eventGroupGet(&s_event) == 4);
+	eventGroupClear(&s_event, 4);
+	TEST_CHECK(eventGroupGet(&s_event) == 0);
+}
+
+static void _testEventGroupClearWakesOne(void)
+{
+	// A clearing waiter consumes the flags before lower priority waiters see them
+	s_log.count = 0;
+	eventGroupPrepare(&s_event, 0);
+	testThreadStart(0, _eventThread, (void*)(EVENT_WAIT_ANY | EVENT_WAIT_CLEAR), 0x20);
+	testThreadStart(1, _eventThread, (void*)(EVENT_WAIT_ANY | EVENT_WAIT_CLEAR), 0x28);
+	threadSleepTicks(1);
+	eventGroupSet(&s_event, 1);
+	TEST_CHECK(testThreadJoin(0) == 1);
+	threadSleepTicks(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1));
+	eventGroupSet(&s_event, 2);
+	TEST_CHECK(testThreadJoin(1) == 2);
+	TEST_CHECK(eventGroupGet(&s_event) == 0);
+}
+
+int main(void)
+{
+	_testSemaphoreCount();
+	_testSemaphoreHandoff();
+	_testSemaphoreTimeout();
+	_testEventGroupAny();
+	_testEventGroupAll();
+	_testEventGroupClearWakesOne();
+	return 0;
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/gba/timer.h>
+#include "test.h"
+
+static TestLog s_log;
+
+// The tick task timer (timer 3) is switched off once no tick task is pending
+MK_INLINE bool _tickTasksPending(void)
+{
+	threadSleepTicks(200);
+	return (REG_TMxCNT_H(3) & TIMER_ENABLE) != 0;
+}
+
+static int _workerThread(void* arg)
+{
+	for (unsigned i = 0; i < 3; i ++) {
+		testLogPush(&s_log, (int)(uptr)arg);
+		testSpinTicks(100);
+	}
+	return 0;
+}
+
+static void _testPrioQuantum(void)
+{
+	// Each thread runs for 150 ticks at a time, i.e. one and a half iterations
+	s_log.count = 0;
+	threadSetPrioQuantum(0x28, 150);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadStart(i, _workerThread, (void*)(uptr)(i+1), 0x28);
+	}
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	// (the first quantum is not enforced, as the slice task started while main was running)
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 1, 1, 2, 2, 3, 3, 2, 3));
+	TEST_CHECK(_tickTasksPending());
+
+	threadSetPrioQuantum(0x28, 0);
+	TEST_CHECK(!_tickTasksPending());
+
+	// Without a quantum, threads run to completion
+	s_log.count = 0;
+	for (unsigned i = 0; i < 2; i ++) {
+		testThreadStart(i, _workerThread, (void*)(uptr)(i+1), 0x28);
+	}
+	for (unsigned i = 0; i < 2; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 1, 1, 2, 2, 2));
+}
+
+static void _testThreadQuantum(void)
+{
+	// Only the thread with a quantum gives up the CPU early
+	s_log.count = 0;
+	testThreadStart(0, _workerThread, (void*)1, 0x28);
+	testThreadStart(1, _workerThread, (void*)2, 0x28);
+	threadSetQuantum(&s_testThread[0], 50);
+	testThreadJoin(0);
+	testThreadJoin(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 1, 2, 2, 2, 1, 1));
+
+	// The exited thread released its quantum
+	TEST_CHECK(!_tickTasksPending());
+}
+
+int main(void)
+{
+	_testPrioQuantum();
+	_testThreadQuantum();
+	return 0;
+}
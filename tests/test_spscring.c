@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <string.h>
+#include <calico/system/irq.h>
+#include <calico/system/spscring.h>
+#include "test.h"
+
+#define NUM_RECORDS 100
+
+typedef struct TestRecord {
+	u32 a, b, c;
+} TestRecord;
+
+static SpscRing s_ring;
+static u8 s_ringBuf[64];
+static unsigned s_produced, s_consumed, s_bad;
+
+static int _consumerThread(void* arg)
+{
+	for (unsigned i = 0; i < NUM_RECORDS; i ++) {
+		TestRecord rec;
+		spscRingPopWait(&s_ring, &rec, sizeof(rec));
+		if (rec.a != i || rec.b != i*2 || rec.c != ~i) {
+			s_bad ++;
+		}
+		s_consumed ++;
+	}
+	return 0;
+}
+
+static int _streamThread(void* arg)
+{
+	u8 buf[7];
+	unsigned total = 0;
+	while (total < 200) {
+		size_t sz = spscRingReadWait(&s_ring, buf, sizeof(buf));
+		TEST_CHECK(sz >= 1 && sz <= sizeof(buf));
+		for (size_t i = 0; i < sz; i ++) {
+			if (buf[i] != (u8)(total + i)) {
+				s_bad ++;
+			}
+		}
+		total += sz;
+	}
+	return 0;
+}
+
+static void _timerIsr(void)
+{
+	TestRecord rec = { s_produced, s_produced*2, ~s_produced };
+	if (spscRingPush(&s_ring, &rec, sizeof(rec))) {
+		s_produced ++;
+	}
+}
+
+static void _testByteStream(void)
+{
+	// Data survives wrapping around the end of the buffer
+	u8 in[40], out[50];
+	for (unsigned i = 0; i < sizeof(in); i ++) {
+		in[i] = i;
+	}
+
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	for (unsigned k = 0; k < 10; k ++) {
+		TEST_CHECK(spscRingWrite(&s_ring, in, sizeof(in)) == sizeof(in));
+		TEST_CHECK(spscRingGetUsed(&s_ring) == sizeof(in));
+		TEST_CHECK(spscRingRead(&s_ring, out, sizeof(out)) == sizeof(in));
+		TEST_CHECK(memcmp(in, out, sizeof(in)) == 0);
+	}
+
+	// Writes are truncated when the ring fills up, and reads when it empties
+	TEST_CHECK(spscRingWrite(&s_ring, in, sizeof(in)) == sizeof(in));
+	TEST_CHECK(spscRingWrite(&s_ring, in, sizeof(in)) == sizeof(s_ringBuf)-sizeof(in));
+	TEST_CHECK(spscRingGetFree(&s_ring) == 0);
+	TEST_CHECK(spscRingRead(&s_ring, out, sizeof(out)) == sizeof(out));
+	TEST_CHECK(spscRingRead(&s_ring, out, sizeof(out)) == sizeof(s_ringBuf)-sizeof(out));
+	TEST_CHECK(spscRingRead(&s_ring, out, sizeof(out)) == 0);
+}
+
+static void _testRecords(void)
+{
+	// Records are transferred as a whole or not at all
+	TestRecord rec = { 1, 2, 3 }, out;
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	TEST_CHECK(!spscRingPop(&s_ring, &out, sizeof(out)));
+	for (unsigned i = 0; i < sizeof(s_ringBuf)/sizeof(rec); i ++) {
+		TEST_CHECK(spscRingPush(&s_ring, &rec, sizeof(rec)));
+	}
+	TEST_CHECK(!spscRingPush(&s_ring, &rec, sizeof(rec)));
+	TEST_CHECK(spscRingGetUsed(&s_ring) == 5*sizeof(rec));
+
+	u8 partial[2];
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	spscRingWrite(&s_ring, partial, sizeof(partial));
+	TEST_CHECK(!spscRingPop(&s_ring, &out, sizeof(out)));
+	TEST_CHECK(spscRingGetUsed(&s_ring) == sizeof(partial));
+}
+
+static void _testIrqProducer(void)
+{
+	// An interrupt handler feeds a blocked consumer thread
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	irqSet(IRQ_TIMER0, _timerIsr);
+	irqEnable(IRQ_TIMER0);
+
+	testThreadStart(0, _consumerThread, NULL, 0x10);
+	while (s_consumed < NUM_RECORDS) {
+		hostSimRaiseIrq(IRQ_TIMER0);
+	}
+	testThreadJoin(0);
+	TEST_CHECK(s_produced == NUM_RECORDS);
+	TEST_CHECK(s_bad == 0);
+
+	irqDisable(IRQ_TIMER0);
+}
+
+static void _testStreamConsumer(void)
+{
+	// A blocked byte stream reader wakes up as soon as any data is available
+	spscRingPrepare(&s_ring, s_ringBuf, sizeof(s_ringBuf));
+	testThreadStart(0, _streamThread, NULL, 0x10);
+	for (unsigned i = 0; i < 200; i += 5) {
+		u8 buf[5];
+		for (unsigned j = 0; j < sizeof(buf); j ++) {
+			buf[j] = i + j;
+		}
+		TEST_CHECK(spscRingWrite(&s_ring, buf, sizeof(buf)) == sizeof(buf));
+	}
+	testThreadJoin(0);
+	TEST_CHECK(s_bad == 0);
+}
+
+int main(void)
+{
+	_testByteStream();
+	_testRecords();
+	_testIrqProducer();
+	_testStreamConsumer();
+	return 0;
+}
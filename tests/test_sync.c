@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mutex.h>
+#include <calico/system/condvar.h>
+#include <calico/system/mailbox.h>
+#include "test.h"
+
+static TestLog s_log;
+static Mutex s_mutex;
+static CondVar s_condvar;
+static bool s_ready;
+static Mailbox s_mailbox;
+static u32 s_mailboxSlots[4];
+
+static int _condvarThread(void* arg)
+{
+	mutexLock(&s_mutex);
+	while (!s_ready) {
+		condvarWait(&s_condvar, &s_mutex);
+	}
+	testLogPush(&s_log, (int)(uptr)arg);
+	mutexUnlock(&s_mutex);
+	return 0;
+}
+
+static int _recvThread(void* arg)
+{
+	u32 msg = mailboxRecv(&s_mailbox);
+	testLogPush(&s_log, (int)(uptr)arg*10 + msg);
+	return 0;
+}
+
+static void _testCondVarSignal(void)
+{
+	// Signal wakes up the highest priority waiter, which sees the updated state
+	s_log.count = 0;
+	s_ready = false;
+	testThreadStart(0, _condvarThread, (void*)1, 0x30);
+	testThreadStart(1, _condvarThread, (void*)2, 0x20);
+	testThreadStart(2, _condvarThread, (void*)3, 0x28);
+	threadSleepTicks(1);
+
+	mutexLock(&s_mutex);
+	s_ready = true;
+	condvarSignal(&s_condvar);
+	mutexUnlock(&s_mutex);
+	threadSleepTicks(1);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2));
+
+	// Broadcast wakes up the rest
+	mutexLock(&s_mutex);
+	condvarBroadcast(&s_condvar);
+	mutexUnlock(&s_mutex);
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 2, 3, 1));
+}
+
+static void _testCondVarNoWaiters(void)
+{
+	// Signalling without waiters has no lasting effect
+	condvarSignal(&s_condvar);
+	condvarBroadcast(&s_condvar);
+	mutexLock(&s_mutex);
+	TEST_CHECK(!condvarWaitTimeout(&s_condvar, &s_mutex, 10));
+	mutexUnlock(&s_mutex);
+}
+
+static void _testMailboxWakeup(void)
+{
+	// Messages are delivered in order to receivers in priority order
+	s_log.count = 0;
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+	testThreadStart(0, _recvThread, (void*)1, 0x30);
+	testThreadStart(1, _recvThread, (void*)2, 0x20);
+	testThreadStart(2, _recvThread, (void*)3, 0x28);
+	threadSleepTicks(1);
+
+	for (unsigned i = 1; i <= 3; i ++) {
+		TEST_CHECK(mailboxTrySend(&s_mailbox, i));
+	}
+	for (unsigned i = 0; i < 3; i ++) {
+		testThreadJoin(i);
+	}
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 21, 32, 13));
+}
+
+static void _testMailboxCapacity(void)
+{
+	u32 msg;
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+	for (unsigned i = 0; i < 4; i ++) {
+		TEST_CHECK(mailboxTrySend(&s_mailbox, i));
+	}
+	TEST_CHECK(!mailboxTrySend(&s_mailbox, 4));
+
+	for (unsigned i = 0; i < 4; i ++) {
+		TEST_CHECK(mailboxTryRecv(&s_mailbox, &msg) && msg == i);
+	}
+	TEST_CHECK(!mailboxTryRecv(&s_mailbox, &msg));
+}
+
+static void _irqSendHandler(void)
+{
+	mailboxTrySend(&s_mailbox, 5);
+}
+
+static void _testMailboxFromIrq(void)
+{
+	// Messages sent from interrupt handlers wake up waiting threads
+	s_log.count = 0;
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+	irqSet(IRQ_VBLANK, _irqSendHandler);
+	irqEnable(IRQ_VBLANK);
+
+	testThreadStart(0, _recvThread, (void*)1, 0x10);
+	hostSimRaiseIrq(IRQ_VBLANK);
+	TEST_CHECK(TEST_LOG_EQUALS(&s_log, 15));
+	testThreadJoin(0);
+
+	irqDisable(IRQ_VBLANK);
+	irqClear(IRQ_VBLANK);
+}
+
+int main(void)
+{
+	_testCondVarSignal();
+	_testCondVarNoWaiters();
+	_testMailboxWakeup();
+	_testMailboxCapacity();
+	_testMailboxFromIrq();
+	return 0;
+}
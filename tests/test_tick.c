@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/irq.h>
+#include "test.h"
+
+#define NUM_TASKS 64
+
+typedef struct TestTask {
+	TickTask task;
+	u64 target;
+	u64 fired;
+	unsigned count;
+} TestTask;
+
+static TestTask s_tasks[NUM_TASKS];
+static unsigned s_numFired;
+
+static void _taskFn(TickTask* t)
+{
+	TestTask* tt = (TestTask*)t;
+	if (!tt->count) {
+		tt->fired = tickGetCount();
+		s_numFired ++;
+	}
+	tt->count ++;
+}
+
+static void _startTask(TestTask* tt, u32 delay, u32 period)
+{
+	tt->target = tickGetCount() + delay;
+	tt->fired = 0;
+	tt->count = 0;
+	tickTaskStart(&tt->task, _taskFn, delay, period);
+}
+
+MK_INLINE bool _firedOnTime(const TestTask* tt)
+{
+	return tt->count && tt->fired >= tt->target && tt->fired <= tt->target + 1;
+}
+
+static void _testWheelLevels(void)
+{
+	// Delays straddling every level of the wheel, plus delays past its range
+	static const u32 delays[] = {
+		1, 2, 31, 32, 33, 1023, 1024, 1025, 32767, 32768, 40000,
+		(1U<<20)-1, 1U<<20, (1U<<20)+5, 3000000,
+	};
+	const unsigned num = sizeof(delays)/sizeof(delays[0]);
+
+	s_numFired = 0;
+	for (unsigned i = 0; i < num; i ++) {
+		_startTask(&s_tasks[i], delays[num-1-i], 0);
+	}
+
+	threadSleepTicks(3000000 + 10);
+	TEST_CHECK(s_numFired == num);
+	for (unsigned i = 0; i < num; i ++) {
+		TEST_CHECK(_firedOnTime(&s_tasks[i]));
+		TEST_CHECK(s_tasks[i].count == 1);
+	}
+}
+
+static void _testRandomOrder(void)
+{
+	u32 seed = 12345;
+	u32 max_delay = 0;
+
+	s_numFired = 0;
+	for (unsigned i = 0; i < NUM_TASKS; i ++) {
+		seed = seed*1103515245 + 12345;
+		u32 delay = 1 + ((seed >> 8) % 100000);
+		if (delay > max_delay) {
+			max_delay = delay;
+		}
+		_startTask(&s_tasks[i], delay, 0);
+
+		// Let time pass between insertions, so that tasks land in different wheel positions
+		threadSleepTicks(seed & 0x3f);
+	}
+
+	threadSleepTicks(max_delay + 10);
+	TEST_CHECK(s_numFired == NUM_TASKS);
+	for (unsigned i = 0; i < NUM_TASKS; i ++) {
+		TEST_CHECK(_firedOnTime(&s_tasks[i]));
+	}
+}
+
+static void _testStop(void)
+{
+	// Stopped tasks never fire, while the others are unaffected
+	s_numFired = 0;
+	for (unsigned i = 0; i < 8; i ++) {
+		_startTask(&s_tasks[i], 100 + i*1000, 0);
+	}
+	for (unsigned i = 0; i < 8; i += 2) {
+		tickTaskStop(&s_tasks[i].task);
+	}
+
+	threadSleepTicks(10000);
+	for (unsigned i = 0; i < 8; i ++) {
+		TEST_CHECK((i & 1) ? _firedOnTime(&s_tasks[i]) : !s_tasks[i].count);
+	}
+
+	// Stopping an inactive task is harmless
+	tickTaskStop(&s_tasks[0].task);
+	tickTaskStop(&s_tasks[1].task);
+}
+
+static void _testPeriodic(void)
+{
+	TestTask* tt = &s_tasks[0];
+	_startTask(tt, 500, 250);
+	threadSleepTicks(500 + 250*10 + 100);
+	tickTaskStop(&tt->task);
+	TEST_CHECK(_firedOnTime(tt));
+	TEST_CHECK(tt->count == 11);
+
+	// Periodic thread timers do not drift
+	static TickTask timer;
+	threadTimerStartTicks(&timer, 1000);
+	u64 start = tickGetCount();
+	for (unsigned i = 0; i < 10; i ++) {
+		threadTimerWait(&timer);
+	}
+	tickTaskStop(&timer);
+	u64 elapsed = tickGetCount() - start;
+	TEST_CHECK(elapsed >= 10000 && elapsed <= 10001);
+}
+
+static int _sleepThread(void* arg)
+{
+	threadSleepTicks((u32)(uptr)arg);
+	return 0;
+}
+
+static void _testSleepOrder(void)
+{
+	static const u32 delays[] = { 5000, 10, 70000, 40, 2000000 };
+	u64 start = tickGetCount();
+	for (unsigned i = 0; i < 5; i ++) {
+		testThreadStart(i, _sleepThread, (void*)(uptr)delays[i], 0x20);
+	}
+
+	// Each join returns when its sleeper wakes up
+	TEST_CHECK(testThreadJoin(1) == 0 && tickGetCount() - start <= 11);
+	TEST_CHECK(testThreadJoin(3) == 0 && tickGetCount() - start <= 41);
+	TEST_CHECK(testThreadJoin(0) == 0 && tickGetCount() - start <= 5001);
+	TEST_CHECK(testThreadJoin(2) == 0 && tickGetCount() - start <= 70001);
+	TEST_CHECK(testThreadJoin(4) == 0 && tickGetCount() - start >= 2000000);
+	TEST_CHECK(tickGetCount() - start <= 2000001);
+}
+
+static u64 s_nestedCount;
+alignas(8) static u8 s_nestStack[1024];
+
+static void _keypadIsr(void)
+{
+	s_nestedCount = tickGetCount();
+}
+
+static void _testNestedRead(void)
+{
+	// A higher priority ISR taken right as the counter wraps around sees the
+	// wraparound, even though the counter ISR was dispatched first
+	irqEnableNesting(&s_nestStack[sizeof(s_nestStack)]);
+	irqSetPrio(IRQ_KEYPAD, IRQ_PRIO_HIGHEST);
+	irqSet(IRQ_KEYPAD, _keypadIsr);
+	irqEnable(IRQ_KEYPAD);
+
+	for (unsigned i = 0; i < 3; i ++) {
+		u64 start = tickGetCount();
+		u32 delay = 0x10000 - (u16)start;
+
+		ArmIrqState st = armIrqLockByPsr();
+		testSpinTicks(delay);
+		REG_IF |= IRQ_KEYPAD;
+		armIrqUnlockByPsr(st);
+
+		TEST_CHECK(s_nestedCount >= start + delay);
+		TEST_CHECK(tickGetCount() >= s_nestedCount);
+	}
+
+	irqDisable(IRQ_KEYPAD);
+	irqSetPrio(IRQ_KEYPAD, IRQ_PRIO_DEFAULT);
+	irqEnableNesting(NULL);
+}
+
+static void _outerIsr(void)
+{
+	hostSimAdvance(100*TEST_CYCLES_PER_TICK);
+	hostSimRaiseIrq(IRQ_KEYPAD);
+	hostSimAdvance(100*TEST_CYCLES_PER_TICK);
+}
+
+static void _innerIsr(void)
+{
+	hostSimAdvance(200*TEST_CYCLES_PER_TICK);
+}
+
+static void _testNestedStats(void)
+{
+	// Time spent in a nested handler is accounted once, as part of the
+	// outermost handler, rather than restarting the measurement
+	SchedStats before, after;
+	if (!schedGetStats(&before)) {
+		return;
+	}
+
+	irqEnableNesting(&s_nestStack[sizeof(s_nestStack)]);
+	irqSetPrio(IRQ_KEYPAD, IRQ_PRIO_HIGHEST);
+	irqSet(IRQ_KEYPAD, _innerIsr);
+	irqEnable(IRQ_KEYPAD);
+	irqSet(IRQ_VCOUNT, _outerIsr);
+	irqEnable(IRQ_VCOUNT);
+
+	hostSimRaiseIrq(IRQ_VCOUNT);
+	schedGetStats(&after);
+
+	TEST_CHECK(after.irq_count - before.irq_count >= 2);
+	TEST_CHECK(after.irq_ticks - before.irq_ticks >= 400);
+	TEST_CHECK(after.irq_ticks - before.irq_ticks <= 402);
+
+	irqDisable(IRQ_VCOUNT | IRQ_KEYPAD);
+	irqSet(IRQ_VCOUNT, NULL);
+	irqSet(IRQ_KEYPAD, NULL);
+	irqSetPrio(IRQ_KEYPAD, IRQ_PRIO_DEFAULT);
+	irqEnableNesting(NULL);
+}
+
+int main(void)
+{
+	_testWheelLevels();
+	_testRandomOrder();
+	_testStop();
+	_testPeriodic();
+	_testSleepOrder();
+	_testNestedRead();
+	_testNestedStats();
+	return 0;
+}
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mutex.h>
+#include <calico/system/condvar.h>
+#include <calico/system/mailbox.h>
+#include "test.h"
+
+static Mutex s_mutex;
+static CondVar s_condvar;
+static Mailbox s_mailbox;
+static u32 s_mailboxSlots[4];
+
+// Checks that the time elapsed since @p start lies within [min, min+slack)
+MK_INLINE bool _elapsedWithin(u64 start, u32 min, u32 slack)
+{
+	u64 elapsed = tickGetCount() - start;
+	return elapsed >= min && elapsed < min + slack;
+}
+
+static int _sleepThread(void* arg)
+{
+	threadSleepTicks((u32)(uptr)arg);
+	return (int)(uptr)arg;
+}
+
+static int _holdThread(void* arg)
+{
+	mutexLock(&s_mutex);
+	threadSleepTicks((u32)(uptr)arg);
+	mutexUnlock(&s_mutex);
+	return 0;
+}
+
+static int _sendThread(void* arg)
+{
+	threadSleepTicks((u32)(uptr)arg);
+	mailboxTrySend(&s_mailbox, 42);
+	return 0;
+}
+
+static int _stealThread(void* arg)
+{
+	u32 msg;
+	threadSleepTicks((u32)(uptr)arg);
+	mailboxTrySend(&s_mailbox, 42);
+	return mailboxTryRecv(&s_mailbox, &msg);
+}
+
+static int _signalThread(void* arg)
+{
+	threadSleepTicks((u32)(uptr)arg);
+	mutexLock(&s_mutex);
+	condvarSignal(&s_condvar);
+	mutexUnlock(&s_mutex);
+	return 0;
+}
+
+static void _testJoin(void)
+{
+	int rc = 0;
+	testThreadStart(0, _sleepThread, (void*)1000, 0x20);
+
+	u64 start = tickGetCount();
+	TEST_CHECK(!threadJoinTimeout(&s_testThread[0], &rc, 100));
+	TEST_CHECK(_elapsedWithin(start, 100, 2));
+	TEST_CHECK(threadJoinTimeout(&s_testThread[0], &rc, 2000));
+	TEST_CHECK(_elapsedWithin(start, 1000, 2));
+	TEST_CHECK(rc == 1000);
+
+	// Joining a finished thread succeeds immediately, even with a zero timeout
+	TEST_CHECK(threadJoinTimeout(&s_testThread[0], &rc, 0));
+}
+
+static void _testMutex(void)
+{
+	testThreadStart(0, _holdThread, (void*)500, 0x20);
+	threadSleepTicks(1);
+
+	u64 start = tickGetCount();
+	TEST_CHECK(!mutexLockTimeout(&s_mutex, 100));
+	TEST_CHECK(_elapsedWithin(start, 100, 2));
+	TEST_CHECK(!s_mutex.owner || s_mutex.owner == &s_testThread[0]);
+
+	TEST_CHECK(mutexLockTimeout(&s_mutex, 5000));
+	TEST_CHECK(_elapsedWithin(start, 499, 3));
+	mutexUnlock(&s_mutex);
+	testThreadJoin(0);
+}
+
+static void _testCondVar(void)
+{
+	mutexLock(&s_mutex);
+	u64 start = tickGetCount();
+	TEST_CHECK(!condvarWaitTimeout(&s_condvar, &s_mutex, 200));
+	TEST_CHECK(_elapsedWithin(start, 200, 2));
+	TEST_CHECK(mutexIsLockedByCurrentThread(&s_mutex));
+
+	testThreadStart(0, _signalThread, (void*)50, 0x20);
+	start = tickGetCount();
+	TEST_CHECK(condvarWaitTimeout(&s_condvar, &s_mutex, 1000));
+	TEST_CHECK(_elapsedWithin(start, 50, 2));
+	TEST_CHECK(mutexIsLockedByCurrentThread(&s_mutex));
+	mutexUnlock(&s_mutex);
+	testThreadJoin(0);
+}
+
+static void _testMailbox(void)
+{
+	u32 msg;
+	mailboxPrepare(&s_mailbox, s_mailboxSlots, 4);
+
+	u64 start = tickGetCount();
+	TEST_CHECK(!mailboxRecvTimeout(&s_mailbox, &msg, 20));
+	TEST_CHECK(_elapsedWithin(start, 20, 2));
+
+	testThreadStart(0, _sendThread, (void*)50, 0x20);
+	start = tickGetCount();
+	TEST_CHECK(mailboxRecvTimeout(&s_mailbox, &msg, 200));
+	TEST_CHECK(_elapsedWithin(start, 50, 2));
+	TEST_CHECK(msg == 42);
+	testThreadJoin(0);
+
+	// A receiver woken up for a message taken by a higher priority thread keeps
+	// waiting only for the remainder of its timeout
+	testThreadStart(0, _stealThread, (void*)50, 0x10);
+	start = tickGetCount();
+	TEST_CHECK(!mailboxRecvTimeout(&s_mailbox, &msg, 100));
+	TEST_CHECK(_elapsedWithin(start, 100, 2));
+	TEST_CHECK(testThreadJoin(0));
+
+	// Pending messages are returned without blocking
+	mailboxTrySend(&s_mailbox, 7);
+	TEST_CHECK(mailboxRecvTimeout(&s_mailbox, &msg, 0) && msg == 7);
+}
+
+static void _testBlockTimeout(void)
+{
+	// A timed out wait leaves the queue empty
+	static ThrListNode queue;
+	u64 start = tickGetCount();
+	TEST_CHECK(threadBlockTimeout(&queue, 1, 30) == 0);
+	TEST_CHECK(_elapsedWithin(start, 30, 2));
+	TEST_CHECK(!queue.next && !queue.prev);
+}
+
+int main(void)
+{
+	_testJoin();
+	_testMutex();
+	_testCondVar();
+	_testMailbox();
+	_testBlockTimeout();
+	return 0;
+}
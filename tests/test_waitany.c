@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+#include <calico/system/mailbox.h>
+#include <calico/system/waitany.h>
+#include "test.h"
+
+static Mailbox s_mailbox1, s_mailbox2;
+static u32 s_mailboxSlots1[4], s_mailboxSlots2[4];
+static TickTask s_timer;
+
+static int _senderThread(void* arg)
+{
+	threadSleepTicks(100);
+	mailboxTrySend(&s_mailbox2, 7);
+	threadSleepTicks(100);
+	hostSimRaiseIrq(IRQ_VBLANK);
+	return 0;
+}
+
+static void _testMixed(void)
+{
+	u32 msg;
+	ThrWaitObj objs[3] = {
+		{ ThrWaitType_Mailbox, { .mailbox = &s_mailbox1 } },
+		{ ThrWaitType_Mailbox, { .mailbox = &s_mailbox2 } },
+		{ ThrWaitType_Irq,     { .irq_mask = IRQ_VBLANK } },
+	};
+
+	u64 start = tickGetCount();
+	TEST_CHECK(threadWaitAny(objs, 3, 50) == 0);
+	TEST_CHECK(tickGetCount() - start >= 50);
+
+	testThreadStart(0, _senderThread, NULL, 0x30);
+	start = tickGetCount();
+	TEST_CHECK(threadWaitAny(objs, 3, THREAD_WAIT_INFINITE) == 2 && objs[1].result == 1);
+	TEST_CHECK(tickGetCount() - start >= 100);
+
+	// Mailbox messages are not consumed by the wait
+	TEST_CHECK(mailboxTryRecv(&s_mailbox2, &msg) && msg == 7);
+	TEST_CHECK(threadWaitAny(objs, 3, 1000) == 4 && objs[2].result == IRQ_VBLANK);
+
+	// Interrupt flags are
+	TEST_CHECK(threadWaitAny(objs, 3, 10) == 0);
+	testThreadJoin(0);
+
+	// Objects that are already ready are reported without blocking
+	mailboxTrySend(&s_mailbox1, 1);
+	mailboxTrySend(&s_mailbox2, 2);
+	TEST_CHECK(threadWaitAny(objs, 3, 0) == 3);
+	TEST_CHECK(mailboxTryRecv(&s_mailbox1, &msg) && mailboxTryRecv(&s_mailbox2, &msg));
+}
+
+static void _testTimer(void)
+{
+	ThrWaitObj objs[2] = {
+		{ ThrWaitType_Timer,   { .timer = &s_timer } },
+		{ ThrWaitType_Mailbox, { .mailbox = &s_mailbox2 } },
+	};
+
+	threadTimerStartTicks(&s_timer, 30);
+	u64 start = tickGetCount();
+	for (unsigned i = 0; i < 3; i ++) {
+		TEST_CHECK(threadWaitAny(objs, 2, THREAD_WAIT_INFINITE) == 1);
+		TEST_CHECK(objs[0].result == 1);
+	}
+	TEST_CHECK(tickGetCount() - start == 90);
+	tickTaskStop(&s_timer);
+}
+
+static int _irqWaitThread(void* arg)
+{
+	return threadIrqWait(false, IRQ_VBLANK);
+}
+
+static void _checkIrqLatched(void)
+{
+	// The interrupt must stay latched for later waiters instead of being
+	// consumed on behalf of a wait that has already ended
+	hostSimRaiseIrq(IRQ_VBLANK);
+	testThreadStart(1, _irqWaitThread, NULL, 0x10);
+	TEST_CHECK(s_testThread[1].status == ThrStatus_Finished);
+	TEST_CHECK(testThreadJoin(1) == IRQ_VBLANK);
+}
+
+static int _delayedSendThread(void* arg)
+{
+	threadSleepTicks(20);
+	mailboxTrySend(&s_mailbox1, 1);
+	return 0;
+}
+
+static void _testIrqMaskCleanup(void)
+{
+	u32 msg;
+	ThrWaitObj objs[2] = {
+		{ ThrWaitType_Irq, { .irq_mask = IRQ_VBLANK } },
+	};
+
+	// Woken up by a mailbox
+	objs[1] = (ThrWaitObj){ ThrWaitType_Mailbox, { .mailbox = &s_mailbox1 } };
+	testThreadStart(0, _delayedSendThread, NULL, 0x30);
+	TEST_CHECK(threadWaitAny(objs, 2, THREAD_WAIT_INFINITE) == 2);
+	TEST_CHECK(mailboxTryRecv(&s_mailbox1, &msg));
+	testThreadJoin(0);
+	_checkIrqLatched();
+
+	// Woken up by a timer
+	objs[1] = (ThrWaitObj){ ThrWaitType_Timer, { .timer = &s_timer } };
+	threadTimerStartTicks(&s_timer, 30);
+	TEST_CHECK(threadWaitAny(objs, 2, THREAD_WAIT_INFINITE) == 2);
+	tickTaskStop(&s_timer);
+	_checkIrqLatched();
+
+	// Timed out
+	TEST_CHECK(threadWaitAny(objs, 1, 20) == 0);
+	_checkIrqLatched();
+}
+
+int main(void)
+{
+	mailboxPrepare(&s_mailbox1, s_mailboxSlots1, 4);
+	mailboxPrepare(&s_mailbox2, s_mailboxSlots2, 4);
+	irqEnable(IRQ_VBLANK);
+
+	_testMixed();
+	_testTimer();
+	_testIrqMaskCleanup();
+	return 0;
+}
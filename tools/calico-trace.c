@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: ZPL-2.1
+// SPDX-FileCopyrightText: Copyright fincs, devkitPro
+//
+// Host tool: converts trace dumps produced by traceSnapshot() into the Chrome
+// trace event format (viewable in chrome://tracing or Perfetto).
+//
+// Build: cc -O2 -o calico-trace calico-trace.c
+// Usage: calico-trace dump7.bin [dump9.bin ...] > trace.json
+//
+// Each dump is shown as a separate process. Threads are identified by the
+// address of their Thread object; interrupt handlers are shown as thread 0.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#define TRACE_MAGIC   0x43525443
+#define TRACE_VERSION 1
+
+enum {
+	TraceEvent_Switch    = 0,
+	TraceEvent_Block     = 1,
+	TraceEvent_Unblock   = 2,
+	TraceEvent_IrqEnter  = 3,
+	TraceEvent_IrqExit   = 4,
+	TraceEvent_TickTask  = 5,
+	TraceEvent_PxiSend   = 6,
+	TraceEvent_PxiRecv   = 7,
+};
+
+static uint32_t rd16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool s_first = true;
+
+__attribute__((format(printf, 1, 2)))
+static void emit(const char* fmt, ...)
+{
+	va_list va;
+	printf("%s\n\t", s_first ? "" : ",");
+	s_first = false;
+	va_start(va, fmt);
+	vprintf(fmt, va);
+	va_end(va);
+}
+
+static int convert(const char* path, int pid)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	uint8_t hdr[16];
+	if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || rd32(&hdr[0]) != TRACE_MAGIC) {
+		fprintf(stderr, "%s: not a trace dump\n", path);
+		fclose(f);
+		return 1;
+	}
+
+	uint32_t version = rd16(&hdr[4]);
+	uint32_t entry_sz = rd16(&hdr[6]);
+	uint32_t num_entries = rd32(&hdr[8]);
+	uint32_t tick_freq = rd32(&hdr[12]);
+	if (version != TRACE_VERSION || entry_sz < 16 || !tick_freq) {
+		fprintf(stderr, "%s: unsupported trace dump (version %u)\n", path, version);
+		fclose(f);
+		return 1;
+	}
+
+	emit("{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}", pid, path);
+	emit("{\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"name\":\"thread_name\",\"args\":{\"name\":\"IRQ\"}}", pid);
+
+	uint8_t* e = malloc(entry_sz);
+	uint64_t base = 0, last = 0;
+	uint32_t cur_thread = 0;
+	double cur_start = 0.0;
+	bool in_irq = false;
+
+	for (uint32_t i = 0; i < num_entries; i ++) {
+		if (fread(e, 1, entry_sz, f) != entry_sz) {
+			fprintf(stderr, "%s: truncated trace dump\n", path);
+			break;
+		}
+
+		// Unwrap the 32-bit timestamps (which may go slightly backwards, see TraceEntry)
+		uint32_t ts32 = rd32(&e[0]);
+		uint64_t ts64 = i ? last + (int32_t)(ts32 - (uint32_t)last) : ts32;
+		if (!i) {
+			base = ts64;
+		}
+		last = ts64;
+		double us = (double)(int64_t)(ts64 - base) * 1e6 / tick_freq;
+
+		uint32_t type = rd16(&e[4]);
+		uint32_t aux  = rd16(&e[6]);
+		uint32_t arg0 = rd32(&e[8]);
+		uint32_t arg1 = rd32(&e[12]);
+
+		switch (type) {
+			case TraceEvent_Switch:
+				if (cur_thread) {
+					emit("{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"running\"}",
+						pid, cur_thread, cur_start, us - cur_start);
+				}
+				cur_thread = arg1;
+				cur_start = us;
+				break;
+
+			case TraceEvent_Block:
+				emit("{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"name\":\"block\",\"args\":{\"queue\":\"0x%08x\",\"token\":\"0x%08x\"}}",
+					pid, cur_thread, us, arg0, arg1);
+				break;
+
+			case TraceEvent_Unblock:
+				emit("{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"name\":\"unblock\",\"args\":{\"token\":\"0x%08x\"}}",
+					pid, arg0, us, arg1);
+				break;
+
+			case TraceEvent_IrqEnter:
+				if (in_irq) {
+					emit("{\"ph\":\"E\",\"pid\":%d,\"tid\":0,\"ts\":%.3f}", pid, us);
+				}
+				emit("{\"ph\":\"B\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"name\":\"IRQ %u\"}", pid, us, aux);
+				in_irq = true;
+				break;
+
+			case TraceEvent_IrqExit:
+				if (in_irq) {
+					emit("{\"ph\":\"E\",\"pid\":%d,\"tid\":0,\"ts\":%.3f}", pid, us);
+					in_irq = false;
+				}
+				break;
+
+			case TraceEvent_TickTask:
+				emit("{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"name\":\"tick task\",\"args\":{\"task\":\"0x%08x\",\"fn\":\"0x%08x\"}}",
+					pid, us, arg0, arg1);
+				break;
+
+			case TraceEvent_PxiSend:
+			case TraceEvent_PxiRecv:
+				emit("{\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"name\":\"pxi %s ch%u\",\"args\":{\"packet\":\"0x%08x\",\"words\":%u}}",
+					pid, type == TraceEvent_PxiSend ? cur_thread : 0, us, type == TraceEvent_PxiSend ? "send" : "recv", aux, arg0, arg1);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// Close any open slices
+	double end_us = (double)(int64_t)(last - base) * 1e6 / tick_freq;
+	if (in_irq) {
+		emit("{\"ph\":\"E\",\"pid\":%d,\"tid\":0,\"ts\":%.3f}", pid, end_us);
+	}
+	if (cur_thread) {
+		emit("{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"running\"}",
+			pid, cur_thread, cur_start, end_us - cur_start);
+	}
+
+	free(e);
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s dump.bin [dump.bin ...] > trace.json\n", argv[0]);
+		return 1;
+	}
+
+	int rc = 0;
+	printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (int i = 1; i < argc; i ++) {
+		rc |= convert(argv[i], i);
+	}
+	printf("\n]}\n");
+
+	return rc;
+}